@@ -0,0 +1,136 @@
+#include "atlas.h"
+
+#include <stdatomic.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <time.h>
+#include <SDL2/SDL.h>
+
+#include "panic.h"
+#include "png.h"
+#include "renderer_software.h"
+#include "generator/julia_simd.h"
+
+/** ATLAS_EXTENT is the width & height of the z-plane of thumbnails, centered
+ ** on 0: julia sets fit in the disk of radius 2, most of them in this. */
+#define ATLAS_EXTENT 3.2
+
+/** atlas_job is an atlas rendered by the workers of the pool, a group of
+ ** JULIA_LANES_MAX cells at a time, next being the first group left. */
+struct atlas_job {
+    SDL_Surface* buf;
+    int cols, rows, thumb;
+    int max_iter;
+    const double* jx;
+    const double* jy;
+    bool overlay;
+    int groupc;
+    atomic_int next;
+};
+
+/** atlas_put colors pixel (x, y) of buf with iter, blended a third with the
+ ** mandelbrot set already there if overlay. */
+static inline void atlas_put(struct atlas_job* job, int x, int y, int32_t iter) {
+    uint32_t* pixel = (uint32_t*)((uint8_t*)job->buf->pixels + (size_t)y * job->buf->pitch) + x;
+    uint32_t color = rdr_sw_map_color(job->buf->format, iter, job->max_iter);
+    if (job->overlay) {
+        uint8_t r, g, b, mr, mg, mb;
+        SDL_GetRGB(color, job->buf->format, &r, &g, &b);
+        SDL_GetRGB(*pixel, job->buf->format, &mr, &mg, &mb);
+        uint8_t gray = (uint8_t)((2 * r + mr) / 3);
+        color = SDL_MapRGB(job->buf->format, gray, gray, gray);
+    }
+    *pixel = color;
+}
+
+/** atlas_groups renders groups of cells until none is left. Julia sets are
+ ** symmetric about 0: pixels are computed for half of the thumbnails. */
+static void atlas_groups(void* arg, int workeri, int workerc) {
+    struct atlas_job* job = arg;
+    int thumb = job->thumb;
+    int cells = job->cols * job->rows;
+    double d = ATLAS_EXTENT / thumb;
+    int32_t iters[JULIA_LANES_MAX];
+    int g;
+    while ((g = atomic_fetch_add(&job->next, 1)) < job->groupc) {
+        int k0 = g * JULIA_LANES_MAX;
+        int count = (cells - k0 < JULIA_LANES_MAX) ? cells - k0 : JULIA_LANES_MAX;
+        for (int y = 0; y < (thumb + 1) / 2; y++) {
+            int my = thumb - 1 - y;
+            /* The middle row of odd thumbnails is its own mirror. */
+            int xm = (y == my) ? (thumb + 1) / 2 : thumb;
+            for (int x = 0; x < xm; x++) {
+                int mx = thumb - 1 - x;
+                julia_lanes_f32((x + 0.5) * d - ATLAS_EXTENT / 2, (y + 0.5) * d - ATLAS_EXTENT / 2,
+                        job->jx + k0, job->jy + k0, job->max_iter, iters, count);
+                for (int l = 0; l < count; l++) {
+                    int ox = ((k0 + l) % job->cols) * thumb;
+                    int oy = ((k0 + l) / job->cols) * thumb;
+                    atlas_put(job, ox + x, oy + y, iters[l]);
+                    atlas_put(job, ox + mx, oy + my, iters[l]);
+                }
+            }
+        }
+    }
+}
+
+bool atlas_render(struct fractal_info fi, int width, int cols, int rows, int thumb,
+        bool overlay, const char* output) {
+    if (cols < 1 || rows < 1 || thumb < 1) {
+        fprintf(stderr, "Can't render a %dx%d atlas of %dx%d thumbnails.\n", cols, rows, thumb, thumb);
+        return false;
+    }
+    SDL_Surface* buf = SDL_CreateRGBSurface(0, cols * thumb, rows * thumb, 32, 0, 0, 0, 0);
+    if (!buf) {
+        panic("Error: SDL can't create a surface.");
+    }
+    /* Constants: centers of the cells. */
+    int cells = cols * rows;
+    double cell = fi.dpp * width / cols;
+    double* jx = malloc(cells * sizeof(double));
+    double* jy = malloc(cells * sizeof(double));
+    if (!jx || !jy) {
+        panic("Error: can't allocate the atlas constants.");
+    }
+    for (int k = 0; k < cells; k++) {
+        jx[k] = fi.cx + (k % cols + 0.5 - cols / 2.0) * cell;
+        jy[k] = fi.cy + (k / cols + 0.5 - rows / 2.0) * cell;
+    }
+    struct timespec start, end;
+    clock_gettime(CLOCK_MONOTONIC, &start);
+    if (overlay) {
+        struct fractal_info mandelbrot = fi;
+        mandelbrot.generator = GEN_MANDELBROT;
+        mandelbrot.dynamic = false;
+        mandelbrot.dpp = cell / thumb;
+        rdr_sw_render_buffer(buf, mandelbrot, 0.0);
+    }
+    struct atlas_job job = {
+        .buf = buf,
+        .cols = cols,
+        .rows = rows,
+        .thumb = thumb,
+        .max_iter = fi.max_iter,
+        .jx = jx,
+        .jy = jy,
+        .overlay = overlay,
+        .groupc = (cells + JULIA_LANES_MAX - 1) / JULIA_LANES_MAX,
+    };
+    atomic_init(&job.next, 0);
+    rdr_sw_run(atlas_groups, &job);
+    clock_gettime(CLOCK_MONOTONIC, &end);
+    double ms = (end.tv_sec - start.tv_sec) * 1e3 + (end.tv_nsec - start.tv_nsec) * 1e-6;
+    fprintf(stdout, "> atlas: %dx%d julia sets of %dx%d pixels in %.2f ms, c in [%g, %g] x [%g, %g]\n",
+            cols, rows, thumb, thumb, ms, jx[0] - cell / 2, jx[cells - 1] + cell / 2,
+            jy[0] - cell / 2, jy[cells - 1] + cell / 2);
+    bool ok = png_write_surface_mt(buf, output);
+    if (!ok) {
+        fprintf(stderr, "Can't write atlas `%s`.\n", output);
+    } else {
+        fprintf(stdout, "> atlas `%s`\n", output);
+    }
+    free(jx);
+    free(jy);
+    SDL_FreeSurface(buf);
+    return ok;
+}
@@ -0,0 +1,17 @@
+#ifndef _H_ATLAS_
+#define _H_ATLAS_
+
+#include <stdbool.h>
+
+#include "types.h"
+
+/** atlas_render renders a cols x rows atlas of thumb x thumb julia set
+ ** thumbnails with the software renderer pool (see rdr_sw_pool_init): the
+ ** constant of a cell is its center in the c-plane region of the width
+ ** pixels wide view of fi, split in square cells. With overlay, the
+ ** thumbnails are blended with the mandelbrot set of the region. Writes the
+ ** atlas to the PNG file output. Returns false on error. */
+bool atlas_render(struct fractal_info fi, int width, int cols, int rows, int thumb,
+        bool overlay, const char* output);
+
+#endif
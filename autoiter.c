@@ -0,0 +1,169 @@
+#include "autoiter.h"
+
+#include <math.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "compute.h"
+#include "panic.h"
+#include "renderer_software.h"
+
+/** AI_PROBE_PIXELS is the pixel count of probe passes (96x72 at 4:3). */
+#define AI_PROBE_PIXELS (96 * 72)
+/** AI_MIN_ITER & AI_MAX_ITER bound the chosen limits. */
+#define AI_MIN_ITER 32
+#define AI_MAX_ITER 1000000
+/** AI_QUANTILE of the escape counts of the probe bounds the slowest escaping
+ ** pixels; the full resolution view samples AI_MARGIN times slower ones. */
+#define AI_QUANTILE 0.995
+#define AI_MARGIN 2.0
+/** AI_ROUNDS bounds the probe passes, each with a 4 times larger limit for
+ ** the pixels not escaping the previous one; all passes together run at most
+ ** AI_BUDGET iterations, the first one included. */
+#define AI_ROUNDS 3
+#define AI_BUDGET 128e6
+
+/** ai_depth returns the limit expected at the dpp of the width pixels view
+ ** of fi: 64 for the whole set, growing with the zoom octaves (power 1.25). */
+static int ai_depth(struct fractal_info fi, int width) {
+    double octaves = log2(fmax(3.0 / (fi.dpp * width), 1.0));
+    double limit = 64.0 + 32.0 * pow(octaves, 1.25);
+    return (limit < AI_MAX_ITER) ? (int)limit : AI_MAX_ITER;
+}
+
+static int cmp_int32(const void* a, const void* b) {
+    int32_t x = *(const int32_t*)a, y = *(const int32_t*)b;
+    return (x > y) - (x < y);
+}
+
+/** ai_cost returns the iterations of the count pixels of iters with limit
+ ** max_iter. */
+static double ai_cost(int32_t* iters, int count, int max_iter) {
+    double sum = 0.0;
+    for (int i = 0; i < count; i++) {
+        sum += (iters[i] < max_iter) ? iters[i] : max_iter;
+    }
+    return sum;
+}
+
+/** ai_probe_job computes the iterations of the pixels of a probe pass:
+ ** all of them for the first pass, else those not escaping the limit last
+ ** of the previous pass. */
+struct ai_probe_job {
+    int32_t* iters;
+    struct fractal_info fi; // probe view & limit.
+    int width, height;
+    int last; // 0 for the first pass.
+};
+
+/** ai_probe_rows runs job on rows workeri, workeri + workerc... of the probe:
+ ** interleaved rows share the slow regions of the view between workers. */
+static void ai_probe_rows(void* arg, int workeri, int workerc) {
+    struct ai_probe_job* job = arg;
+    int pw = job->width;
+    for (int y = workeri; y < job->height; y += workerc) {
+        int32_t* row = &job->iters[(size_t)y * pw];
+        if (job->last == 0) {
+            compute_iters(row, job->fi, pw, job->height, 0, y, pw, 1);
+            continue;
+        }
+        /* Runs of pixels of the row. */
+        for (int x = 0; x < pw; ) {
+            int run = 0;
+            while (x + run < pw && row[x + run] >= job->last) {
+                run++;
+            }
+            if (run > 0) {
+                compute_iters(&row[x], job->fi, pw, job->height, x, y, run, 1);
+            }
+            x += (run > 0) ? run : 1;
+        }
+    }
+}
+
+struct autoiter_estimate autoiter_estimate(struct fractal_info fi, int width, int height, double t) {
+    struct autoiter_estimate est = {0};
+    est.depth = ai_depth(fi, width);
+    est.probe = (fi.max_iter > est.depth) ? fi.max_iter : est.depth;
+    /* Probe: the view at a lower resolution. */
+    double scale = sqrt((double)AI_PROBE_PIXELS / ((double)width * height));
+    scale = (scale < 1.0) ? scale : 1.0;
+    int pw = (int)(width * scale), ph = (int)(height * scale);
+    pw = (pw > 0) ? pw : 1;
+    ph = (ph > 0) ? ph : 1;
+    struct fractal_info probe = fi_at(fi, t);
+    probe.dpp = fi.dpp * width / pw;
+    int count = pw * ph;
+    int32_t* iters = malloc(count * sizeof(int32_t));
+    int32_t* sorted = malloc(count * sizeof(int32_t));
+    if (!iters || !sorted) {
+        panic("Error: can't allocate the probe buffers.");
+    }
+    /* The first pass is within the budget too. */
+    if ((double)count * est.probe > AI_BUDGET) {
+        est.probe = (int)(AI_BUDGET / count);
+        est.probe = (est.probe > AI_MIN_ITER) ? est.probe : AI_MIN_ITER;
+    }
+    double spent = (double)count * est.probe;
+    probe.max_iter = est.probe;
+    struct ai_probe_job job = {iters, probe, pw, ph, 0};
+    rdr_sw_run(ai_probe_rows, &job);
+    for (int round = 0; ; round++) {
+        memcpy(sorted, iters, count * sizeof(int32_t));
+        qsort(sorted, count, sizeof(int32_t), cmp_int32);
+        int escaped = 0;
+        while (escaped < count && sorted[escaped] < est.probe) {
+            escaped++;
+        }
+        est.inside = 1.0 - (double)escaped / count;
+        if (escaped == 0) {
+            /* Nothing escapes: the counts tell nothing. */
+            est.max_iter = est.depth;
+            break;
+        }
+        double limit = AI_MARGIN * (sorted[(int)((escaped - 1) * AI_QUANTILE)] + 1);
+        if (limit < est.probe) {
+            est.max_iter = (int)ceil(limit);
+            break;
+        }
+        /* Slow escapes are cut by the probe limit: raise it. */
+        if (round == AI_ROUNDS - 1 || est.probe >= AI_MAX_ITER / 4
+                || spent + (double)(count - escaped) * est.probe * 4 > AI_BUDGET) {
+            est.max_iter = est.probe;
+            break;
+        }
+        job.last = est.probe;
+        est.probe *= 4;
+        spent += (double)(count - escaped) * est.probe;
+        job.fi.max_iter = est.probe;
+        rdr_sw_run(ai_probe_rows, &job);
+    }
+    est.max_iter = (est.max_iter > AI_MIN_ITER) ? est.max_iter : AI_MIN_ITER;
+    /* Iterations of the probe, as a sample of the view. */
+    double configured = ai_cost(iters, count, fi.max_iter);
+    est.saved = (configured > 0) ? 1.0 - ai_cost(iters, count, est.max_iter) / configured : 0.0;
+    free(iters);
+    free(sorted);
+    return est;
+}
+
+struct fractal_info autoiter_select(struct autoiter* ai, struct fractal_info fi,
+        int width, int height, double t) {
+    if (!ai->any || !fi_equal(fi, ai->fi) || width != ai->width || height != ai->height) {
+        ai->any = true;
+        ai->fi = fi;
+        ai->width = width;
+        ai->height = height;
+        ai->est = autoiter_estimate(fi, width, height, t);
+        fprintf(stdout, "> max_iter %d (configured %d, %s%.1f%% iterations; "
+                "%d expected at dpp %g, %.1f%% inside at %d)\n",
+                ai->est.max_iter, fi.max_iter,
+                (ai->est.saved >= 0) ? "saves " : "spends ",
+                fabs(ai->est.saved) * 100.0, ai->est.depth, fi.dpp,
+                ai->est.inside * 100.0, ai->est.probe);
+    }
+    fi.max_iter = ai->est.max_iter;
+    return fi;
+}
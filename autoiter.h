@@ -0,0 +1,39 @@
+#ifndef _H_AUTOITER_
+#define _H_AUTOITER_
+
+#include <stdbool.h>
+
+#include "types.h"
+
+/** autoiter_estimate is the iteration limit chosen for a view. */
+struct autoiter_estimate {
+    int max_iter;  // chosen limit.
+    int depth;     // limit expected at the dpp of the view.
+    int probe;     // limit of the probe pass.
+    double inside; // fraction of probe pixels not escaping within probe.
+    double saved;  // iterations saved vs fi.max_iter, negative if spent.
+};
+
+/** autoiter_estimate estimates the smallest iteration limit rendering the
+ ** width x height view of fi at time t like an unbounded one: the escape
+ ** counts of a low resolution probe pass, limited by the larger of
+ ** fi.max_iter & the limit expected at its dpp, bound the limit of the
+ ** slowest escaping pixels. Passes run on the worker pool (see rdr_sw_run),
+ ** AI_BUDGET iterations at most. */
+struct autoiter_estimate autoiter_estimate(struct fractal_info fi, int width, int height, double t);
+
+/** autoiter keeps the last estimate to re-probe on changes only. */
+struct autoiter {
+    bool any;
+    struct fractal_info fi;
+    int width, height;
+    struct autoiter_estimate est;
+};
+
+/** autoiter_select returns fi with the iteration limit estimated for it;
+ ** fi.max_iter is the configured limit. Views are probed when fi or the
+ ** size changes (dynamic fractals at that time) & the limit is printed. */
+struct fractal_info autoiter_select(struct autoiter* ai, struct fractal_info fi,
+        int width, int height, double t);
+
+#endif
@@ -12,7 +12,7 @@ void benchmark_display_results(long long startt, long long endt, int runs);
 long long benchmark_get_time_ns() {
     struct timespec tp;
     clock_gettime(CLOCK_MONOTONIC, &tp);
-    return tp.tv_sec * 10e9 + tp.tv_nsec;
+    return tp.tv_sec * 1000000000LL + tp.tv_nsec;
 }
 
 #include <stdio.h>
@@ -23,8 +23,8 @@ void benchmark_display_banner(const char* name, int runs, const char* infos) {
 }
 
 void benchmark_display_results(long long startt, long long endt, int runs) {
-    double elapsed = (double)(endt - startt) / 10e9; // s
-    double per_run = (double)(endt - startt) / 10e6 / runs; // ms
+    double elapsed = (double)(endt - startt) / 1e9; // s
+    double per_run = (double)(endt - startt) / 1e6 / runs; // ms
     fprintf(stdout, "  Runs: %6d, Time elapsed: %6.3lf s, Time/Run: %6.1lf ms\n", runs, elapsed, per_run);
 }
 
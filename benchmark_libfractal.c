@@ -0,0 +1,89 @@
+#include <stdio.h>
+#include <stdlib.h>
+
+#ifdef MT
+#include <pthread.h>
+#endif
+
+#include "libfractal.h"
+
+#ifndef RUNS
+#define RUNS 1000
+#endif
+
+/* Batch of small renders: RUNS / 10 thumbnails, from CALLERS threads. */
+#define THUMB_WIDTH 200
+#define THUMB_HEIGHT 150
+#define THUMBS ((RUNS / 10 > 0) ? RUNS / 10 : 1)
+#define CALLERS 4
+
+#define _STRINGIFY(str) #str
+#define STRINGIFY(str) _STRINGIFY(str)
+
+#define BENCHMARK_IMPL
+#include "benchmark.h"
+
+/** benchmark_batch is the share of the thumbnails of a caller. */
+struct benchmark_batch {
+    struct lf_pool* pool;
+    int first, count;
+};
+
+/** benchmark_thumbs renders the thumbnails of batch on its own context:
+ ** mandelbrot views along the boundary, max_iter growing with the zoom. */
+static void* benchmark_thumbs(void* arg) {
+    struct benchmark_batch* batch = arg;
+    struct lf_ctx* ctx = lf_ctx_open(batch->pool);
+    uint32_t* pixels = malloc(THUMB_WIDTH * THUMB_HEIGHT * sizeof(uint32_t));
+    for (int i = batch->first; i < batch->first + batch->count; i++) {
+        struct fractal_info fi = {
+            .generator = GEN_MANDELBROT,
+            .max_iter  = 50 + 10 * (i % 16),
+            .cx        = -0.7 + 0.02 * (i % 8),
+            .cy        = 0.3 - 0.01 * (i % 16),
+            .dpp       = 0.0035 * 4 / (1 + i % 16),
+        };
+        lf_render(ctx, fi, 0.0, pixels, THUMB_WIDTH * sizeof(uint32_t), THUMB_WIDTH, THUMB_HEIGHT);
+    }
+    free(pixels);
+    lf_ctx_close(ctx);
+    return NULL;
+}
+
+/** benchmark_batch times THUMBS renders split between callers threads. */
+static void benchmark_batch(struct lf_pool* pool, int callers) {
+    char infos[64];
+    snprintf(infos, sizeof(infos), "%d thumbnails "STRINGIFY(THUMB_WIDTH)"x"STRINGIFY(THUMB_HEIGHT)
+            ", %d callers", THUMBS, callers);
+    benchmark_display_banner("lf_render", THUMBS, infos);
+    struct benchmark_batch batches[CALLERS];
+    long long startt = benchmark_get_time_ns();
+#ifdef MT
+    pthread_t threads[CALLERS];
+    for (int c = 0; c < callers; c++) {
+        batches[c] = (struct benchmark_batch){pool, THUMBS * c / callers,
+            THUMBS * (c + 1) / callers - THUMBS * c / callers};
+        pthread_create(&threads[c], NULL, benchmark_thumbs, &batches[c]);
+    }
+    for (int c = 0; c < callers; c++) {
+        pthread_join(threads[c], NULL);
+    }
+#else
+    batches[0] = (struct benchmark_batch){pool, 0, THUMBS};
+    benchmark_thumbs(&batches[0]);
+#endif
+    long long endt = benchmark_get_time_ns();
+    benchmark_display_results(startt, endt, THUMBS);
+}
+
+int main(void)
+{
+    struct lf_pool* pool = lf_pool_open(0);
+    benchmark_batch(pool, 1);
+#ifdef MT
+    benchmark_batch(pool, CALLERS);
+#endif
+    lf_pool_close(pool);
+
+    return EXIT_SUCCESS;
+}
@@ -0,0 +1,158 @@
+#ifndef _H_BENCHMARK_PERF_
+#define _H_BENCHMARK_PERF_
+
+#include <stdbool.h>
+#include <stdint.h>
+
+/** BENCHMARK_PERF_COUNTERS is the number of hardware counters read. */
+#define BENCHMARK_PERF_COUNTERS 6
+
+/** benchmark_perf is a set of hardware counters of a thread (see
+ ** perf_event_open(2)); counters that can't be opened have fd -1. Sums of
+ ** counters (see benchmark_perf_add) have no fd, valid tells which values
+ ** were read. */
+struct benchmark_perf {
+    int fd[BENCHMARK_PERF_COUNTERS];
+    bool valid[BENCHMARK_PERF_COUNTERS];
+    uint64_t value[BENCHMARK_PERF_COUNTERS];
+};
+
+/** benchmark_perf_open opens the counters of the calling thread, disabled
+ ** & user space only. Returns false if none can be opened. */
+bool benchmark_perf_open(struct benchmark_perf* perf);
+/** benchmark_perf_start resets & enables the counters of perf. */
+void benchmark_perf_start(struct benchmark_perf* perf);
+/** benchmark_perf_stop disables the counters of perf & reads them, scaled
+ ** by their running time if multiplexed. */
+void benchmark_perf_stop(struct benchmark_perf* perf);
+/** benchmark_perf_add adds the values of src to dest; the fds of dest are
+ ** left untouched. */
+void benchmark_perf_add(struct benchmark_perf* dest, struct benchmark_perf* src);
+/** benchmark_perf_print prints the values of perf prefixed by name;
+ ** iterations, if not 0, is the work measured by perf. */
+void benchmark_perf_print(const char* name, struct benchmark_perf* perf, double iterations);
+/** benchmark_perf_close closes the counters of perf. */
+void benchmark_perf_close(struct benchmark_perf* perf);
+
+#ifdef BENCHMARK_IMPL
+
+#include <errno.h>
+#include <linux/perf_event.h>
+#include <stdio.h>
+#include <string.h>
+#include <sys/ioctl.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+
+enum {
+    BENCHMARK_PERF_CYCLES,
+    BENCHMARK_PERF_INSTRUCTIONS,
+    BENCHMARK_PERF_L1D_MISSES,
+    BENCHMARK_PERF_LLC_MISSES,
+    BENCHMARK_PERF_BRANCH_MISSES,
+    BENCHMARK_PERF_TASK_CLOCK,
+};
+
+static const struct {
+    uint32_t type;
+    uint64_t config;
+} benchmark_perf_events[BENCHMARK_PERF_COUNTERS] = {
+    {PERF_TYPE_HARDWARE, PERF_COUNT_HW_CPU_CYCLES},
+    {PERF_TYPE_HARDWARE, PERF_COUNT_HW_INSTRUCTIONS},
+    {PERF_TYPE_HW_CACHE, PERF_COUNT_HW_CACHE_L1D
+        | (PERF_COUNT_HW_CACHE_OP_READ << 8) | (PERF_COUNT_HW_CACHE_RESULT_MISS << 16)},
+    {PERF_TYPE_HARDWARE, PERF_COUNT_HW_CACHE_MISSES},
+    {PERF_TYPE_HARDWARE, PERF_COUNT_HW_BRANCH_MISSES},
+    {PERF_TYPE_SOFTWARE, PERF_COUNT_SW_TASK_CLOCK},
+};
+
+bool benchmark_perf_open(struct benchmark_perf* perf) {
+    bool any = false;
+    for (int i = 0; i < BENCHMARK_PERF_COUNTERS; i++) {
+        struct perf_event_attr attr;
+        memset(&attr, 0, sizeof(attr));
+        attr.size = sizeof(attr);
+        attr.type = benchmark_perf_events[i].type;
+        attr.config = benchmark_perf_events[i].config;
+        attr.disabled = 1;
+        attr.exclude_kernel = 1;
+        attr.exclude_hv = 1;
+        attr.read_format = PERF_FORMAT_TOTAL_TIME_ENABLED | PERF_FORMAT_TOTAL_TIME_RUNNING;
+        /* Calling thread, any cpu. */
+        perf->fd[i] = (int)syscall(SYS_perf_event_open, &attr, 0, -1, -1, 0);
+        perf->valid[i] = false;
+        perf->value[i] = 0;
+        any |= perf->fd[i] >= 0 && i != BENCHMARK_PERF_TASK_CLOCK;
+    }
+    return any;
+}
+
+void benchmark_perf_start(struct benchmark_perf* perf) {
+    for (int i = 0; i < BENCHMARK_PERF_COUNTERS; i++) {
+        if (perf->fd[i] >= 0) {
+            ioctl(perf->fd[i], PERF_EVENT_IOC_RESET, 0);
+            ioctl(perf->fd[i], PERF_EVENT_IOC_ENABLE, 0);
+        }
+    }
+}
+
+void benchmark_perf_stop(struct benchmark_perf* perf) {
+    for (int i = 0; i < BENCHMARK_PERF_COUNTERS; i++) {
+        perf->value[i] = 0;
+        perf->valid[i] = false;
+        if (perf->fd[i] < 0) {
+            continue;
+        }
+        ioctl(perf->fd[i], PERF_EVENT_IOC_DISABLE, 0);
+        uint64_t data[3]; // value, time enabled, time running.
+        if (read(perf->fd[i], data, sizeof(data)) != sizeof(data)) {
+            continue;
+        }
+        perf->value[i] = (data[2] > 0 && data[2] < data[1])
+            ? (uint64_t)((double)data[0] * data[1] / data[2])
+            : data[0];
+        perf->valid[i] = true;
+    }
+}
+
+void benchmark_perf_add(struct benchmark_perf* dest, struct benchmark_perf* src) {
+    for (int i = 0; i < BENCHMARK_PERF_COUNTERS; i++) {
+        dest->valid[i] |= src->valid[i];
+        dest->value[i] += src->value[i];
+    }
+}
+
+/** benchmark_perf_value returns counter i of perf, NAN if unavailable. */
+static double benchmark_perf_value(struct benchmark_perf* perf, int i) {
+    return (perf->valid[i]) ? (double)perf->value[i] : 0.0 / 0.0;
+}
+
+void benchmark_perf_print(const char* name, struct benchmark_perf* perf, double iterations) {
+    double cycles = benchmark_perf_value(perf, BENCHMARK_PERF_CYCLES);
+    double instructions = benchmark_perf_value(perf, BENCHMARK_PERF_INSTRUCTIONS);
+    fprintf(stdout, "  %-10s cycles: %8.3lf G, instructions: %8.3lf G, IPC: %5.2lf, "
+            "L1d misses: %8.3lf M, LLC misses: %8.3lf M, branch misses: %8.3lf M, "
+            "cpu: %7.1lf ms",
+            name, cycles * 1e-9, instructions * 1e-9, instructions / cycles,
+            benchmark_perf_value(perf, BENCHMARK_PERF_L1D_MISSES) * 1e-6,
+            benchmark_perf_value(perf, BENCHMARK_PERF_LLC_MISSES) * 1e-6,
+            benchmark_perf_value(perf, BENCHMARK_PERF_BRANCH_MISSES) * 1e-6,
+            benchmark_perf_value(perf, BENCHMARK_PERF_TASK_CLOCK) * 1e-6);
+    if (iterations > 0) {
+        fprintf(stdout, ", iterations/cycle: %5.3lf", iterations / cycles);
+    }
+    fprintf(stdout, "\n");
+}
+
+void benchmark_perf_close(struct benchmark_perf* perf) {
+    for (int i = 0; i < BENCHMARK_PERF_COUNTERS; i++) {
+        if (perf->fd[i] >= 0) {
+            close(perf->fd[i]);
+            perf->fd[i] = -1;
+        }
+    }
+}
+
+#endif
+
+#endif
@@ -0,0 +1,62 @@
+#include "renderer_software.c"
+
+#ifndef WIDTH
+#define WIDTH 800
+#endif
+
+#ifndef HEIGHT
+#define HEIGHT 600
+#endif
+
+#ifndef RUNS
+#define RUNS 1000
+#endif
+
+/* Encoding is slower than rendering: a run per 50 renders. */
+#define PNG_RUNS ((RUNS / 50 > 0) ? RUNS / 50 : 1)
+
+#define _STRINGIFY(str) #str
+#define STRINGIFY(str) _STRINGIFY(str)
+
+#define BENCHMARK_IMPL
+#include "benchmark.h"
+#include "png.h"
+
+/** benchmark_png times runs writes of buffer to a temporary file by write. */
+static void benchmark_png(const char* name, bool (*write)(SDL_Surface*, const char*),
+        SDL_Surface* buffer, int runs) {
+    char path[] = "/tmp/benchmark_png_XXXXXX";
+    int fd = mkstemp(path);
+    if (fd < 0) {
+        panic("Error: can't create a temporary file.");
+    }
+    close(fd);
+    benchmark_display_banner(name, runs, "definition "STRINGIFY(WIDTH)"x"STRINGIFY(HEIGHT));
+    long long startt = benchmark_get_time_ns();
+    for (int i = 0; i < runs; i++) {
+        write(buffer, path);
+    }
+    long long endt = benchmark_get_time_ns();
+    benchmark_display_results(startt, endt, runs);
+    unlink(path);
+}
+
+int main(void)
+{
+    SDL_Surface* buffer = SDL_CreateRGBSurface(0, WIDTH, HEIGHT, 32, 0, 0, 0, 0);
+    struct fractal_info fi = {
+        .generator = GEN_MANDELBROT,
+        .max_iter  = 50,
+        .cx        = -0.7,
+        .cy        = 0.0,
+        .dpp       = 0.0035 * 800 / WIDTH,
+    };
+    rdr_sw_pool_init();
+    rdr_sw_render_buffer(buffer, fi, 0.0);
+    benchmark_png("png_write_surface", png_write_surface, buffer, PNG_RUNS);
+    benchmark_png("png_write_surface_mt", png_write_surface_mt, buffer, PNG_RUNS);
+    rdr_sw_pool_free();
+    SDL_FreeSurface(buffer);
+
+    return EXIT_SUCCESS;
+}
@@ -0,0 +1,10 @@
+#include "renderer_software.c"
+
+#include "benchmark_sw_worker.h"
+
+int main(void)
+{
+    benchmark_worker(rdr_sw_hist_worker, RUNS, WIDTH, HEIGHT);
+
+    return EXIT_SUCCESS;
+}
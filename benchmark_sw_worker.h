@@ -13,18 +13,28 @@
 #define RUNS 1000
 #endif
 
+#ifdef BENCHMARK_TILED
+#define BENCHMARK_LAYOUT ", tile-major + swizzle"
+#else
+#define BENCHMARK_LAYOUT ""
+#endif
+
 #define _STRINGIFY(str) #str
 #define STRINGIFY(str) _STRINGIFY(str)
 
 #define BENCHMARK_IMPL
 #include "benchmark.h"
+#ifdef BENCHMARK_PERF
+#include "benchmark_perf.h"
+#endif
 
 #define benchmark_worker(wk, runs, width, height) \
-    benchmark_display_banner(STRINGIFY(wk), runs, "definition "STRINGIFY(width)"x"STRINGIFY(HEIGHT)); \
+    benchmark_display_banner(STRINGIFY(wk), runs, "definition "STRINGIFY(width)"x"STRINGIFY(HEIGHT) BENCHMARK_LAYOUT); \
     long long startt = benchmark_get_time_ns(); \
     _benchmark_worker(wk, runs, width, height); \
     long long endtt = benchmark_get_time_ns(); \
-    benchmark_display_results(startt, endtt, runs);
+    benchmark_display_results(startt, endtt, runs); \
+    _benchmark_worker_perf(wk, runs, width, height);
 
 void _benchmark_worker(worker wk, int runs, int width, int height) {
     /* Init */
@@ -41,6 +51,13 @@ void _benchmark_worker(worker wk, int runs, int width, int height) {
 #ifdef MT
     rdr_sw_threads_init(wk);
 #endif
+#ifdef BENCHMARK_TILED
+    /* Render tile-major like rdr_sw_render built with RDR_SW_TILED, then
+     * swizzle to upload. */
+    fractal.buffer = buffer;
+    fractal.tiled = rdr_sw_tiled_alloc(width, height);
+    SDL_Surface* upload = SDL_CreateRGBSurface(0, width, height, 32, 0, 0, 0, 0);
+#endif
 
     /* Benchmark */
     for (int i = 0; i < runs; i++) {
@@ -48,6 +65,9 @@ void _benchmark_worker(worker wk, int runs, int width, int height) {
         rdr_sw_update_mt(buffer, fi, 0.0);
 #else
         rdr_sw_update(buffer, fi, 0.0, wk);
+#endif
+#ifdef BENCHMARK_TILED
+        rdr_sw_swizzle(upload->pixels, upload->pitch, fractal.tiled, width, height);
 #endif
     }
 
@@ -56,7 +76,122 @@ void _benchmark_worker(worker wk, int runs, int width, int height) {
 #endif
 
     /* Cleanup */
+#ifdef BENCHMARK_TILED
+    free(fractal.tiled);
+    fractal.tiled = NULL;
+    fractal.buffer = NULL;
+    SDL_FreeSurface(upload);
+#endif
+    SDL_FreeSurface(buffer);
+}
+
+#ifdef BENCHMARK_PERF
+static struct benchmark_perf* benchmark_perfs; // per worker.
+
+/** benchmark_perf_open_job opens the counters of each worker thread. */
+static void benchmark_perf_open_job(void* arg, int workeri, int workerc) {
+    benchmark_perf_open(&benchmark_perfs[workeri]);
+}
+
+/** benchmark_iterations returns the iterations computed by wk rendering fi
+ ** to buffer: pixels mirrored or read from the cache are not computed. */
+static double benchmark_iterations(worker wk, SDL_Surface* buffer, struct fractal_info fi) {
+    size_t count = (size_t)buffer->w * buffer->h;
+    struct rdr_sw_profile prof = {
+        .cost = calloc(count, sizeof(uint32_t)),
+    };
+    fractal.profile = &prof;
+#ifdef MT
+    (void)wk;
+    rdr_sw_update_mt(buffer, fi, 0.0);
+#else
+    rdr_sw_update(buffer, fi, 0.0, wk);
+#endif
+    fractal.profile = NULL;
+    double sum = 0.0;
+    for (size_t p = 0; p < count; p++) {
+        sum += prof.cost[p];
+    }
+    free(prof.cost);
+    return sum;
+}
+#endif
+
+/** _benchmark_worker_perf prints the hardware counters of the worker threads
+ ** rendering runs frames of each generator (BENCHMARK_PERF only). Iterations
+ ** are those of the pixels computed, not mirrored. */
+void _benchmark_worker_perf(worker wk, int runs, int width, int height) {
+#ifdef BENCHMARK_PERF
+    SDL_Surface* buffer = SDL_CreateRGBSurface(0, width, height, 32, 0, 0, 0, 0);
+    struct {
+        const char* name;
+        struct fractal_info fi;
+    } views[] = {
+        {"mandelbrot", {.generator = GEN_MANDELBROT, .max_iter = 50,
+            .cx = -0.7, .cy = 0.0, .dpp = 0.0035}},
+        {"julia", {.generator = GEN_JULIA, .max_iter = 50,
+            .cx = 0.0, .cy = 0.0, .dpp = 0.00425, .jx = -0.8, .jy = 0.156}},
+        {"julia_multiset", {.generator = GEN_JULIA_MULTISET, .max_iter = 50,
+            .cx = 0.0, .cy = 0.0, .dpp = 0.00425, .jx = 0.7885, .jy = 0.7885, .n = 2}},
+    };
+#ifdef MT
+    rdr_sw_threads_init(wk);
+    int workerc = rdr_sw_pool_size();
+    benchmark_perfs = calloc(workerc, sizeof(struct benchmark_perf));
+    rdr_sw_run(benchmark_perf_open_job, NULL);
+#else
+    int workerc = 1;
+    benchmark_perfs = calloc(workerc, sizeof(struct benchmark_perf));
+    benchmark_perf_open_job(NULL, 0, 1);
+#endif
+    bool any = false;
+    for (int w = 0; w < workerc; w++) {
+        any |= benchmark_perfs[w].fd[0] >= 0; // cycles.
+    }
+    if (!any) {
+        fprintf(stdout, "  Perf counters unavailable (no PMU, or see /proc/sys/kernel/perf_event_paranoid)\n");
+    }
+    for (size_t v = 0; any && v < sizeof(views) / sizeof(views[0]); v++) {
+        double iterations = benchmark_iterations(wk, buffer, views[v].fi) * runs;
+        for (int w = 0; w < workerc; w++) {
+            benchmark_perf_start(&benchmark_perfs[w]);
+        }
+        for (int i = 0; i < runs; i++) {
+#ifdef MT
+            rdr_sw_update_mt(buffer, views[v].fi, 0.0);
+#else
+            rdr_sw_update(buffer, views[v].fi, 0.0, wk);
+#endif
+        }
+        struct benchmark_perf total;
+        for (int i = 0; i < BENCHMARK_PERF_COUNTERS; i++) {
+            total.fd[i] = -1;
+            total.valid[i] = false;
+            total.value[i] = 0;
+        }
+        for (int w = 0; w < workerc; w++) {
+            benchmark_perf_stop(&benchmark_perfs[w]);
+            benchmark_perf_add(&total, &benchmark_perfs[w]);
+        }
+        fprintf(stdout, "  Perf %s:\n", views[v].name);
+        benchmark_perf_print("total", &total, iterations);
+        for (int w = 0; w < workerc && workerc > 1; w++) {
+            char name[32];
+            snprintf(name, sizeof(name), "worker %d", w);
+            benchmark_perf_print(name, &benchmark_perfs[w], 0.0);
+        }
+    }
+    for (int w = 0; w < workerc; w++) {
+        benchmark_perf_close(&benchmark_perfs[w]);
+    }
+    free(benchmark_perfs);
+#ifdef MT
+    rdr_sw_threads_free();
+#endif
     SDL_FreeSurface(buffer);
+#else
+    (void)wk; (void)runs; (void)width; (void)height;
+#endif
 }
 
 #endif
@@ -1,4 +1,5 @@
-benchmarks_sources:=benchmark_sw_line_worker.c benchmark_sw_area_worker.c
+benchmarks_sources:=benchmark_sw_line_worker.c benchmark_sw_area_worker.c benchmark_sw_area_worker_f64.c benchmark_sw_hist_worker.c benchmark_sw_area_worker_tiled.c \
+		benchmark_png.c benchmark_libfractal.c
 benchmark_build_dir:=$(build_dir)
 
 benchmarks:=$(benchmarks_sources:%.c=%)
@@ -7,6 +8,18 @@ benchmarks_built:=$(addprefix $(build_dir)/,$(benchmarks_sources:%.c=%))
 
 RUNS?=1000
 BENCH_CFLAGS:=-DRUNS=$(RUNS)
+# WIDTH & HEIGHT set the definition (800x600 by default).
+ifdef WIDTH
+BENCH_CFLAGS+=-DWIDTH=$(WIDTH)
+endif
+ifdef HEIGHT
+BENCH_CFLAGS+=-DHEIGHT=$(HEIGHT)
+endif
+# PERF=1 also prints hardware counters (Linux perf_event_open).
+PERF?=0
+ifeq (1,$(PERF))
+BENCH_CFLAGS+=-DBENCHMARK_PERF
+endif
 
 benchmark: $(benchmarks)
 
@@ -0,0 +1,992 @@
+#define _GNU_SOURCE // be32toh & co.
+#include "cluster.h"
+
+#include <endian.h>
+#include <errno.h>
+#include <netdb.h>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <poll.h>
+#include <signal.h>
+#include <stdatomic.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <sys/wait.h>
+#include <time.h>
+#include <unistd.h>
+#include <zlib.h>
+
+#include "compute.h"
+#include "config.h"
+#include "panic.h"
+#include "png.h"
+#include "renderer_software.h"
+
+#define CL_VERSION 1
+#define CL_HEADER 8
+#define CL_FRAME 60
+#define CL_MAX_WORKERS 256
+#define CL_MAX_THREADS 1024
+#define CL_MAX_SIDE 65536
+#define CL_MAX_MESSAGE (1 << 20)
+
+/* Messages: u32 type, u32 payload length, payload; integers are big-endian. */
+enum cl_message {
+    MSG_HELLO = 1, // worker: u32 version, u32 threads.
+    MSG_FRAME,     // coordinator: view (see cl_frame_encode).
+    MSG_TILE,      // coordinator: u32 tile to render.
+    MSG_RESULT,    // worker: u32 tile, u64 compute ns, zlib'd delta iterations.
+    MSG_BYE,       // coordinator: frame done, worker must exit.
+};
+
+/** cl_frame is the view shared by the coordinator & its workers. */
+struct cl_frame {
+    struct fractal_info fi;
+    int width, height;
+    int tiles_x, tiles_y;
+};
+
+enum cl_tile_state {
+    TILE_QUEUED,
+    TILE_ASSIGNED,
+    TILE_DONE,
+};
+
+struct cl_tile {
+    enum cl_tile_state state;
+    /** owners is the number of workers rendering the tile. */
+    int owners;
+    long long assigned_ns;
+};
+
+/** cl_conn is a worker connection of the coordinator. */
+struct cl_conn {
+    int fd;
+    bool hello;
+    int threads;
+    int* tiles; // tiles assigned & not returned yet.
+    int tilec;
+    uint8_t* in;
+    size_t inlen, incap;
+    /* Stats. */
+    long long rendered;
+    long long duplicates;
+    long long requeued;
+    long long cpu_ns;
+    long long duplicate_ns; // CPU time of duplicates, included in cpu_ns.
+    long long start_ns, end_ns;
+    unsigned long long bytes;
+};
+
+static struct {
+    struct cl_frame frame;
+    struct cl_tile* tiles;
+    int tilec;
+    int done;
+    int first_queued; // no queued tile before it.
+    int32_t* iters;
+    struct cl_conn conns[CL_MAX_WORKERS];
+    int connc; // connections accepted so far.
+} cl;
+
+static volatile sig_atomic_t cl_interrupted = 0;
+
+static void cl_on_signal(int sig) {
+    (void)sig;
+    cl_interrupted = 1;
+}
+
+static long long cl_clock_ns(clockid_t clock) {
+    struct timespec tp;
+    clock_gettime(clock, &tp);
+    return (long long)tp.tv_sec * 1000000000LL + tp.tv_nsec;
+}
+
+static long long cl_now_ns(void) {
+    return cl_clock_ns(CLOCK_MONOTONIC);
+}
+
+static uint8_t* cl_put_u32(uint8_t* p, uint32_t v) {
+    v = htobe32(v);
+    memcpy(p, &v, 4);
+    return p + 4;
+}
+
+static uint8_t* cl_put_u64(uint8_t* p, uint64_t v) {
+    v = htobe64(v);
+    memcpy(p, &v, 8);
+    return p + 8;
+}
+
+static uint8_t* cl_put_f64(uint8_t* p, double d) {
+    uint64_t v;
+    memcpy(&v, &d, 8);
+    return cl_put_u64(p, v);
+}
+
+static uint32_t cl_get_u32(const uint8_t** p) {
+    uint32_t v;
+    memcpy(&v, *p, 4);
+    *p += 4;
+    return be32toh(v);
+}
+
+static uint64_t cl_get_u64(const uint8_t** p) {
+    uint64_t v;
+    memcpy(&v, *p, 8);
+    *p += 8;
+    return be64toh(v);
+}
+
+static double cl_get_f64(const uint8_t** p) {
+    uint64_t v = cl_get_u64(p);
+    double d;
+    memcpy(&d, &v, 8);
+    return d;
+}
+
+static void cl_frame_init(struct cl_frame* frame, struct fractal_info fi, int width, int height) {
+    frame->fi = fi;
+    frame->width = width;
+    frame->height = height;
+    frame->tiles_x = (width + CLUSTER_TILE_SIZE - 1) / CLUSTER_TILE_SIZE;
+    frame->tiles_y = (height + CLUSTER_TILE_SIZE - 1) / CLUSTER_TILE_SIZE;
+}
+
+static void cl_frame_encode(uint8_t* p, const struct cl_frame* frame) {
+    const struct fractal_info* fi = &frame->fi;
+    p = cl_put_u32(p, fi->generator);
+    p = cl_put_u32(p, fi->max_iter);
+    p = cl_put_u32(p, fi->n);
+    p = cl_put_u32(p, frame->width);
+    p = cl_put_u32(p, frame->height);
+    p = cl_put_f64(p, fi->cx);
+    p = cl_put_f64(p, fi->cy);
+    p = cl_put_f64(p, fi->dpp);
+    p = cl_put_f64(p, fi->jx);
+    cl_put_f64(p, fi->jy);
+}
+
+static bool cl_frame_decode(const uint8_t* p, struct cl_frame* frame) {
+    struct fractal_info fi = {0};
+    fi.generator = cl_get_u32(&p);
+    fi.max_iter = cl_get_u32(&p);
+    fi.n = cl_get_u32(&p);
+    uint32_t width = cl_get_u32(&p);
+    uint32_t height = cl_get_u32(&p);
+    fi.cx = cl_get_f64(&p);
+    fi.cy = cl_get_f64(&p);
+    fi.dpp = cl_get_f64(&p);
+    fi.jx = cl_get_f64(&p);
+    fi.jy = cl_get_f64(&p);
+    if (fi.generator > GEN_NEBULABROT || width == 0 || height == 0
+            || width > CL_MAX_SIDE || height > CL_MAX_SIDE) {
+        return false;
+    }
+    cl_frame_init(frame, fi, width, height);
+    return true;
+}
+
+/** cl_tile_rect sets the area of tile k of frame. */
+static void cl_tile_rect(const struct cl_frame* frame, int k, int* x0, int* y0, int* w, int* h) {
+    *x0 = (k % frame->tiles_x) * CLUSTER_TILE_SIZE;
+    *y0 = (k / frame->tiles_x) * CLUSTER_TILE_SIZE;
+    *w = (frame->width - *x0 < CLUSTER_TILE_SIZE) ? frame->width - *x0 : CLUSTER_TILE_SIZE;
+    *h = (frame->height - *y0 < CLUSTER_TILE_SIZE) ? frame->height - *y0 : CLUSTER_TILE_SIZE;
+}
+
+/** cl_socket returns a socket listening on or connected to addr,
+ ** "unix:PATH" or "[HOST:]PORT". Returns -1 on error. */
+static int cl_socket(const char* addr, bool listening) {
+    int on = 1;
+    if (strncmp(addr, "unix:", 5) == 0) {
+        struct sockaddr_un sun = {0};
+        sun.sun_family = AF_UNIX;
+        if (strlen(addr + 5) >= sizeof(sun.sun_path)) {
+            errno = ENAMETOOLONG;
+            return -1;
+        }
+        strcpy(sun.sun_path, addr + 5);
+        int fd = socket(AF_UNIX, SOCK_STREAM, 0);
+        if (fd < 0) {
+            return -1;
+        }
+        if (listening) {
+            unlink(sun.sun_path);
+            if (bind(fd, (struct sockaddr*)&sun, sizeof(sun)) != 0 || listen(fd, 64) != 0) {
+                close(fd);
+                return -1;
+            }
+        } else if (connect(fd, (struct sockaddr*)&sun, sizeof(sun)) != 0) {
+            close(fd);
+            return -1;
+        }
+        return fd;
+    }
+    char host[256] = "localhost";
+    const char* port = strrchr(addr, ':');
+    if (port) {
+        size_t len = port - addr;
+        if (len >= sizeof(host)) {
+            errno = ENAMETOOLONG;
+            return -1;
+        }
+        memcpy(host, addr, len);
+        host[len] = '\0';
+        port++;
+    } else {
+        port = addr;
+    }
+    struct addrinfo hints = {0};
+    struct addrinfo* res = NULL;
+    hints.ai_family = AF_UNSPEC;
+    hints.ai_socktype = SOCK_STREAM;
+    if (getaddrinfo(host, port, &hints, &res) != 0) {
+        errno = EINVAL;
+        return -1;
+    }
+    int fd = -1;
+    for (struct addrinfo* ai = res; ai; ai = ai->ai_next) {
+        fd = socket(ai->ai_family, ai->ai_socktype, ai->ai_protocol);
+        if (fd < 0) {
+            continue;
+        }
+        if (listening) {
+            setsockopt(fd, SOL_SOCKET, SO_REUSEADDR, &on, sizeof(on));
+            if (bind(fd, ai->ai_addr, ai->ai_addrlen) == 0 && listen(fd, 64) == 0) {
+                break;
+            }
+        } else if (connect(fd, ai->ai_addr, ai->ai_addrlen) == 0) {
+            setsockopt(fd, IPPROTO_TCP, TCP_NODELAY, &on, sizeof(on));
+            break;
+        }
+        close(fd);
+        fd = -1;
+    }
+    freeaddrinfo(res);
+    return fd;
+}
+
+static bool cl_write_all(int fd, const uint8_t* data, size_t len) {
+    while (len > 0) {
+        ssize_t n = send(fd, data, len, MSG_NOSIGNAL);
+        if (n < 0) {
+            if (errno == EINTR) {
+                continue;
+            }
+            return false;
+        }
+        data += n;
+        len -= n;
+    }
+    return true;
+}
+
+static bool cl_read_all(int fd, uint8_t* data, size_t len) {
+    while (len > 0) {
+        ssize_t n = recv(fd, data, len, 0);
+        if (n < 0 && errno == EINTR) {
+            continue;
+        }
+        if (n <= 0) {
+            return false;
+        }
+        data += n;
+        len -= n;
+    }
+    return true;
+}
+
+/** cl_send sends message type with payload data of len bytes to fd. */
+static bool cl_send(int fd, uint32_t type, const uint8_t* data, size_t len) {
+    uint8_t header[CL_HEADER];
+    cl_put_u32(cl_put_u32(header, type), len);
+    return cl_write_all(fd, header, CL_HEADER) && cl_write_all(fd, data, len);
+}
+
+/** cl_encode delta encodes then compresses count iterations to out (of
+ ** compressBound(count * 4) bytes); iters is overwritten. */
+static bool cl_encode(int32_t* iters, int count, uint8_t* out, size_t* len) {
+    uint32_t prev = 0;
+    for (int i = 0; i < count; i++) {
+        uint32_t v = (uint32_t)iters[i];
+        uint32_t d = htobe32(v - prev);
+        prev = v;
+        memcpy(&iters[i], &d, 4);
+    }
+    uLongf size = compressBound(count * 4);
+    if (compress2(out, &size, (const Bytef*)iters, count * 4, 1) != Z_OK) {
+        return false;
+    }
+    *len = size;
+    return true;
+}
+
+/** cl_decode reverses cl_encode: decompresses data of len bytes to count
+ ** iterations. */
+static bool cl_decode(const uint8_t* data, size_t len, int32_t* iters, int count) {
+    uLongf size = count * 4;
+    if (uncompress((Bytef*)iters, &size, data, len) != Z_OK || size != (uLongf)count * 4) {
+        return false;
+    }
+    uint32_t prev = 0;
+    for (int i = 0; i < count; i++) {
+        uint32_t d;
+        memcpy(&d, &iters[i], 4);
+        prev += be32toh(d);
+        iters[i] = (int32_t)prev;
+    }
+    return true;
+}
+
+/* Coordinator */
+
+/** cl_next_queued returns the first queued tile, -1 if none. */
+static int cl_next_queued(void) {
+    while (cl.first_queued < cl.tilec && cl.tiles[cl.first_queued].state != TILE_QUEUED) {
+        cl.first_queued++;
+    }
+    return (cl.first_queued < cl.tilec) ? cl.first_queued : -1;
+}
+
+/** cl_straggler returns the oldest tile rendered by a single worker other
+ ** than conn, -1 if none. */
+static int cl_straggler(struct cl_conn* conn) {
+    int oldest = -1;
+    for (int c = 0; c < cl.connc; c++) {
+        struct cl_conn* other = &cl.conns[c];
+        if (other == conn || other->fd < 0) {
+            continue;
+        }
+        for (int t = 0; t < other->tilec; t++) {
+            struct cl_tile* tile = &cl.tiles[other->tiles[t]];
+            if (tile->state == TILE_ASSIGNED && tile->owners == 1
+                    && (oldest < 0 || tile->assigned_ns < cl.tiles[oldest].assigned_ns)) {
+                oldest = other->tiles[t];
+            }
+        }
+    }
+    return oldest;
+}
+
+/** cl_assign keeps conn busy: two tiles per thread are pending so that the
+ ** worker never waits for the network; once the queue is empty an idle worker
+ ** duplicates a straggler tile. Returns false if conn is lost. */
+static bool cl_assign(struct cl_conn* conn) {
+    while (conn->tilec < 2 * conn->threads) {
+        int k = cl_next_queued();
+        if (k < 0) {
+            if (conn->tilec > 0 || (k = cl_straggler(conn)) < 0) {
+                break;
+            }
+        }
+        cl.tiles[k].state = TILE_ASSIGNED;
+        cl.tiles[k].owners++;
+        cl.tiles[k].assigned_ns = cl_now_ns();
+        conn->tiles[conn->tilec++] = k;
+        uint8_t payload[4];
+        cl_put_u32(payload, k);
+        if (!cl_send(conn->fd, MSG_TILE, payload, sizeof(payload))) {
+            return false;
+        }
+    }
+    return true;
+}
+
+/** cl_drop closes conn and queues again the tiles it was the only one to
+ ** render. */
+static void cl_drop(struct cl_conn* conn) {
+    for (int t = 0; t < conn->tilec; t++) {
+        struct cl_tile* tile = &cl.tiles[conn->tiles[t]];
+        tile->owners--;
+        if (tile->owners == 0 && tile->state != TILE_DONE) {
+            tile->state = TILE_QUEUED;
+            if (conn->tiles[t] < cl.first_queued) {
+                cl.first_queued = conn->tiles[t];
+            }
+            conn->requeued++;
+        }
+    }
+    conn->tilec = 0;
+    conn->end_ns = cl_now_ns();
+    close(conn->fd);
+    conn->fd = -1;
+    if (cl.done < cl.tilec) {
+        fprintf(stdout, "> worker %d lost, %lld tiles queued again\n",
+                (int)(conn - cl.conns), conn->requeued);
+    }
+}
+
+/** cl_result stores tile result data of len bytes from conn. */
+static bool cl_result(struct cl_conn* conn, const uint8_t* data, size_t len) {
+    if (len < 12) {
+        return false;
+    }
+    int k = (int)cl_get_u32(&data);
+    long long ns = (long long)cl_get_u64(&data);
+    len -= 12;
+    int t = 0;
+    while (t < conn->tilec && conn->tiles[t] != k) {
+        t++;
+    }
+    if (t == conn->tilec) {
+        return false;
+    }
+    struct cl_tile* tile = &cl.tiles[k];
+    if (tile->state != TILE_DONE) {
+        int x0, y0, w, h;
+        cl_tile_rect(&cl.frame, k, &x0, &y0, &w, &h);
+        int32_t iters[CLUSTER_TILE_SIZE * CLUSTER_TILE_SIZE];
+        if (!cl_decode(data, len, iters, w * h)) {
+            return false;
+        }
+        for (int y = 0; y < h; y++) {
+            memcpy(cl.iters + (size_t)(y0 + y) * cl.frame.width + x0,
+                    iters + y * w, w * sizeof(int32_t));
+        }
+        tile->state = TILE_DONE;
+        cl.done++;
+        conn->rendered++;
+        if (cl.done % ((cl.tilec + 9) / 10) == 0 || cl.done == cl.tilec) {
+            fprintf(stdout, "> %d/%d tiles\n", cl.done, cl.tilec);
+        }
+    } else {
+        conn->duplicates++;
+        conn->duplicate_ns += ns;
+    }
+    tile->owners--;
+    conn->tiles[t] = conn->tiles[--conn->tilec];
+    conn->cpu_ns += ns;
+    conn->end_ns = cl_now_ns();
+    return true;
+}
+
+/** cl_handle handles a message of conn. Returns false if conn must be dropped. */
+static bool cl_handle(struct cl_conn* conn, uint32_t type, const uint8_t* data, size_t len) {
+    switch (type) {
+        case MSG_HELLO: {
+            if (conn->hello || len != 8) {
+                return false;
+            }
+            uint32_t version = cl_get_u32(&data);
+            uint32_t threads = cl_get_u32(&data);
+            if (version != CL_VERSION || threads == 0 || threads > CL_MAX_THREADS) {
+                fprintf(stderr, "Can't use worker %d: version %u, %u threads.\n",
+                        (int)(conn - cl.conns), version, threads);
+                return false;
+            }
+            conn->hello = true;
+            conn->threads = threads;
+            conn->tiles = calloc(2 * threads, sizeof(int));
+            conn->start_ns = cl_now_ns();
+            conn->end_ns = conn->start_ns;
+            fprintf(stdout, "> worker %d connected (%u threads)\n",
+                    (int)(conn - cl.conns), threads);
+            uint8_t frame[CL_FRAME];
+            cl_frame_encode(frame, &cl.frame);
+            return cl_send(conn->fd, MSG_FRAME, frame, sizeof(frame)) && cl_assign(conn);
+        }
+        case MSG_RESULT:
+            return conn->hello && cl_result(conn, data, len) && cl_assign(conn);
+        default:
+            return false;
+    }
+}
+
+/** cl_receive reads pending data of conn & handles complete messages.
+ ** Returns false if conn must be dropped. */
+static bool cl_receive(struct cl_conn* conn) {
+    if (conn->incap - conn->inlen < 65536) {
+        conn->incap = conn->incap * 2 + 65536;
+        conn->in = realloc(conn->in, conn->incap);
+        if (!conn->in) {
+            panic("Error: can't allocate worker buffer.");
+        }
+    }
+    ssize_t n = recv(conn->fd, conn->in + conn->inlen, conn->incap - conn->inlen, MSG_DONTWAIT);
+    if (n < 0 && (errno == EAGAIN || errno == EINTR)) {
+        return true;
+    }
+    if (n <= 0) {
+        return false;
+    }
+    conn->inlen += n;
+    conn->bytes += n;
+    size_t pos = 0;
+    while (conn->inlen - pos >= CL_HEADER) {
+        const uint8_t* p = conn->in + pos;
+        uint32_t type = cl_get_u32(&p);
+        uint32_t len = cl_get_u32(&p);
+        if (len > CL_MAX_MESSAGE) {
+            return false;
+        }
+        if (conn->inlen - pos < CL_HEADER + len) {
+            break;
+        }
+        if (!cl_handle(conn, type, p, len)) {
+            return false;
+        }
+        pos += CL_HEADER + len;
+    }
+    memmove(conn->in, conn->in + pos, conn->inlen - pos);
+    conn->inlen -= pos;
+    return true;
+}
+
+/** CL_BASELINE_FILE records the wall time of frames rendered by one worker,
+ ** in the cache directory (see config_cache_path). */
+#define CL_BASELINE_FILE "cluster-baseline.txt"
+
+/** cl_baseline returns the one worker wall time of the frame recorded in
+ ** CL_BASELINE_FILE, 0 if none. With a single worker, wall is recorded first
+ ** in place of the previous one. */
+static double cl_baseline(int workers, double wall) {
+    char key[256];
+    const struct fractal_info* fi = &cl.frame.fi;
+    /* %.17g round-trips doubles. */
+    snprintf(key, sizeof(key), "%d %d %d %d %.17g %.17g %.17g %.17g %.17g %d",
+            fi->generator, cl.frame.width, cl.frame.height, fi->max_iter,
+            fi->cx, fi->cy, fi->dpp, fi->jx, fi->jy, fi->n);
+    char** lines = NULL;
+    size_t linec = 0;
+    double baseline = 0;
+    char* path = config_cache_path(CL_BASELINE_FILE);
+    FILE* fp = fopen(path, "r");
+    char line[512];
+    while (fp && fgets(line, sizeof(line), fp)) {
+        size_t len = strlen(key);
+        if (strncmp(line, key, len) == 0 && line[len] == ' ') {
+            baseline = strtod(line + len + 1, NULL);
+            continue;
+        }
+        char** grown = realloc(lines, (linec + 1) * sizeof(char*));
+        if (!grown) {
+            break;
+        }
+        lines = grown;
+        lines[linec++] = strdup(line);
+    }
+    if (fp) {
+        fclose(fp);
+    }
+    if (workers == 1) {
+        baseline = wall;
+        fp = fopen(path, "w");
+        if (!fp) {
+            fprintf(stderr, "Can't write baseline file `%s`.\n", path);
+        }
+        for (size_t i = 0; fp && i < linec; i++) {
+            fputs(lines[i], fp);
+        }
+        if (fp) {
+            fprintf(fp, "%s %.6lf\n", key, wall);
+            fclose(fp);
+        }
+    }
+    for (size_t i = 0; i < linec; i++) {
+        free(lines[i]);
+    }
+    free(lines);
+    free(path);
+    return baseline;
+}
+
+/** cl_report prints the stats of each worker & the scaling efficiency: the
+ ** speedup over the one worker run of the frame per worker. */
+static void cl_report(long long wall_ns) {
+    double wall = wall_ns * 1e-9;
+    long long cpu_ns = 0, duplicate_ns = 0;
+    long long duplicates = 0, requeued = 0;
+    int workers = 0, threads = 0;
+    for (int c = 0; c < cl.connc; c++) {
+        struct cl_conn* conn = &cl.conns[c];
+        if (!conn->hello) {
+            continue;
+        }
+        double span = (conn->end_ns - conn->start_ns) * 1e-9;
+        double efficiency = (span > 0) ? conn->cpu_ns * 1e-9 / (span * conn->threads) : 0;
+        fprintf(stdout, "> worker %d: %lld tiles, %lld duplicates (%.2lf s cpu), %lld queued again, "
+                "%.2lf s cpu, %.1lf%% busy (%d threads), %.1lf MiB received\n",
+                c, conn->rendered, conn->duplicates, conn->duplicate_ns * 1e-9, conn->requeued,
+                conn->cpu_ns * 1e-9, 100 * efficiency, conn->threads,
+                conn->bytes / (1024.0 * 1024.0));
+        cpu_ns += conn->cpu_ns;
+        duplicate_ns += conn->duplicate_ns;
+        duplicates += conn->duplicates;
+        requeued += conn->requeued;
+        workers++;
+        threads += conn->threads;
+    }
+    fprintf(stdout, "> %d tiles (%dx%d) in %.3lf s, %.2lf Mpixels/s\n", cl.tilec,
+            cl.frame.width, cl.frame.height, wall,
+            (wall > 0) ? (double)cl.frame.width * cl.frame.height / wall * 1e-6 : 0);
+    /* Duplicated tiles are wasted work, not parallelism. */
+    double useful = (cpu_ns - duplicate_ns) * 1e-9;
+    fprintf(stdout, "> %d workers, %d threads: %.2lf s useful cpu (%.2lf threads busy), "
+            "%lld tiles duplicated (%.2lf s cpu), %lld queued again\n", workers, threads,
+            useful, (wall > 0) ? useful / wall : 0, duplicates, duplicate_ns * 1e-9, requeued);
+    double baseline = cl_baseline(workers, wall);
+    if (workers == 1) {
+        char* path = config_cache_path(CL_BASELINE_FILE);
+        fprintf(stdout, "> one worker baseline recorded to `%s`\n", path);
+        free(path);
+    } else if (baseline > 0 && wall > 0) {
+        double speedup = baseline / wall;
+        fprintf(stdout, "> speedup %.2lf over one worker (%.3lf s), %.1lf%% scaling efficiency\n",
+                speedup, baseline, 100 * speedup / workers);
+    } else {
+        fprintf(stdout, "> no one worker baseline of this frame: run it with one worker "
+                "to measure scaling efficiency\n");
+    }
+}
+
+/** cl_write_png colors the iterations of the frame & writes them to output. */
+static bool cl_write_png(const char* output) {
+    SDL_Surface* surface = SDL_CreateRGBSurface(0, cl.frame.width, cl.frame.height, 32, 0, 0, 0, 0);
+    if (!surface) {
+        fprintf(stderr, "Can't create a %dx%d surface.\n", cl.frame.width, cl.frame.height);
+        return false;
+    }
+    for (int y = 0; y < surface->h; y++) {
+        uint32_t* pixels = (uint32_t*)((uint8_t*)surface->pixels + y * surface->pitch);
+        const int32_t* iters = cl.iters + (size_t)y * surface->w;
+        for (int x = 0; x < surface->w; x++) {
+            pixels[x] = rdr_sw_map_color(surface->format, iters[x], cl.frame.fi.max_iter);
+        }
+    }
+    /* Local workers are gone: encode with a pool of our own. */
+    rdr_sw_pool_init();
+    bool ok = png_write_surface_mt(surface, output);
+    rdr_sw_pool_free();
+    SDL_FreeSurface(surface);
+    return ok;
+}
+
+bool cluster_coordinate(struct fractal_info fi, int width, int height,
+        const char* addr, int spawn, const char* output) {
+    memset(&cl, 0, sizeof(cl));
+    cl_frame_init(&cl.frame, fi_at(fi, 0.0), width, height);
+    cl.tilec = cl.frame.tiles_x * cl.frame.tiles_y;
+    cl.tiles = calloc(cl.tilec, sizeof(struct cl_tile));
+    cl.iters = calloc((size_t)width * height, sizeof(int32_t));
+    if (!cl.tiles || !cl.iters) {
+        fprintf(stderr, "Can't allocate a %dx%d frame.\n", width, height);
+        free(cl.tiles);
+        free(cl.iters);
+        return false;
+    }
+    int lfd = cl_socket(addr, true);
+    if (lfd < 0) {
+        fprintf(stderr, "Can't listen on `%s`: %s.\n", addr, strerror(errno));
+        free(cl.tiles);
+        free(cl.iters);
+        return false;
+    }
+    /* Signals. */
+    struct sigaction sa = {0};
+    sa.sa_handler = cl_on_signal;
+    sigaction(SIGINT, &sa, NULL);
+    sigaction(SIGTERM, &sa, NULL);
+    fprintf(stdout, "> coordinating %d tiles on `%s`\n", cl.tilec, addr);
+    /* Local workers. */
+    pid_t* children = calloc(spawn > 0 ? spawn : 1, sizeof(pid_t));
+    int childc = 0;
+    for (int i = 0; i < spawn; i++) {
+        fflush(stdout);
+        pid_t pid = fork();
+        if (pid < 0) {
+            perror("fork");
+            break;
+        }
+        if (pid == 0) {
+            signal(SIGINT, SIG_DFL);
+            signal(SIGTERM, SIG_DFL);
+            close(lfd);
+            rdr_sw_pool_init();
+            bool ok = cluster_work(addr);
+            rdr_sw_pool_free();
+            fflush(stdout);
+            _exit(ok ? EXIT_SUCCESS : EXIT_FAILURE);
+        }
+        children[childc++] = pid;
+    }
+
+    long long start_ns = 0;
+    struct pollfd pfds[CL_MAX_WORKERS + 1];
+    int map[CL_MAX_WORKERS + 1];
+    while (cl.done < cl.tilec && !cl_interrupted) {
+        int pfdc = 0;
+        if (cl.connc < CL_MAX_WORKERS) {
+            pfds[pfdc++] = (struct pollfd){ .fd = lfd, .events = POLLIN };
+        }
+        int live = 0;
+        for (int c = 0; c < cl.connc; c++) {
+            if (cl.conns[c].fd >= 0) {
+                map[pfdc] = c;
+                pfds[pfdc++] = (struct pollfd){ .fd = cl.conns[c].fd, .events = POLLIN };
+                live++;
+            }
+        }
+        /* Spawned workers may all be gone. */
+        if (spawn > 0 && live == 0) {
+            int running = 0;
+            for (int i = 0; i < childc; i++) {
+                if (children[i] > 0 && waitpid(children[i], NULL, WNOHANG) == children[i]) {
+                    children[i] = 0;
+                }
+                running += (children[i] > 0);
+            }
+            if (running == 0) {
+                fprintf(stderr, "Can't render frame: all spawned workers exited.\n");
+                break;
+            }
+        }
+        int n = poll(pfds, pfdc, 1000);
+        if (n < 0) {
+            if (errno == EINTR) {
+                continue;
+            }
+            perror("poll");
+            break;
+        }
+        for (int p = 0; p < pfdc; p++) {
+            if (!pfds[p].revents) {
+                continue;
+            }
+            if (pfds[p].fd == lfd) {
+                int fd = accept(lfd, NULL, NULL);
+                if (fd < 0) {
+                    continue;
+                }
+                int on = 1;
+                setsockopt(fd, IPPROTO_TCP, TCP_NODELAY, &on, sizeof(on));
+                cl.conns[cl.connc].fd = fd;
+                cl.connc++;
+                if (start_ns == 0) {
+                    start_ns = cl_now_ns();
+                }
+                continue;
+            }
+            struct cl_conn* conn = &cl.conns[map[p]];
+            if (conn->fd >= 0 && !cl_receive(conn)) {
+                cl_drop(conn);
+            }
+        }
+        /* Give tiles queued again & stragglers to idle workers. */
+        for (int c = 0; c < cl.connc && cl.done < cl.tilec; c++) {
+            struct cl_conn* conn = &cl.conns[c];
+            if (conn->fd >= 0 && conn->hello && !cl_assign(conn)) {
+                cl_drop(conn);
+            }
+        }
+    }
+    long long wall_ns = cl_now_ns() - start_ns;
+
+    /* Shutdown: workers exit on bye or when the connection closes. */
+    for (int c = 0; c < cl.connc; c++) {
+        if (cl.conns[c].fd >= 0) {
+            cl_send(cl.conns[c].fd, MSG_BYE, NULL, 0);
+            close(cl.conns[c].fd);
+            cl.conns[c].fd = -1;
+        }
+    }
+    close(lfd);
+    if (strncmp(addr, "unix:", 5) == 0) {
+        unlink(addr + 5);
+    }
+    for (int i = 0; i < childc; i++) {
+        if (children[i] > 0) {
+            kill(children[i], SIGTERM);
+            waitpid(children[i], NULL, 0);
+        }
+    }
+    free(children);
+
+    bool ok = cl.done == cl.tilec;
+    if (ok) {
+        cl_report(wall_ns);
+        ok = cl_write_png(output);
+        if (ok) {
+            fprintf(stdout, "> frame written to `%s`\n", output);
+        }
+    } else {
+        fprintf(stderr, "Can't render frame: %d/%d tiles done.\n", cl.done, cl.tilec);
+    }
+    for (int c = 0; c < cl.connc; c++) {
+        free(cl.conns[c].tiles);
+        free(cl.conns[c].in);
+    }
+    free(cl.tiles);
+    free(cl.iters);
+    return ok;
+}
+
+/* Worker */
+
+/** cl_batch is a set of tiles rendered in parallel by the pool of a worker. */
+struct cl_batch {
+    const struct cl_frame* frame;
+    int* tiles;
+    int tilec;
+    atomic_int next;
+    int32_t** iters; // per tile.
+    uint8_t** data;  // per tile.
+    size_t* len;
+    long long* ns;
+    atomic_bool failed;
+};
+
+/** cl_batch_worker renders & encodes tiles until all tiles of the batch are taken. */
+static void cl_batch_worker(void* arg, int workeri, int workerc) {
+    (void)workeri;
+    (void)workerc;
+    struct cl_batch* batch = arg;
+    int i;
+    while ((i = atomic_fetch_add(&batch->next, 1)) < batch->tilec) {
+        /* CPU time: workers may share processors. */
+        long long start = cl_clock_ns(CLOCK_THREAD_CPUTIME_ID);
+        int x0, y0, w, h;
+        cl_tile_rect(batch->frame, batch->tiles[i], &x0, &y0, &w, &h);
+        compute_iters(batch->iters[i], batch->frame->fi,
+                batch->frame->width, batch->frame->height, x0, y0, w, h);
+        batch->ns[i] = cl_clock_ns(CLOCK_THREAD_CPUTIME_ID) - start;
+        if (!cl_encode(batch->iters[i], w * h, batch->data[i], &batch->len[i])) {
+            atomic_store(&batch->failed, true);
+        }
+    }
+}
+
+/** cl_readable tells if data can be read from fd without blocking. */
+static bool cl_readable(int fd) {
+    struct pollfd pfd = { .fd = fd, .events = POLLIN };
+    return poll(&pfd, 1, 0) > 0;
+}
+
+bool cluster_work(const char* addr) {
+    int fd = -1;
+    for (int attempt = 0; attempt < 50 && fd < 0; attempt++) {
+        fd = cl_socket(addr, false);
+        if (fd < 0) {
+            usleep(100000);
+        }
+    }
+    if (fd < 0) {
+        fprintf(stderr, "Can't connect to coordinator `%s`: %s.\n", addr, strerror(errno));
+        return false;
+    }
+    int threads = rdr_sw_pool_size();
+    uint8_t hello[8];
+    cl_put_u32(cl_put_u32(hello, CL_VERSION), threads);
+    if (!cl_send(fd, MSG_HELLO, hello, sizeof(hello))) {
+        fprintf(stderr, "Can't greet coordinator `%s`.\n", addr);
+        close(fd);
+        return false;
+    }
+    /* Batch buffers, one slot per thread. */
+    int count = CLUSTER_TILE_SIZE * CLUSTER_TILE_SIZE;
+    size_t bound = compressBound(count * 4);
+    struct cl_frame frame = {0};
+    struct cl_batch batch = {0};
+    batch.frame = &frame;
+    batch.iters = calloc(threads, sizeof(int32_t*));
+    batch.data = calloc(threads, sizeof(uint8_t*));
+    batch.len = calloc(threads, sizeof(size_t));
+    batch.ns = calloc(threads, sizeof(long long));
+    for (int i = 0; i < threads; i++) {
+        batch.iters[i] = malloc(count * sizeof(int32_t));
+        batch.data[i] = malloc(bound);
+        if (!batch.iters[i] || !batch.data[i]) {
+            panic("Error: can't allocate worker buffers.");
+        }
+    }
+    uint8_t* message = malloc(CL_HEADER + 12 + bound);
+    /* Tiles received & not rendered yet. */
+    int pendingcap = 2 * threads;
+    int* pending = calloc(pendingcap, sizeof(int));
+    int pendingc = 0;
+
+    bool has_frame = false, done = false, ok = true;
+    long long rendered = 0;
+    while (ok && !done) {
+        /* Render once no more tile is immediately available. */
+        if (pendingc > 0 && (pendingc >= threads || !cl_readable(fd))) {
+            batch.tiles = pending;
+            batch.tilec = (pendingc < threads) ? pendingc : threads;
+            atomic_init(&batch.next, 0);
+            atomic_init(&batch.failed, false);
+            rdr_sw_run(cl_batch_worker, &batch);
+            if (atomic_load(&batch.failed)) {
+                fprintf(stderr, "Can't compress tiles.\n");
+                ok = false;
+                break;
+            }
+            for (int i = 0; i < batch.tilec && !done; i++) {
+                uint8_t* p = message;
+                p = cl_put_u32(p, pending[i]);
+                p = cl_put_u64(p, batch.ns[i]);
+                memcpy(p, batch.data[i], batch.len[i]);
+                done = !cl_send(fd, MSG_RESULT, message, 12 + batch.len[i]);
+            }
+            rendered += batch.tilec;
+            pendingc -= batch.tilec;
+            memmove(pending, pending + batch.tilec, pendingc * sizeof(int));
+            continue;
+        }
+        uint8_t header[CL_HEADER];
+        if (!cl_read_all(fd, header, sizeof(header))) {
+            break;
+        }
+        const uint8_t* p = header;
+        uint32_t type = cl_get_u32(&p);
+        uint32_t len = cl_get_u32(&p);
+        uint8_t payload[CL_FRAME];
+        if (len > sizeof(payload) || !cl_read_all(fd, payload, len)) {
+            ok = false;
+            break;
+        }
+        p = payload;
+        switch (type) {
+            case MSG_FRAME:
+                ok = len == CL_FRAME && cl_frame_decode(payload, &frame);
+                has_frame = ok;
+                break;
+            case MSG_TILE: {
+                int k = (len == 4) ? (int)cl_get_u32(&p) : -1;
+                ok = has_frame && k >= 0 && k < frame.tiles_x * frame.tiles_y
+                    && pendingc < pendingcap;
+                if (ok) {
+                    pending[pendingc++] = k;
+                }
+                break;
+            }
+            case MSG_BYE:
+                done = true;
+                break;
+            default:
+                ok = false;
+        }
+    }
+    /* The coordinator may close the connection before its bye is read. */
+    ok = ok && has_frame;
+    if (ok) {
+        fprintf(stdout, "> worker: %lld tiles rendered\n", rendered);
+    } else {
+        fprintf(stderr, "Can't work for coordinator `%s`: protocol error.\n", addr);
+    }
+    close(fd);
+    for (int i = 0; i < threads; i++) {
+        free(batch.iters[i]);
+        free(batch.data[i]);
+    }
+    free(batch.iters);
+    free(batch.data);
+    free(batch.len);
+    free(batch.ns);
+    free(message);
+    free(pending);
+    return ok;
+}
@@ -0,0 +1,24 @@
+#ifndef _H_CLUSTER_
+#define _H_CLUSTER_
+
+#include <stdbool.h>
+
+#include "types.h"
+
+/** CLUSTER_TILE_SIZE is the width and height in pixels of a distributed tile. */
+#define CLUSTER_TILE_SIZE 128
+
+/** cluster_coordinate renders the width x height view of fi to the PNG file
+ ** output with worker processes connected to addr ("unix:PATH" or
+ ** "[HOST:]PORT", HOST defaults to localhost); spawn local workers are forked
+ ** first. Tiles of dead workers are rendered again and idle workers duplicate
+ ** the oldest pending tiles once the queue is empty. Prints per-worker stats
+ ** and the scaling efficiency. Returns false on error. */
+bool cluster_coordinate(struct fractal_info fi, int width, int height,
+        const char* addr, int spawn, const char* output);
+/** cluster_work connects to the coordinator at addr and renders the tiles it
+ ** is given with the software renderer pool (see rdr_sw_pool_init) until the
+ ** frame is done. Returns false on error. */
+bool cluster_work(const char* addr);
+
+#endif
@@ -0,0 +1,84 @@
+#include "compute.h"
+
+#include <math.h>
+
+#include "generator/julia.h"
+#include "generator/julia_multiset.h"
+#include "generator/julia_simd.h"
+#include "generator/mandelbrot.h"
+
+fractal_generator compute_generator(enum generator gen) {
+    switch (gen) {
+    case GEN_JULIA:
+        return julia;
+        break;
+    case GEN_JULIA_MULTISET:
+        return julia_multiset;
+        break;
+    default:
+    case GEN_MANDELBROT:
+        return mandelbrot;
+        break;
+    }
+    return NULL;
+}
+
+bool compute_float_safe(struct fractal_info fi, int width, int height) {
+#ifdef RDR_SW_NO_FLOAT
+    (void)fi; (void)width; (void)height;
+    return false;
+#else
+    double ex = fabs(fi.cx) + fi.dpp * width;
+    double ey = fabs(fi.cy) + fi.dpp * height;
+    double extent = fmax(fmax(ex, ey), 2.0); // escape radius.
+    return fi.dpp >= extent * 0x1p-24 * 0x1p8;
+#endif
+}
+
+void compute_points(int32_t* iters, struct fractal_info fi, double ox, int x0, double iy,
+        int count, bool f32) {
+    if (fi.generator == GEN_MANDELBROT || fi.generator == GEN_JULIA) {
+        bool mandelbrot = fi.generator == GEN_MANDELBROT;
+        if (f32) {
+            julia_row_f32(ox, fi.dpp, x0, iy, fi.jx, fi.jy,
+                    mandelbrot, fi.max_iter, iters, count);
+        } else {
+            julia_row_f64(ox, fi.dpp, x0, iy, fi.jx, fi.jy,
+                    mandelbrot, fi.max_iter, iters, count);
+        }
+        return;
+    }
+    fractal_generator gen = compute_generator(fi.generator);
+    for (int x = x0; x < x0 + count; x++) {
+        // Calculate a pixel.
+        *(iters++) = gen(
+                    ox + fi.dpp * x, // ix.
+                    iy,
+                    fi.jx,
+                    fi.jy,
+                    fi.n,
+                    fi.max_iter);
+    }
+}
+
+void compute_row(int32_t* iters, struct fractal_info fi, int width, int height,
+        int x0, int y, int count, bool f32) {
+    double iy = fi.cy + fi.dpp * (y - height/2);
+    compute_points(iters, fi, fi.cx, x0 - width/2, iy, count, f32);
+}
+
+void compute_iters(int32_t* iters, struct fractal_info fi, int width, int height,
+        int x0, int y0, int w, int h) {
+    bool f32 = compute_float_safe(fi, width, height);
+    for (int y = y0; y < y0 + h; y++) {
+        compute_row(iters + (y - y0) * w, fi, width, height, x0, y, w, f32);
+    }
+}
+
+void compute_hist_colors(uint32_t* lut, int i0, int i1, uint64_t cum, uint64_t total,
+        const uint32_t palette[256]) {
+    for (int i = i0; i < i1 && total > 0; i++) {
+        cum += lut[i];
+        lut[i] = palette[cum * 0xff / total];
+    }
+}
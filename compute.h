@@ -0,0 +1,48 @@
+#ifndef _H_COMPUTE_
+#define _H_COMPUTE_
+
+#include <stdbool.h>
+#include <stdint.h>
+
+#include "types.h"
+
+/* Stateless iteration counts & gray levels, shared by the software renderer
+ * and libfractal. */
+
+/** compute_generator returns the generator function of gen. */
+fractal_generator compute_generator(enum generator gen);
+/** compute_float_safe tells if float has enough precision for the width x
+ ** height view of fi: a pixel must span at least 2^8 float ulps of the
+ ** largest coordinate of the view. Build with RDR_SW_NO_FLOAT to disable. */
+bool compute_float_safe(struct fractal_info fi, int width, int height);
+/** compute_points computes the iterations of count points of fi, point i
+ ** being (ox + fi.dpp * (x0 + i), iy) (pixel lattices); quadratic generators
+ ** are vectorized, in float if f32 (see compute_float_safe). */
+void compute_points(int32_t* iters, struct fractal_info fi, double ox, int x0, double iy,
+        int count, bool f32);
+/** compute_row computes the iterations of count pixels from (x0, y) of the
+ ** width x height view of fi; quadratic generators are vectorized, in float
+ ** if f32 (see compute_float_safe). */
+void compute_row(int32_t* iters, struct fractal_info fi, int width, int height,
+        int x0, int y, int count, bool f32);
+/** compute_iters computes on the calling thread the iterations of the w x h
+ ** area at (x0, y0) of the width x height view of fi, row by row. */
+void compute_iters(int32_t* iters, struct fractal_info fi, int width, int height,
+        int x0, int y0, int w, int h);
+
+/** compute_gray returns the gray level of iter; max_iter is black. */
+static inline uint8_t compute_gray(int iter, int max_iter) {
+    if (iter == max_iter) {
+        iter = 0;
+    }
+    return (uint8_t)((double)iter / max_iter * 0xff);
+}
+
+/** compute_hist_colors turns the histogram counts [i0, i1) of lut to the
+ ** colors of palette (by gray level): the level of a count is the share of
+ ** the total escaping pixels with at most this count; cum is the number of
+ ** those with a count below i0. */
+void compute_hist_colors(uint32_t* lut, int i0, int i1, uint64_t cum, uint64_t total,
+        const uint32_t palette[256]);
+
+#endif
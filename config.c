@@ -3,6 +3,8 @@
 #include <stdio.h>
 #include <stdlib.h>
 #include <stdint.h>
+#include <string.h>
+#include <sys/stat.h>
 
 #include "vendor/tomlc99/toml.h"
 
@@ -18,9 +20,12 @@ static void read_bool(toml_table_t* conf, const char* key, bool* dest, bool fall
 }
 static void read_int(toml_table_t* conf, const char* key, int* dest, int fallback) {
     const char* val = NULL;
+    int64_t ival = 0;
     if (!((val = toml_raw_in(conf, key))
-            && toml_rtoi(val, (int64_t*)dest) == 0)) {
+            && toml_rtoi(val, &ival) == 0)) {
         *dest = fallback;
+    } else {
+        *dest = (int)ival;
     }
 }
 static void read_double(toml_table_t* conf, const char* key, double* dest, double fallback) {
@@ -30,6 +35,14 @@ static void read_double(toml_table_t* conf, const char* key, double* dest, doubl
         *dest = fallback;
     }
 }
+/** read_string sets *dest to a copy of the string at key or fallback. */
+static void read_string(toml_table_t* conf, const char* key, char** dest, const char* fallback) {
+    const char* val = NULL;
+    if (!((val = toml_raw_in(conf, key))
+            && toml_rtos(val, dest) == 0)) {
+        *dest = (fallback) ? strdup(fallback) : NULL;
+    }
+}
 
 static struct fractal_info* config_read_preset(toml_table_t* preset) {
     struct fractal_info* fi = calloc(1, sizeof(struct fractal_info));
@@ -43,6 +56,10 @@ static struct fractal_info* config_read_preset(toml_table_t* preset) {
             fi->generator = GEN_JULIA;
         else if (strcmp(gen, "julia_multiset") == 0)
             fi->generator = GEN_JULIA_MULTISET;
+        else if (strcmp(gen, "buddhabrot") == 0)
+            fi->generator = GEN_BUDDHABROT;
+        else if (strcmp(gen, "nebulabrot") == 0)
+            fi->generator = GEN_NEBULABROT;
         else
             fi->generator = GEN_MANDELBROT;
         free(gen);
@@ -86,6 +103,11 @@ static void config_read_base(toml_table_t* conf, struct config* cfg) {
     read_int(conf,    "software",   &(cfg->software),     0);
     read_int(conf,    "iter_step",  &(cfg->iter_step),    0.0);
     read_double(conf, "speed_step", &(cfg->speed_step),   0.0);
+    read_string(conf, "cache_file", &(cfg->cache_file),   NULL);
+    read_int(conf,    "cache_size", &(cfg->cache_size),   0);
+    read_int(conf,    "histogram",  &(cfg->histogram),    0);
+    read_int(conf,    "auto_iter",  &(cfg->auto_iter),    0);
+    read_int(conf,    "fps_target", &(cfg->fps_target),   0);
     read_int(conf,    "preset",     (int*)&(cfg->preset), 0);
 };
 
@@ -95,6 +117,7 @@ void config_init(struct config* cfg) {
     }
     cfg->presetc = 0;
     cfg->presets = NULL;
+    cfg->cache_file = NULL;
 }
 
 void config_read(const char* filename, struct config* cfg) {
@@ -151,6 +174,9 @@ void config_clear(struct config* cfg) {
     if (cfg->presets) {
         free(cfg->presets);
     }
+    if (cfg->cache_file) {
+        free(cfg->cache_file);
+    }
 }
 
 #define FB_IF_NOT_SET_IN_dest(property, nil) if (dest->property == nil) { dest->property = src.property; }
@@ -168,7 +194,14 @@ void config_fallback(struct config* dest, struct config src) {
     FB_IF_NOT_SET_IN_dest(iter_step,  0);
     FB_IF_NOT_SET_IN_dest(speed,      0.0);
     FB_IF_NOT_SET_IN_dest(speed_step, 0.0);
+    FB_IF_NOT_SET_IN_dest(cache_size, 0);
+    FB_IF_NOT_SET_IN_dest(histogram,  0);
+    FB_IF_NOT_SET_IN_dest(auto_iter,  0);
+    FB_IF_NOT_SET_IN_dest(fps_target, 0);
 
+    if (!dest->cache_file && src.cache_file) {
+        dest->cache_file = strdup(src.cache_file);
+    }
     if (dest->presetc == 0) {
         /* Copy presets. */
         dest->presets = calloc(src.presetc, sizeof(struct fractal_info*));
@@ -199,8 +232,17 @@ void config_override(struct config* dest, struct config src) {
     OR_IF_SET_IN_src(iter_step,  0);
     OR_IF_SET_IN_src(speed,      0.0);
     OR_IF_SET_IN_src(speed_step, 0.0);
+    OR_IF_SET_IN_src(cache_size, 0);
+    OR_IF_SET_IN_src(histogram,  0);
+    OR_IF_SET_IN_src(auto_iter,  0);
+    OR_IF_SET_IN_src(fps_target, 0);
     OR_IF_SET_IN_src(preset,     0);
 
+    if (src.cache_file) {
+        free(dest->cache_file);
+        dest->cache_file = strdup(src.cache_file);
+    }
+
     /* Propagate max_iter & speed to presets. */
     if (src.max_iter != 0) {
         for(size_t i = 0; i < dest->presetc; i++) {
@@ -216,3 +258,33 @@ void config_override(struct config* dest, struct config src) {
         dest->preset = 0;
     }
 }
+
+char* config_cache_path(const char* name) {
+    const char* xdg = getenv("XDG_CACHE_HOME");
+    const char* home = getenv("HOME");
+    char dir[4096];
+    int len = -1;
+    if (xdg && *xdg) {
+        len = snprintf(dir, sizeof(dir), "%s", xdg);
+    } else if (home && *home) {
+        len = snprintf(dir, sizeof(dir), "%s/.cache", home);
+    }
+    if (len > 0 && (size_t)len < sizeof(dir)) {
+        mkdir(dir, 0755);
+        len += snprintf(dir + len, sizeof(dir) - len, "/fractal");
+    }
+    struct stat st;
+    bool ok = len > 0 && (size_t)len < sizeof(dir)
+        && (mkdir(dir, 0755) == 0 || (stat(dir, &st) == 0 && S_ISDIR(st.st_mode)));
+    size_t size = ((ok) ? (size_t)len + 1 : 0) + strlen(name) + 1;
+    char* path = malloc(size);
+    if (!path) {
+        panic("Error: can't allocate a path.");
+    }
+    if (ok) {
+        snprintf(path, size, "%s/%s", dir, name);
+    } else {
+        strcpy(path, name);
+    }
+    return path;
+}
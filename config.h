@@ -24,6 +24,17 @@ struct config {
     double speed;
     /** speed_step multiplier to increase/descrease speed. */
     double speed_step;
+    /** cache_file is the tile cache file of the software renderer (NULL: no cache). */
+    char* cache_file;
+    /** cache_size is the tile cache size limit in MiB. */
+    int cache_size;
+    /** histogram is set to 1 if the software renderer colours by histogram. */
+    int histogram;
+    /** auto_iter is set to 1 if max_iter is estimated per view (see autoiter.h). */
+    int auto_iter;
+    /** fps_target is the frame rate the software renderer holds for dynamic
+     ** fractals by scaling their resolution (0: no scaling). */
+    int fps_target;
     /** preset is the index of the selected preset. */
     size_t preset;
     /** presets is a list of preset. */
@@ -44,5 +55,9 @@ void config_clear(struct config* cfg);
 void config_fallback(struct config* dest, struct config src);
 /** config_override set non null but distinct memeber of dest to src. */
 void config_override(struct config* dest, struct config src);
+/** config_cache_path returns the path of the file name in the cache directory,
+ ** $XDG_CACHE_HOME/fractal or ~/.cache/fractal, created if missing; name in
+ ** the working directory if it can't be (to free). */
+char* config_cache_path(const char* name);
 
 #endif
@@ -0,0 +1,110 @@
+#include "julia_simd.h"
+
+#include <string.h>
+
+/* GCC vector extensions of 16 bytes, the SIMD width of any x86-64 (SSE2) or
+ ** ARMv8 (NEON) target; wider targets gain from compiling with -march. */
+typedef double  v2df __attribute__((vector_size(16)));
+typedef int64_t v2di __attribute__((vector_size(16)));
+typedef float   v4sf __attribute__((vector_size(16)));
+typedef int32_t v4si __attribute__((vector_size(16)));
+
+/* Independent vectors iterated together to hide the latency of each step. */
+#define JULIA_SIMD_CHAINS 2
+/* Lanes are checked for escape every JULIA_SIMD_CHECK iterations. */
+#define JULIA_SIMD_CHECK 8
+
+/** any_active tells if a lane of the JULIA_SIMD_CHAINS masks is set. */
+static inline bool any_active(const void* masks) {
+    uint64_t m[2 * JULIA_SIMD_CHAINS];
+    memcpy(m, masks, sizeof(m));
+    uint64_t any = 0;
+    for (int c = 0; c < 2 * JULIA_SIMD_CHAINS; c++) {
+        any |= m[c];
+    }
+    return any != 0;
+}
+
+/** JULIA_ROW defines julia_row_<suffix>: lanes iterate z = z^2 + c exactly
+ ** like julia, count the iterations they survive and freeze once escaped. */
+#define JULIA_ROW(suffix, vf, vi, f, lanes) \
+void julia_row_##suffix(double cx, double dpp, int x0, double iy, double jx, double jy, \
+        bool mandelbrot, int max_iter, int32_t* iters, int count) { \
+    const int step = lanes * JULIA_SIMD_CHAINS; \
+    for (int i = 0; i < count; i += step) { \
+        vf zr[JULIA_SIMD_CHAINS], zi[JULIA_SIMD_CHAINS]; \
+        vf cr[JULIA_SIMD_CHAINS], ci[JULIA_SIMD_CHAINS]; \
+        vi active[JULIA_SIMD_CHAINS], n[JULIA_SIMD_CHAINS]; \
+        for (int c = 0; c < JULIA_SIMD_CHAINS; c++) { \
+            vf px, py; \
+            for (int l = 0; l < lanes; l++) { \
+                px[l] = (f)(cx + dpp * (x0 + i + c * lanes + l)); \
+                py[l] = (f)iy; \
+            } \
+            vf zero = {0}; \
+            zr[c] = (mandelbrot) ? zero : px; \
+            zi[c] = (mandelbrot) ? zero : py; \
+            cr[c] = (mandelbrot) ? px : zero + (f)jx; \
+            ci[c] = (mandelbrot) ? py : zero + (f)jy; \
+            active[c] = (vi){0} - 1; \
+            n[c] = (vi){0}; \
+        } \
+        for (int it = 0; it < max_iter; it++) { \
+            for (int c = 0; c < JULIA_SIMD_CHAINS; c++) { \
+                vf t = zr[c]; \
+                zr[c] = (zr[c] * zr[c]) - (zi[c] * zi[c]) + cr[c]; \
+                zi[c] = (2 * t * zi[c]) + ci[c]; \
+                active[c] &= (vi)(zr[c] * zr[c] + zi[c] * zi[c] <= 4); \
+                n[c] -= active[c]; \
+            } \
+            if (it % JULIA_SIMD_CHECK == JULIA_SIMD_CHECK - 1 && !any_active(active)) { \
+                break; \
+            } \
+        } \
+        for (int k = 0; k < step && i + k < count; k++) { \
+            iters[i + k] = (int32_t)n[k / lanes][k % lanes]; \
+        } \
+    } \
+}
+
+JULIA_ROW(f64, v2df, v2di, double, 2)
+JULIA_ROW(f32, v4sf, v4si, float, 4)
+
+/** JULIA_LANES defines julia_lanes_<suffix> like JULIA_ROW, lanes differing by
+ ** their constant rather than their point; unused lanes get an escaping one. */
+#define JULIA_LANES(suffix, vf, vi, f, lanes) \
+void julia_lanes_##suffix(double zx, double zy, const double* jx, const double* jy, \
+        int max_iter, int32_t* iters, int count) { \
+    vf zr[JULIA_SIMD_CHAINS], zi[JULIA_SIMD_CHAINS]; \
+    vf cr[JULIA_SIMD_CHAINS], ci[JULIA_SIMD_CHAINS]; \
+    vi active[JULIA_SIMD_CHAINS], n[JULIA_SIMD_CHAINS]; \
+    for (int c = 0; c < JULIA_SIMD_CHAINS; c++) { \
+        for (int l = 0; l < lanes; l++) { \
+            int k = c * lanes + l; \
+            cr[c][l] = (k < count) ? (f)jx[k] : (f)4; \
+            ci[c][l] = (k < count) ? (f)jy[k] : (f)0; \
+        } \
+        vf zero = {0}; \
+        zr[c] = zero + (f)zx; \
+        zi[c] = zero + (f)zy; \
+        active[c] = (vi){0} - 1; \
+        n[c] = (vi){0}; \
+    } \
+    for (int it = 0; it < max_iter; it++) { \
+        for (int c = 0; c < JULIA_SIMD_CHAINS; c++) { \
+            vf t = zr[c]; \
+            zr[c] = (zr[c] * zr[c]) - (zi[c] * zi[c]) + cr[c]; \
+            zi[c] = (2 * t * zi[c]) + ci[c]; \
+            active[c] &= (vi)(zr[c] * zr[c] + zi[c] * zi[c] <= 4); \
+            n[c] -= active[c]; \
+        } \
+        if (it % JULIA_SIMD_CHECK == JULIA_SIMD_CHECK - 1 && !any_active(active)) { \
+            break; \
+        } \
+    } \
+    for (int k = 0; k < count && k < lanes * JULIA_SIMD_CHAINS; k++) { \
+        iters[k] = (int32_t)n[k / lanes][k % lanes]; \
+    } \
+}
+
+JULIA_LANES(f32, v4sf, v4si, float, 4)
@@ -0,0 +1,25 @@
+#ifndef H_JULIA_SIMD
+#define H_JULIA_SIMD
+
+#include <stdbool.h>
+#include <stdint.h>
+
+/** julia_row_f64 computes the iterations of count points, point i being
+ ** (cx + dpp * (x0 + i), iy), like julia (or mandelbrot if mandelbrot) with
+ ** the julia constant (jx, jy); same results, computed with double SIMD lanes. */
+void julia_row_f64(double cx, double dpp, int x0, double iy, double jx, double jy,
+        bool mandelbrot, int max_iter, int32_t* iters, int count);
+/** julia_row_f32 is julia_row_f64 computed with float SIMD lanes, twice as many;
+ ** points are rounded to float, which is only fine for shallow zooms. */
+void julia_row_f32(double cx, double dpp, int x0, double iy, double jx, double jy,
+        bool mandelbrot, int max_iter, int32_t* iters, int count);
+/** JULIA_LANES_MAX is the count of constants julia_lanes_f32 computes at
+ ** once: SIMD lanes of its chains. */
+#define JULIA_LANES_MAX 8
+/** julia_lanes_f32 computes the iterations of point (zx, zy) of the julia
+ ** sets of count constants (jx[i], jy[i]), like julia, a constant per float
+ ** SIMD lane (at most JULIA_LANES_MAX; atlases of julia sets). */
+void julia_lanes_f32(double zx, double zy, const double* jx, const double* jy,
+        int max_iter, int32_t* iters, int count);
+
+#endif
@@ -0,0 +1,160 @@
+#include "heatmap.h"
+
+#include <math.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <SDL2/SDL.h>
+
+#include "panic.h"
+#include "png.h"
+#include "renderer_software.h"
+#include "tile_cache.h"
+
+/** hm_color returns the heatmap color of v in [0, 1]: black, blue, red,
+ ** yellow then white. */
+static uint32_t hm_color(SDL_PixelFormat* format, double v) {
+    static const uint8_t stops[][3] = {
+        {0x00, 0x00, 0x00},
+        {0x20, 0x30, 0xc0},
+        {0xd0, 0x20, 0x30},
+        {0xff, 0xd0, 0x20},
+        {0xff, 0xff, 0xff},
+    };
+    const int last = sizeof(stops) / sizeof(stops[0]) - 1;
+    v = (v < 0.0) ? 0.0 : (v > 1.0) ? 1.0 : v;
+    int k = (int)(v * last);
+    if (k == last) {
+        k--;
+    }
+    double f = v * last - k;
+    uint8_t c[3];
+    for (int i = 0; i < 3; i++) {
+        c[i] = (uint8_t)lround(stops[k][i] + f * (stops[k + 1][i] - stops[k][i]));
+    }
+    return SDL_MapRGB(format, c[0], c[1], c[2]);
+}
+
+/** hm_csv_path returns output with its .png extension replaced by .csv. */
+static char* hm_csv_path(const char* output) {
+    size_t len = strlen(output);
+    if (len > 4 && strcmp(output + len - 4, ".png") == 0) {
+        len -= 4;
+    }
+    char* path = malloc(len + sizeof(".csv"));
+    memcpy(path, output, len);
+    strcpy(path + len, ".csv");
+    return path;
+}
+
+/** hm_write_csv writes the tiles of prof to path. */
+static bool hm_write_csv(struct rdr_sw_profile* prof, const char* path) {
+    FILE* fp = fopen(path, "w");
+    if (!fp) {
+        fprintf(stderr, "Can't write tiles to `%s`.\n", path);
+        return false;
+    }
+    fprintf(fp, "x,y,w,h,worker,ms,pixels,iterations,iterations_per_pixel\n");
+    for (int k = 0; k < prof->tilec; k++) {
+        struct rdr_sw_tile_stat* t = &prof->tiles[k];
+        fprintf(fp, "%d,%d,%d,%d,%d,%.3f,%d,%lld,%.1f\n", t->x, t->y, t->w, t->h,
+                t->worker, t->ms, t->pixels, t->iters,
+                (t->pixels) ? (double)t->iters / t->pixels : 0.0);
+    }
+    fclose(fp);
+    return true;
+}
+
+/** hm_print_stats prints the cost of the frame & of each worker. */
+static void hm_print_stats(struct rdr_sw_profile* prof, double ms) {
+    int workerc = 0;
+    long long iters = 0;
+    int slowest = 0;
+    for (int k = 0; k < prof->tilec; k++) {
+        struct rdr_sw_tile_stat* t = &prof->tiles[k];
+        workerc = (t->worker + 1 > workerc) ? t->worker + 1 : workerc;
+        iters += t->iters;
+        if (t->ms > prof->tiles[slowest].ms) {
+            slowest = k;
+        }
+    }
+    fprintf(stdout, "> heatmap: %d tiles, %lld iterations in %.2f ms (%.3f Giterations/s)\n",
+            prof->tilec, iters, ms, (ms > 0) ? iters / ms * 1e-6 : 0.0);
+    if (prof->tilec > 0) {
+        struct rdr_sw_tile_stat* t = &prof->tiles[slowest];
+        fprintf(stdout, "> slowest tile: %dx%d at (%d, %d), worker %d, %.2f ms, %lld iterations\n",
+                t->w, t->h, t->x, t->y, t->worker, t->ms, t->iters);
+    }
+    double busy_max = 0.0, busy_sum = 0.0;
+    for (int w = 0; w < workerc; w++) {
+        double busy = 0.0;
+        long long witers = 0;
+        int tiles = 0;
+        for (int k = 0; k < prof->tilec; k++) {
+            if (prof->tiles[k].worker == w) {
+                busy += prof->tiles[k].ms;
+                witers += prof->tiles[k].iters;
+                tiles++;
+            }
+        }
+        fprintf(stdout, "> worker %d: %d tiles, %.2f ms, %lld iterations\n", w, tiles, busy, witers);
+        busy_max = (busy > busy_max) ? busy : busy_max;
+        busy_sum += busy;
+    }
+    if (workerc > 0 && busy_sum > 0) {
+        fprintf(stdout, "> imbalance (max / mean worker time): %.2f\n",
+                busy_max / (busy_sum / workerc));
+    }
+}
+
+bool heatmap_render(struct fractal_info fi, int width, int height, const char* output) {
+    SDL_Surface* buf = SDL_CreateRGBSurface(0, width, height, 32, 0, 0, 0, 0);
+    if (!buf) {
+        panic("Error: SDL can't create a surface.");
+    }
+    /* Area worker tiles or cache lattice tiles, whichever is larger. */
+    int workerc = rdr_sw_pool_size();
+    int tilecap = workerc * workerc
+        + (width / TC_TILE_SIZE + 2) * (height / TC_TILE_SIZE + 2);
+    struct rdr_sw_profile prof = {
+        .cost = malloc((size_t)width * height * sizeof(uint32_t)),
+        .tiles = malloc(tilecap * sizeof(struct rdr_sw_tile_stat)),
+        .tilecap = tilecap,
+    };
+    if (!prof.cost || !prof.tiles) {
+        panic("Error: can't allocate the heatmap buffers.");
+    }
+    struct timespec start, end;
+    clock_gettime(CLOCK_MONOTONIC, &start);
+    rdr_sw_profile_buffer(buf, fi, &prof);
+    clock_gettime(CLOCK_MONOTONIC, &end);
+    double ms = (end.tv_sec - start.tv_sec) * 1e3 + (end.tv_nsec - start.tv_nsec) * 1e-6;
+    hm_print_stats(&prof, ms);
+    /* Heatmap. */
+    uint32_t max = 0;
+    for (size_t p = 0; p < (size_t)width * height; p++) {
+        max = (prof.cost[p] > max) ? prof.cost[p] : max;
+    }
+    double scale = (max > 0) ? 1.0 / log1p(max) : 0.0;
+    for (int y = 0; y < height; y++) {
+        uint32_t* pixels = (uint32_t*)((uint8_t*)buf->pixels + y * buf->pitch);
+        for (int x = 0; x < width; x++) {
+            pixels[x] = hm_color(buf->format, log1p(prof.cost[x + (size_t)y * width]) * scale);
+        }
+    }
+    bool ok = png_write_surface_mt(buf, output);
+    if (!ok) {
+        fprintf(stderr, "Can't write heatmap `%s`.\n", output);
+    }
+    char* csv = hm_csv_path(output);
+    ok = hm_write_csv(&prof, csv) && ok;
+    if (ok) {
+        fprintf(stdout, "> heatmap `%s` (max %u iterations per pixel), tiles `%s`\n", output, max, csv);
+    }
+    free(csv);
+    free(prof.cost);
+    free(prof.tiles);
+    SDL_FreeSurface(buf);
+    return ok;
+}
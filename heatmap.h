@@ -0,0 +1,16 @@
+#ifndef _H_HEATMAP_
+#define _H_HEATMAP_
+
+#include <stdbool.h>
+
+#include "types.h"
+
+/** heatmap_render renders the width x height view of fi with the software
+ ** renderer pool (see rdr_sw_pool_init), recording the iterations computed
+ ** per pixel & the wall time of each tile of the workers. The cost of the
+ ** pixels is written as a heatmap to the PNG file output (log scale, black
+ ** for pixels not computed), the tiles to output with a .csv extension.
+ ** Prints a summary of the cost per worker. Returns false on error. */
+bool heatmap_render(struct fractal_info fi, int width, int height, const char* output);
+
+#endif
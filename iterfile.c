@@ -0,0 +1,515 @@
+#include "iterfile.h"
+
+#include <endian.h>
+#include <fcntl.h>
+#include <stdatomic.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <time.h>
+#include <unistd.h>
+#include <zlib.h>
+#include <SDL2/SDL.h>
+
+#include "compute.h"
+#include "panic.h"
+#include "png.h"
+#include "renderer_software.h"
+
+/** Layout, big endian: the header (ITF_HEADER bytes), the index of the tiles
+ ** row by row (ITF_ENTRY bytes each: u64 offset, u32 length, u32 length
+ ** before deflate), then the tiles. Header: magic, u32 version, channels,
+ ** width, height, tile size, tile count, then the fractal_info: u32
+ ** generator, dynamic, f64 speed, u32 max_iter, f64 cx, cy, dpp, jx, jy,
+ ** u32 n, f64 t. */
+#define ITF_MAGIC "FRACITER"
+#define ITF_HEADER 104
+#define ITF_ENTRY 16
+/** ITF_VARINT_MAX is the max size of a LEB128 encoded 32 bits value. */
+#define ITF_VARINT_MAX 5
+
+static uint8_t* itf_put_u32(uint8_t* p, uint32_t v) {
+    v = htobe32(v);
+    memcpy(p, &v, 4);
+    return p + 4;
+}
+
+static uint8_t* itf_put_u64(uint8_t* p, uint64_t v) {
+    v = htobe64(v);
+    memcpy(p, &v, 8);
+    return p + 8;
+}
+
+static uint8_t* itf_put_f64(uint8_t* p, double d) {
+    uint64_t v;
+    memcpy(&v, &d, 8);
+    return itf_put_u64(p, v);
+}
+
+static uint32_t itf_get_u32(const uint8_t** p) {
+    uint32_t v;
+    memcpy(&v, *p, 4);
+    *p += 4;
+    return be32toh(v);
+}
+
+static uint64_t itf_get_u64(const uint8_t** p) {
+    uint64_t v;
+    memcpy(&v, *p, 8);
+    *p += 8;
+    return be64toh(v);
+}
+
+static double itf_get_f64(const uint8_t** p) {
+    uint64_t v = itf_get_u64(p);
+    double d;
+    memcpy(&d, &v, 8);
+    return d;
+}
+
+static double itf_now_ms(void) {
+    struct timespec tp;
+    clock_gettime(CLOCK_MONOTONIC, &tp);
+    return tp.tv_sec * 1e3 + tp.tv_nsec * 1e-6;
+}
+
+/** itf_tile_rect sets the area of tile (tx, ty) of a width x height image. */
+static void itf_tile_rect(int width, int height, int tx, int ty, int* x0, int* y0, int* w, int* h) {
+    *x0 = tx * ITERFILE_TILE_SIZE;
+    *y0 = ty * ITERFILE_TILE_SIZE;
+    *w = (width - *x0 < ITERFILE_TILE_SIZE) ? width - *x0 : ITERFILE_TILE_SIZE;
+    *h = (height - *y0 < ITERFILE_TILE_SIZE) ? height - *y0 : ITERFILE_TILE_SIZE;
+}
+
+/** itf_encode delta encodes the w x h iterations of a tile to out as zigzag
+ ** LEB128 varints: each relative to its left neighbour, the first of a row
+ ** to the one above. Returns the bytes written, at most ITF_VARINT_MAX per
+ ** value. */
+static size_t itf_encode(const int32_t* iters, int w, int h, uint8_t* out) {
+    uint8_t* p = out;
+    for (int y = 0; y < h; y++) {
+        for (int x = 0; x < w; x++) {
+            int32_t ref = (x > 0) ? iters[y * w + x - 1] : (y > 0) ? iters[(y - 1) * w] : 0;
+            uint32_t d = (uint32_t)iters[y * w + x] - (uint32_t)ref;
+            uint32_t z = (d << 1) ^ (uint32_t)((int32_t)d >> 31);
+            while (z >= 0x80) {
+                *(p++) = (uint8_t)(z | 0x80);
+                z >>= 7;
+            }
+            *(p++) = (uint8_t)z;
+        }
+    }
+    return p - out;
+}
+
+/** itf_decode reverses itf_encode: decodes the len bytes of in to the w x h
+ ** iterations of a tile. Returns false if in is not w x h varints. */
+static bool itf_decode(const uint8_t* in, size_t len, int32_t* iters, int w, int h) {
+    const uint8_t* p = in;
+    const uint8_t* end = in + len;
+    for (int y = 0; y < h; y++) {
+        for (int x = 0; x < w; x++) {
+            uint32_t z = 0;
+            for (int shift = 0; ; shift += 7) {
+                if (p == end || shift > 28) {
+                    return false;
+                }
+                z |= (uint32_t)(*p & 0x7f) << shift;
+                if (!(*(p++) & 0x80)) {
+                    break;
+                }
+            }
+            uint32_t d = (z >> 1) ^ -(z & 1);
+            int32_t ref = (x > 0) ? iters[y * w + x - 1] : (y > 0) ? iters[(y - 1) * w] : 0;
+            iters[y * w + x] = (int32_t)((uint32_t)ref + d);
+        }
+    }
+    return p == end;
+}
+
+/** itf_save_job renders, or copies from src, & encodes the tiles of a view,
+ ** one at a time per worker. */
+struct itf_save_job {
+    struct fractal_info fi;
+    int width, height;
+    const int32_t* src; // iterations of the view, row by row, or NULL.
+    int tiles_x, tilec;
+    atomic_int next;
+    atomic_bool failed;
+    uint8_t** data;     // deflated tiles.
+    uint32_t* len;
+    uint32_t* raw_len;  // of the varints.
+};
+
+static void itf_save_worker(void* arg, int workeri, int workerc) {
+    struct itf_save_job* job = (struct itf_save_job*)arg;
+    const int count = ITERFILE_TILE_SIZE * ITERFILE_TILE_SIZE;
+    int32_t* iters = malloc(count * sizeof(int32_t));
+    uint8_t* raw = malloc(count * ITF_VARINT_MAX);
+    uint8_t* out = malloc(compressBound(count * ITF_VARINT_MAX));
+    if (!iters || !raw || !out) {
+        panic("Error: can't allocate iteration file buffers.");
+    }
+    int i;
+    while ((i = atomic_fetch_add(&job->next, 1)) < job->tilec) {
+        int x0, y0, w, h;
+        itf_tile_rect(job->width, job->height, i % job->tiles_x, i / job->tiles_x, &x0, &y0, &w, &h);
+        if (job->src) {
+            for (int y = 0; y < h; y++) {
+                memcpy(iters + y * w, job->src + (size_t)(y0 + y) * job->width + x0, w * sizeof(int32_t));
+            }
+        } else {
+            compute_iters(iters, job->fi, job->width, job->height, x0, y0, w, h);
+        }
+        size_t raw_len = itf_encode(iters, w, h, raw);
+        uLongf len = compressBound(count * ITF_VARINT_MAX);
+        if (compress2(out, &len, raw, raw_len, Z_DEFAULT_COMPRESSION) != Z_OK) {
+            atomic_store(&job->failed, true);
+            break;
+        }
+        job->data[i] = malloc(len);
+        if (!job->data[i]) {
+            panic("Error: can't allocate iteration file buffers.");
+        }
+        memcpy(job->data[i], out, len);
+        job->len[i] = (uint32_t)len;
+        job->raw_len[i] = (uint32_t)raw_len;
+    }
+    free(iters);
+    free(raw);
+    free(out);
+}
+
+/** itf_put_header writes the header of a width x height file of tilec tiles
+ ** of fi at time t to p. */
+static void itf_put_header(uint8_t* p, int width, int height, int tilec,
+        struct fractal_info fi, double t) {
+    uint8_t* start = p;
+    memcpy(p, ITF_MAGIC, 8);
+    p += 8;
+    p = itf_put_u32(p, ITERFILE_VERSION);
+    p = itf_put_u32(p, ITERFILE_ITERATIONS);
+    p = itf_put_u32(p, width);
+    p = itf_put_u32(p, height);
+    p = itf_put_u32(p, ITERFILE_TILE_SIZE);
+    p = itf_put_u32(p, tilec);
+    p = itf_put_u32(p, fi.generator);
+    p = itf_put_u32(p, fi.dynamic);
+    p = itf_put_f64(p, fi.speed);
+    p = itf_put_u32(p, fi.max_iter);
+    p = itf_put_f64(p, fi.cx);
+    p = itf_put_f64(p, fi.cy);
+    p = itf_put_f64(p, fi.dpp);
+    p = itf_put_f64(p, fi.jx);
+    p = itf_put_f64(p, fi.jy);
+    p = itf_put_u32(p, fi.n);
+    p = itf_put_f64(p, t);
+    if (p - start != ITF_HEADER) {
+        panic("Error: iteration file header size mismatch.");
+    }
+}
+
+/** itf_save saves the iterations src of the view, rendered if NULL, to path. */
+static bool itf_save(struct fractal_info fi, int width, int height, double t,
+        const int32_t* src, const char* path) {
+    int tiles_x = (width + ITERFILE_TILE_SIZE - 1) / ITERFILE_TILE_SIZE;
+    int tiles_y = (height + ITERFILE_TILE_SIZE - 1) / ITERFILE_TILE_SIZE;
+    struct itf_save_job job = {
+        .fi = fi_at(fi, t),
+        .width = width,
+        .height = height,
+        .src = src,
+        .tiles_x = tiles_x,
+        .tilec = tiles_x * tiles_y,
+        .data = calloc(tiles_x * tiles_y, sizeof(uint8_t*)),
+        .len = calloc(tiles_x * tiles_y, sizeof(uint32_t)),
+        .raw_len = calloc(tiles_x * tiles_y, sizeof(uint32_t)),
+    };
+    if (!job.data || !job.len || !job.raw_len) {
+        panic("Error: can't allocate iteration file index.");
+    }
+    atomic_init(&job.next, 0);
+    atomic_init(&job.failed, false);
+    double start = itf_now_ms();
+    rdr_sw_run(itf_save_worker, &job);
+    double rendered = itf_now_ms();
+    bool ok = !atomic_load(&job.failed);
+    if (!ok) {
+        fprintf(stderr, "Can't compress iterations.\n");
+    }
+    /* Header, index, tiles. */
+    FILE* fp = (ok) ? fopen(path, "wb") : NULL;
+    if (ok && !fp) {
+        fprintf(stderr, "Can't create iteration file `%s`.\n", path);
+        ok = false;
+    }
+    uint64_t offset = ITF_HEADER + (uint64_t)ITF_ENTRY * job.tilec;
+    if (ok) {
+        uint8_t header[ITF_HEADER];
+        itf_put_header(header, width, height, job.tilec, fi, t);
+        ok = fwrite(header, 1, ITF_HEADER, fp) == ITF_HEADER;
+        for (int i = 0; ok && i < job.tilec; i++) {
+            uint8_t entry[ITF_ENTRY];
+            itf_put_u32(itf_put_u32(itf_put_u64(entry, offset), job.len[i]), job.raw_len[i]);
+            ok = fwrite(entry, 1, ITF_ENTRY, fp) == ITF_ENTRY;
+            offset += job.len[i];
+        }
+        for (int i = 0; ok && i < job.tilec; i++) {
+            ok = fwrite(job.data[i], 1, job.len[i], fp) == job.len[i];
+        }
+        if (fclose(fp) != 0 || !ok) {
+            fprintf(stderr, "Can't write iteration file `%s`.\n", path);
+            ok = false;
+        }
+    }
+    if (ok && !src) {
+        fprintf(stdout, "> %dx%d iterations rendered in %.2f ms, saved to `%s` in %.2f ms: "
+                "%d tiles, %.2f MiB (%.2f bytes per pixel)\n", width, height, rendered - start,
+                path, itf_now_ms() - rendered, job.tilec, offset / (1024.0 * 1024.0),
+                (double)offset / ((double)width * height));
+    }
+    for (int i = 0; i < job.tilec; i++) {
+        free(job.data[i]);
+    }
+    free(job.data);
+    free(job.len);
+    free(job.raw_len);
+    return ok;
+}
+
+bool iterfile_save(struct fractal_info fi, int width, int height, double t, const char* path) {
+    return itf_save(fi, width, height, t, NULL, path);
+}
+
+bool iterfile_write(struct fractal_info fi, int width, int height, double t,
+        const int32_t* iters, const char* path) {
+    return itf_save(fi, width, height, t, iters, path);
+}
+
+bool iterfile_open(const char* path, struct iterfile* itf) {
+    memset(itf, 0, sizeof(*itf));
+    int fd = open(path, O_RDONLY);
+    if (fd < 0) {
+        fprintf(stderr, "Can't open iteration file `%s`.\n", path);
+        return false;
+    }
+    struct stat st;
+    if (fstat(fd, &st) != 0 || st.st_size < ITF_HEADER) {
+        close(fd);
+        fprintf(stderr, "Can't read iteration file `%s`.\n", path);
+        return false;
+    }
+    void* map = mmap(NULL, st.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+    if (map == MAP_FAILED) {
+        close(fd);
+        fprintf(stderr, "Can't map iteration file `%s`.\n", path);
+        return false;
+    }
+    itf->fd = fd;
+    itf->map = map;
+    itf->size = st.st_size;
+    /* Header. */
+    const uint8_t* p = itf->map;
+    bool magic = memcmp(p, ITF_MAGIC, 8) == 0;
+    p += 8;
+    itf->version = itf_get_u32(&p);
+    itf->channels = itf_get_u32(&p);
+    itf->width = (int)itf_get_u32(&p);
+    itf->height = (int)itf_get_u32(&p);
+    uint32_t tile_size = itf_get_u32(&p);
+    uint32_t tilec = itf_get_u32(&p);
+    uint32_t generator = itf_get_u32(&p);
+    itf->fi.generator = (enum generator)generator;
+    itf->fi.dynamic = itf_get_u32(&p) != 0;
+    itf->fi.speed = itf_get_f64(&p);
+    itf->fi.max_iter = (int)itf_get_u32(&p);
+    itf->fi.cx = itf_get_f64(&p);
+    itf->fi.cy = itf_get_f64(&p);
+    itf->fi.dpp = itf_get_f64(&p);
+    itf->fi.jx = itf_get_f64(&p);
+    itf->fi.jy = itf_get_f64(&p);
+    itf->fi.n = (int)itf_get_u32(&p);
+    itf->t = itf_get_f64(&p);
+    itf->tiles_x = (itf->width + ITERFILE_TILE_SIZE - 1) / ITERFILE_TILE_SIZE;
+    itf->tiles_y = (itf->height + ITERFILE_TILE_SIZE - 1) / ITERFILE_TILE_SIZE;
+    if (!magic || itf->version != ITERFILE_VERSION) {
+        fprintf(stderr, "Can't read iteration file `%s`: not a version %d file.\n",
+                path, ITERFILE_VERSION);
+    } else if (!(itf->channels & ITERFILE_ITERATIONS) || itf->width <= 0 || itf->height <= 0
+            || tile_size != ITERFILE_TILE_SIZE || generator > GEN_NEBULABROT
+            || itf->fi.max_iter <= 0
+            || tilec != (uint32_t)itf->tiles_x * itf->tiles_y
+            || itf->size < ITF_HEADER + (size_t)ITF_ENTRY * tilec) {
+        fprintf(stderr, "Can't read iteration file `%s`: corrupted header.\n", path);
+    } else {
+        return true;
+    }
+    iterfile_close(itf);
+    return false;
+}
+
+void iterfile_close(struct iterfile* itf) {
+    if (!itf->map) {
+        return;
+    }
+    munmap((void*)itf->map, itf->size);
+    close(itf->fd);
+    itf->map = NULL;
+}
+
+bool iterfile_read_tile(struct iterfile* itf, int tx, int ty, int32_t* iters) {
+    const uint8_t* p = itf->map + ITF_HEADER + (size_t)ITF_ENTRY * (ty * itf->tiles_x + tx);
+    uint64_t offset = itf_get_u64(&p);
+    uint32_t len = itf_get_u32(&p);
+    uint32_t raw_len = itf_get_u32(&p);
+    int x0, y0, w, h;
+    itf_tile_rect(itf->width, itf->height, tx, ty, &x0, &y0, &w, &h);
+    if (offset > itf->size || len > itf->size - offset
+            || raw_len > (uint32_t)(w * h * ITF_VARINT_MAX)) {
+        return false;
+    }
+    uint8_t raw[ITERFILE_TILE_SIZE * ITERFILE_TILE_SIZE * ITF_VARINT_MAX];
+    uLongf size = raw_len;
+    return uncompress(raw, &size, itf->map + offset, len) == Z_OK && size == raw_len
+        && itf_decode(raw, raw_len, iters, w, h);
+}
+
+/** itf_recolor_job decodes the tiles of a file to iters, one at a time per
+ ** worker, counts them to a histogram per worker if any, then colors bands
+ ** of rows with lut. */
+struct itf_recolor_job {
+    struct iterfile* itf;
+    int32_t* iters;
+    atomic_int next;
+    atomic_bool failed;
+    uint32_t** counts; // per worker histograms, or NULL.
+    uint32_t* lut;     // color per iteration count.
+    SDL_Surface* surface;
+};
+
+static void itf_decode_worker(void* arg, int workeri, int workerc) {
+    struct itf_recolor_job* job = (struct itf_recolor_job*)arg;
+    struct iterfile* itf = job->itf;
+    int max_iter = itf->fi.max_iter;
+    uint32_t* counts = (job->counts) ? job->counts[workeri] : NULL;
+    int32_t tile[ITERFILE_TILE_SIZE * ITERFILE_TILE_SIZE];
+    int i;
+    while ((i = atomic_fetch_add(&job->next, 1)) < itf->tiles_x * itf->tiles_y) {
+        int tx = i % itf->tiles_x, ty = i / itf->tiles_x;
+        int x0, y0, w, h;
+        itf_tile_rect(itf->width, itf->height, tx, ty, &x0, &y0, &w, &h);
+        if (!iterfile_read_tile(itf, tx, ty, tile)) {
+            atomic_store(&job->failed, true);
+            break;
+        }
+        for (int y = 0; y < h; y++) {
+            int32_t* row = job->iters + (size_t)(y0 + y) * itf->width + x0;
+            for (int x = 0; x < w; x++) {
+                int32_t v = tile[y * w + x];
+                v = (v < 0) ? 0 : (v > max_iter) ? max_iter : v;
+                row[x] = v;
+                if (counts) {
+                    counts[v]++;
+                }
+            }
+        }
+    }
+}
+
+static void itf_color_worker(void* arg, int workeri, int workerc) {
+    struct itf_recolor_job* job = (struct itf_recolor_job*)arg;
+    int width = job->itf->width, height = job->itf->height;
+    for (int y = workeri * height / workerc; y < (workeri + 1) * height / workerc; y++) {
+        uint32_t* pixels = (uint32_t*)((uint8_t*)job->surface->pixels + y * job->surface->pitch);
+        const int32_t* iters = job->iters + (size_t)y * width;
+        for (int x = 0; x < width; x++) {
+            pixels[x] = job->lut[iters[x]];
+        }
+    }
+}
+
+bool iterfile_recolor(const char* path, const char* output, bool histogram) {
+    struct iterfile itf;
+    if (!iterfile_open(path, &itf)) {
+        return false;
+    }
+    int max_iter = itf.fi.max_iter;
+    int workerc = rdr_sw_pool_size();
+    SDL_Surface* surface = SDL_CreateRGBSurface(0, itf.width, itf.height, 32, 0, 0, 0, 0);
+    if (!surface) {
+        panic("Error: SDL can't create a surface.");
+    }
+    struct itf_recolor_job job = {
+        .itf = &itf,
+        .iters = malloc((size_t)itf.width * itf.height * sizeof(int32_t)),
+        .lut = malloc((max_iter + 1) * sizeof(uint32_t)),
+        .surface = surface,
+    };
+    if (!job.iters || !job.lut) {
+        panic("Error: can't allocate recolor buffers.");
+    }
+    if (histogram) {
+        job.counts = calloc(workerc, sizeof(uint32_t*));
+        for (int w = 0; job.counts && w < workerc; w++) {
+            job.counts[w] = calloc(max_iter + 1, sizeof(uint32_t));
+            if (!job.counts[w]) {
+                panic("Error: can't allocate recolor buffers.");
+            }
+        }
+        if (!job.counts) {
+            panic("Error: can't allocate recolor buffers.");
+        }
+    }
+    atomic_init(&job.next, 0);
+    atomic_init(&job.failed, false);
+    double start = itf_now_ms();
+    rdr_sw_run(itf_decode_worker, &job);
+    double decoded = itf_now_ms();
+    bool ok = !atomic_load(&job.failed);
+    if (!ok) {
+        fprintf(stderr, "Can't decode iteration file `%s`: corrupted tile.\n", path);
+    }
+    /* Colors: gray levels of iter / max_iter or of the cumulative histogram. */
+    if (ok && histogram) {
+        uint64_t total = 0;
+        for (int i = 0; i < max_iter; i++) {
+            job.lut[i] = 0;
+            for (int w = 0; w < workerc; w++) {
+                job.lut[i] += job.counts[w][i];
+            }
+            total += job.lut[i];
+        }
+        uint32_t palette[256];
+        for (int c = 0; c < 256; c++) {
+            palette[c] = SDL_MapRGB(surface->format, c, c, c);
+        }
+        compute_hist_colors(job.lut, 0, max_iter, 0, total, palette);
+        job.lut[max_iter] = palette[0];
+    } else if (ok) {
+        for (int i = 0; i <= max_iter; i++) {
+            job.lut[i] = rdr_sw_map_color(surface->format, i, max_iter);
+        }
+    }
+    if (ok) {
+        rdr_sw_run(itf_color_worker, &job);
+        double colored = itf_now_ms();
+        fprintf(stdout, "> %dx%d iterations of `%s` (generator %d, max_iter %d, dpp %g) "
+                "decoded in %.2f ms, colored in %.2f ms\n", itf.width, itf.height, path,
+                itf.fi.generator, max_iter, itf.fi.dpp, decoded - start, colored - decoded);
+        ok = png_write_surface_mt(surface, output);
+        if (ok) {
+            fprintf(stdout, "> image written to `%s`\n", output);
+        }
+    }
+    for (int w = 0; job.counts && w < workerc; w++) {
+        free(job.counts[w]);
+    }
+    free(job.counts);
+    free(job.iters);
+    free(job.lut);
+    SDL_FreeSurface(surface);
+    iterfile_close(&itf);
+    return ok;
+}
@@ -0,0 +1,61 @@
+#ifndef _H_ITERFILE_
+#define _H_ITERFILE_
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+#include "types.h"
+
+/** ITERFILE_VERSION is the version of the iteration files written. */
+#define ITERFILE_VERSION 1
+/** ITERFILE_TILE_SIZE is the width & height of the tiles of iteration files. */
+#define ITERFILE_TILE_SIZE 64
+
+/** iterfile_channel flags the per pixel values of an iteration file; only
+ ** iteration counts are computed by the generators for now. */
+enum iterfile_channel {
+    ITERFILE_ITERATIONS = 1 << 0,
+    ITERFILE_SMOOTH     = 1 << 1, // reserved: fraction of the escape iteration.
+    ITERFILE_DISTANCE   = 1 << 2, // reserved: distance estimate.
+};
+
+/** iterfile is an iteration file mapped in memory. */
+struct iterfile {
+    int fd;
+    const uint8_t* map;
+    size_t size;
+    uint32_t version;
+    uint32_t channels;
+    int width, height;
+    int tiles_x, tiles_y;
+    struct fractal_info fi;
+    double t;
+};
+
+/** iterfile_save renders the width x height view of fi at time t with the
+ ** software renderer pool (see rdr_sw_pool_init) & saves its iteration
+ ** counts to path: a header with fi, then the tiles, each delta encoded
+ ** & deflated. Returns false on error. */
+bool iterfile_save(struct fractal_info fi, int width, int height, double t, const char* path);
+/** iterfile_write saves the iteration counts iters of the width x height view
+ ** of fi at time t, row by row, to path like iterfile_save. Returns false on
+ ** error. */
+bool iterfile_write(struct fractal_info fi, int width, int height, double t,
+        const int32_t* iters, const char* path);
+/** iterfile_open maps the iteration file path to itf. Returns false on error,
+ ** otherwise caller is responsible for calling iterfile_close on itf. */
+bool iterfile_open(const char* path, struct iterfile* itf);
+/** iterfile_close unmaps itf. */
+void iterfile_close(struct iterfile* itf);
+/** iterfile_read_tile decodes tile (tx, ty) of itf to iters, row by row
+ ** (ITERFILE_TILE_SIZE values, less on the right & bottom edges). Returns
+ ** false if the tile is corrupted. */
+bool iterfile_read_tile(struct iterfile* itf, int tx, int ty, int32_t* iters);
+/** iterfile_recolor colors the iteration file path with the software renderer
+ ** pool, gray levels by iter / max_iter or by histogram (see
+ ** rdr_sw_set_histogram), & writes it to the PNG file output. Returns false
+ ** on error. */
+bool iterfile_recolor(const char* path, const char* output, bool histogram);
+
+#endif
@@ -0,0 +1,425 @@
+#include "libfractal.h"
+
+#include <stdlib.h>
+#include <string.h>
+
+#ifdef MT
+#include <pthread.h>
+#include <sys/sysinfo.h>
+#endif
+
+#include "compute.h"
+#include "panic.h"
+
+/** LF_BAND_ROWS is the height of the bands of rows of jobs. */
+#define LF_BAND_ROWS 16
+
+/** lf_job is a render posted to a pool: bands are claimed by workers & the
+ ** posting thread, next is the first unclaimed one. Output is either iters
+ ** or gray pixels, or pixels colored from iters by lut (histogram); tasks
+ ** (see lf_pool_post) run task instead. */
+struct lf_job {
+    struct lf_pool* pool;
+    lf_task task;
+    void* arg;
+    struct fractal_info fi;
+    int width, height;
+    int32_t* iters;
+    const uint32_t* lut;
+    uint32_t* pixels;
+    int pitch; // bytes.
+    int bandc;
+    int next;
+    int pending; // bands not done.
+    struct lf_job* queued; // next job with unclaimed bands.
+};
+
+struct lf_pool {
+    int threadc;
+#ifdef MT
+    pthread_t* threads;
+    pthread_mutex_t mutex;
+    pthread_cond_t cond_work; // a job was queued, or quit.
+    pthread_cond_t cond_done; // a job is done.
+    struct lf_job* head; // jobs with unclaimed bands, in order of post.
+    struct lf_job* tail;
+    bool quit;
+#endif
+};
+
+struct lf_ctx {
+    struct lf_pool* pool;
+    bool histogram;
+    /* Histogram colouring buffers. */
+    int32_t* iters;
+    size_t pixels;
+    uint32_t* lut;
+    int size;
+};
+
+/** lf_gray returns the ARGB8888 gray of level color. */
+static inline uint32_t lf_gray(uint8_t color) {
+    return 0xff000000u | (uint32_t)color << 16 | (uint32_t)color << 8 | color;
+}
+
+/** lf_band computes band of job on the calling thread. */
+static void lf_band(struct lf_job* job, int band) {
+    if (job->task) {
+        job->task(job->arg, band, job->bandc);
+        return;
+    }
+    int width = job->width;
+    int y0 = band * LF_BAND_ROWS;
+    int y1 = (y0 + LF_BAND_ROWS < job->height) ? y0 + LF_BAND_ROWS : job->height;
+    int max_iter = job->fi.max_iter;
+    if (job->lut) {
+        uint32_t black = lf_gray(0);
+        for (int y = y0; y < y1; y++) {
+            uint32_t* row = (uint32_t*)((uint8_t*)job->pixels + (size_t)y * job->pitch);
+            const int32_t* iters = job->iters + (size_t)y * width;
+            for (int x = 0; x < width; x++) {
+                row[x] = (iters[x] < max_iter) ? job->lut[iters[x]] : black;
+            }
+        }
+        return;
+    }
+    if (job->iters) {
+        compute_iters(job->iters + (size_t)y0 * width, job->fi,
+                width, job->height, 0, y0, width, y1 - y0);
+        return;
+    }
+    int32_t iters[width];
+    for (int y = y0; y < y1; y++) {
+        compute_iters(iters, job->fi, width, job->height, 0, y, width, 1);
+        uint32_t* row = (uint32_t*)((uint8_t*)job->pixels + (size_t)y * job->pitch);
+        for (int x = 0; x < width; x++) {
+            row[x] = lf_gray(compute_gray(iters[x], max_iter));
+        }
+    }
+}
+
+#ifdef MT
+/** lf_claim returns the next band of job & dequeues it once all its bands
+ ** are claimed, -1 if none is left. pool->mutex must be held. */
+static int lf_claim(struct lf_pool* pool, struct lf_job* job) {
+    if (job->next >= job->bandc) {
+        return -1;
+    }
+    int band = job->next++;
+    if (job->next == job->bandc) {
+        struct lf_job** link = &pool->head;
+        struct lf_job* prev = NULL;
+        while (*link != job) {
+            prev = *link;
+            link = &(*link)->queued;
+        }
+        *link = job->queued;
+        if (pool->tail == job) {
+            pool->tail = prev;
+        }
+        job->queued = NULL;
+    }
+    return band;
+}
+
+/** lf_done counts band of job done. pool->mutex must be held. */
+static void lf_done(struct lf_pool* pool, struct lf_job* job) {
+    if (--job->pending == 0) {
+        pthread_cond_broadcast(&pool->cond_done);
+    }
+}
+
+/** lf_thread runs bands of the queued jobs until the pool quits. */
+static void* lf_thread(void* arg) {
+    struct lf_pool* pool = arg;
+    int s = pthread_mutex_lock(&pool->mutex);
+    if (s != 0) panicen(s, "pthread_mutex_lock");
+    while (true) {
+        while (!pool->head && !pool->quit) {
+            s = pthread_cond_wait(&pool->cond_work, &pool->mutex);
+            if (s != 0) panicen(s, "pthread_cond_wait");
+        }
+        if (!pool->head) {
+            break;
+        }
+        struct lf_job* job = pool->head;
+        int band = lf_claim(pool, job);
+        s = pthread_mutex_unlock(&pool->mutex);
+        if (s != 0) panicen(s, "pthread_mutex_unlock");
+        lf_band(job, band);
+        s = pthread_mutex_lock(&pool->mutex);
+        if (s != 0) panicen(s, "pthread_mutex_lock");
+        lf_done(pool, job);
+    }
+    s = pthread_mutex_unlock(&pool->mutex);
+    if (s != 0) panicen(s, "pthread_mutex_unlock");
+    return NULL;
+}
+#endif
+
+#ifdef MT
+/** lf_queue queues job after the jobs posted before it & wakes the workers.
+ ** pool->mutex must be held. */
+static void lf_queue(struct lf_pool* pool, struct lf_job* job) {
+    if (pool->tail) {
+        pool->tail->queued = job;
+    } else {
+        pool->head = job;
+    }
+    pool->tail = job;
+    pthread_cond_broadcast(&pool->cond_work);
+}
+
+/** lf_wait waits for the last band of job. pool->mutex must be held. */
+static void lf_wait(struct lf_pool* pool, struct lf_job* job) {
+    while (job->pending > 0) {
+        int s = pthread_cond_wait(&pool->cond_done, &pool->mutex);
+        if (s != 0) panicen(s, "pthread_cond_wait");
+    }
+}
+#endif
+
+/** lf_run posts job to pool, runs its bands along with the workers & waits
+ ** for the last one. */
+static void lf_run(struct lf_pool* pool, struct lf_job* job) {
+    job->pool = pool;
+    job->bandc = (job->height + LF_BAND_ROWS - 1) / LF_BAND_ROWS;
+    job->next = 0;
+    job->pending = job->bandc;
+    job->queued = NULL;
+#ifdef MT
+    if (job->bandc == 0) {
+        return;
+    }
+    int s = pthread_mutex_lock(&pool->mutex);
+    if (s != 0) panicen(s, "pthread_mutex_lock");
+    lf_queue(pool, job);
+    /* Help: the caller would wait anyway. */
+    int band;
+    while ((band = lf_claim(pool, job)) >= 0) {
+        s = pthread_mutex_unlock(&pool->mutex);
+        if (s != 0) panicen(s, "pthread_mutex_unlock");
+        lf_band(job, band);
+        s = pthread_mutex_lock(&pool->mutex);
+        if (s != 0) panicen(s, "pthread_mutex_lock");
+        lf_done(pool, job);
+    }
+    lf_wait(pool, job);
+    s = pthread_mutex_unlock(&pool->mutex);
+    if (s != 0) panicen(s, "pthread_mutex_unlock");
+#else
+    (void)pool;
+    for (int band = 0; band < job->bandc; band++) {
+        lf_band(job, band);
+    }
+#endif
+}
+
+struct lf_job* lf_pool_post(struct lf_pool* pool, lf_task task, void* arg, int bandc) {
+    struct lf_job* job = calloc(1, sizeof(struct lf_job));
+    if (!job) {
+        panic("Error: can't allocate the job.");
+    }
+    job->pool = pool;
+    job->task = task;
+    job->arg = arg;
+    job->bandc = (bandc > 0) ? bandc : 0;
+    job->pending = job->bandc;
+#ifdef MT
+    if (job->bandc == 0) {
+        return job;
+    }
+    int s = pthread_mutex_lock(&pool->mutex);
+    if (s != 0) panicen(s, "pthread_mutex_lock");
+    lf_queue(pool, job);
+    s = pthread_mutex_unlock(&pool->mutex);
+    if (s != 0) panicen(s, "pthread_mutex_unlock");
+#else
+    for (int band = 0; band < job->bandc; band++) {
+        lf_band(job, band);
+    }
+    job->pending = 0;
+#endif
+    return job;
+}
+
+bool lf_job_done(struct lf_job* job) {
+#ifdef MT
+    struct lf_pool* pool = job->pool;
+    int s = pthread_mutex_lock(&pool->mutex);
+    if (s != 0) panicen(s, "pthread_mutex_lock");
+    bool done = job->pending == 0;
+    s = pthread_mutex_unlock(&pool->mutex);
+    if (s != 0) panicen(s, "pthread_mutex_unlock");
+    return done;
+#else
+    return true;
+#endif
+}
+
+void lf_job_wait(struct lf_job* job) {
+#ifdef MT
+    struct lf_pool* pool = job->pool;
+    int s = pthread_mutex_lock(&pool->mutex);
+    if (s != 0) panicen(s, "pthread_mutex_lock");
+    lf_wait(pool, job);
+    s = pthread_mutex_unlock(&pool->mutex);
+    if (s != 0) panicen(s, "pthread_mutex_unlock");
+#endif
+    free(job);
+}
+
+struct lf_pool* lf_pool_open(int threads) {
+    struct lf_pool* pool = calloc(1, sizeof(struct lf_pool));
+    if (!pool) {
+        panic("Error: can't allocate the pool.");
+    }
+#ifdef MT
+    pool->threadc = (threads > 0) ? threads : get_nprocs();
+    pool->threads = calloc(pool->threadc, sizeof(pthread_t));
+    if (!pool->threads) {
+        panic("Error: can't allocate the pool.");
+    }
+    int s = pthread_mutex_init(&pool->mutex, NULL);
+    if (s != 0) panicen(s, "pthread_mutex_init");
+    s = pthread_cond_init(&pool->cond_work, NULL);
+    if (s != 0) panicen(s, "pthread_cond_init");
+    s = pthread_cond_init(&pool->cond_done, NULL);
+    if (s != 0) panicen(s, "pthread_cond_init");
+    for (int w = 0; w < pool->threadc; w++) {
+        s = pthread_create(&pool->threads[w], NULL, lf_thread, pool);
+        if (s != 0) panicen(s, "pthread_create");
+    }
+#else
+    (void)threads;
+    pool->threadc = 0;
+#endif
+    return pool;
+}
+
+void lf_pool_close(struct lf_pool* pool) {
+#ifdef MT
+    int s = pthread_mutex_lock(&pool->mutex);
+    if (s != 0) panicen(s, "pthread_mutex_lock");
+    pool->quit = true;
+    pthread_cond_broadcast(&pool->cond_work);
+    s = pthread_mutex_unlock(&pool->mutex);
+    if (s != 0) panicen(s, "pthread_mutex_unlock");
+    for (int w = 0; w < pool->threadc; w++) {
+        s = pthread_join(pool->threads[w], NULL);
+        if (s != 0) panicen(s, "pthread_join");
+    }
+    s = pthread_mutex_destroy(&pool->mutex);
+    if (s != 0) panicen(s, "pthread_mutex_destroy");
+    s = pthread_cond_destroy(&pool->cond_work);
+    if (s != 0) panicen(s, "pthread_cond_destroy");
+    s = pthread_cond_destroy(&pool->cond_done);
+    if (s != 0) panicen(s, "pthread_cond_destroy");
+    free(pool->threads);
+#endif
+    free(pool);
+}
+
+int lf_pool_size(struct lf_pool* pool) {
+    return pool->threadc;
+}
+
+struct lf_ctx* lf_ctx_open(struct lf_pool* pool) {
+    struct lf_ctx* ctx = calloc(1, sizeof(struct lf_ctx));
+    if (!ctx) {
+        panic("Error: can't allocate the render context.");
+    }
+    ctx->pool = pool;
+    return ctx;
+}
+
+void lf_ctx_close(struct lf_ctx* ctx) {
+    free(ctx->iters);
+    free(ctx->lut);
+    free(ctx);
+}
+
+void lf_ctx_set_histogram(struct lf_ctx* ctx, bool histogram) {
+    ctx->histogram = histogram;
+}
+
+void lf_render_iters(struct lf_ctx* ctx, struct fractal_info fi, double t,
+        int32_t* iters, int width, int height) {
+    struct lf_job job = {
+        .fi = fi_at(fi, t),
+        .width = width,
+        .height = height,
+        .iters = iters,
+    };
+    lf_run(ctx->pool, &job);
+}
+
+/** lf_hist_color colors the iters of ctx to pixels like rdr_sw_hist_worker:
+ ** the gray of a count is its share of the cumulative histogram. Counts are
+ ** summed on the calling thread, pixels are colored on the pool. */
+static void lf_hist_color(struct lf_ctx* ctx, struct fractal_info fi,
+        uint32_t* pixels, int pitch, int width, int height) {
+    int max_iter = fi.max_iter;
+    if (max_iter + 1 > ctx->size) {
+        free(ctx->lut);
+        ctx->size = max_iter + 1;
+        ctx->lut = malloc(ctx->size * sizeof(uint32_t));
+        if (!ctx->lut) {
+            panic("Error: can't allocate histogram buffers.");
+        }
+    }
+    uint32_t* lut = ctx->lut;
+    memset(lut, 0, (max_iter + 1) * sizeof(uint32_t));
+    size_t count = (size_t)width * height;
+    for (size_t p = 0; p < count; p++) {
+        int32_t iter = ctx->iters[p];
+        if (iter < max_iter) {
+            lut[iter]++;
+        }
+    }
+    uint64_t total = 0;
+    for (int i = 0; i < max_iter; i++) {
+        total += lut[i];
+    }
+    uint32_t palette[256];
+    for (int c = 0; c < 256; c++) {
+        palette[c] = lf_gray(c);
+    }
+    compute_hist_colors(lut, 0, max_iter, 0, total, palette);
+    struct lf_job job = {
+        .fi = fi,
+        .width = width,
+        .height = height,
+        .iters = ctx->iters,
+        .lut = lut,
+        .pixels = pixels,
+        .pitch = pitch,
+    };
+    lf_run(ctx->pool, &job);
+}
+
+void lf_render(struct lf_ctx* ctx, struct fractal_info fi, double t,
+        uint32_t* pixels, int pitch, int width, int height) {
+    if (!ctx->histogram) {
+        struct lf_job job = {
+            .fi = fi_at(fi, t),
+            .width = width,
+            .height = height,
+            .pixels = pixels,
+            .pitch = pitch,
+        };
+        lf_run(ctx->pool, &job);
+        return;
+    }
+    size_t count = (size_t)width * height;
+    if (count > ctx->pixels) {
+        free(ctx->iters);
+        ctx->pixels = count;
+        ctx->iters = malloc(count * sizeof(int32_t));
+        if (!ctx->iters) {
+            panic("Error: can't allocate histogram buffers.");
+        }
+    }
+    lf_render_iters(ctx, fi, t, ctx->iters, width, height);
+    lf_hist_color(ctx, fi, pixels, pitch, width, height);
+}
@@ -0,0 +1,63 @@
+#ifndef _H_LIBFRACTAL_
+#define _H_LIBFRACTAL_
+
+#include <stdbool.h>
+#include <stdint.h>
+
+#include "types.h"
+
+/** lf_pool is a pool of worker threads shared by render contexts & tasks:
+ ** renders posted concurrently are split in bands of rows, claimed in order
+ ** of post by the workers and the threads waiting for them. The software
+ ** renderer runs its work orders on a pool as tasks (see rdr_sw_pool_get). */
+struct lf_pool;
+/** lf_ctx is a render context: the options & buffers of renders. Renders of
+ ** distinct contexts may run concurrently from any threads; a context runs
+ ** one render at a time. */
+struct lf_ctx;
+
+/** lf_pool_open launches a pool of threads workers (0: one per processor;
+ ** none without MT, renders run on the calling thread). Caller is
+ ** responsible for calling lf_pool_close once its contexts are closed. */
+struct lf_pool* lf_pool_open(int threads);
+/** lf_pool_close stops the workers of pool & frees it. */
+void lf_pool_close(struct lf_pool* pool);
+/** lf_pool_size returns the number of workers of pool. */
+int lf_pool_size(struct lf_pool* pool);
+
+/** lf_task runs band band of the bandc bands of a task (see lf_pool_post). */
+typedef void (*lf_task)(void* arg, int band, int bandc);
+/** lf_job is a render or a task posted to a pool. */
+struct lf_job;
+/** lf_pool_post posts the bandc bands of task on arg to the workers of pool
+ ** & returns without waiting (without MT, they run on the calling thread).
+ ** A worker runs one band at a time & bands are claimed in order of post:
+ ** when bandc doesn't exceed lf_pool_size, the bands of task run on
+ ** distinct workers & may wait for each other. Caller is responsible for
+ ** calling lf_job_wait. */
+struct lf_job* lf_pool_post(struct lf_pool* pool, lf_task task, void* arg, int bandc);
+/** lf_job_done tells if the bands of job are done, without waiting. */
+bool lf_job_done(struct lf_job* job);
+/** lf_job_wait waits for the bands of job & frees it. */
+void lf_job_wait(struct lf_job* job);
+
+/** lf_ctx_open returns a render context using pool. Caller is responsible for
+ ** calling lf_ctx_close. */
+struct lf_ctx* lf_ctx_open(struct lf_pool* pool);
+/** lf_ctx_close frees ctx & its buffers. */
+void lf_ctx_close(struct lf_ctx* ctx);
+/** lf_ctx_set_histogram enables histogram colouring of the renders of ctx
+ ** (see rdr_sw_set_histogram). */
+void lf_ctx_set_histogram(struct lf_ctx* ctx, bool histogram);
+
+/** lf_render_iters computes the iteration counts of the width x height view
+ ** of fi at time t to iters, row by row, & waits for them. */
+void lf_render_iters(struct lf_ctx* ctx, struct fractal_info fi, double t,
+        int32_t* iters, int width, int height);
+/** lf_render renders the width x height view of fi at time t to the ARGB8888
+ ** pixels, rows of pitch bytes, with the gray levels of the software
+ ** renderer, & waits for them. */
+void lf_render(struct lf_ctx* ctx, struct fractal_info fi, double t,
+        uint32_t* pixels, int pitch, int width, int height);
+
+#endif
@@ -7,13 +7,43 @@
 
 #include "renderer_software.h"
 #include "renderer_hardware.h"
+#include "atlas.h"
+#include "autoiter.h"
+#include "cluster.h"
 #include "config.h"
+#include "heatmap.h"
+#include "iterfile.h"
+#include "orbits.h"
 #include "panic.h"
+#include "pyramid.h"
+#include "server.h"
+#include "session.h"
+#include "tile_cache.h"
 #include "types.h"
 
 /* Default config. */
 static char* title = "fractal";
 static char* config_file = "config.toml";
+/* Batch modes. */
+static int pyramid_levels = -1;
+static char* output = NULL;
+static int resume = 0;
+static int serve_port = 0;
+static int queue_size = 64;
+static char* coordinator_addr = NULL;
+static char* worker_addr = NULL;
+static int spawn = 0;
+static int orbits = 0;
+static int autotune = 0;
+static int no_vsync = 0;
+static char* record_file = NULL;
+static char* replay_file = NULL;
+static int heatmap = 0;
+static char* save_iters_file = NULL;
+static char* recolor_file = NULL;
+static char* atlas_size = NULL;
+static int atlas_thumb = 32;
+static int atlas_overlay = 0;
 struct fractal_info default_fi = {
     .generator = GEN_MANDELBROT,
     .max_iter  = 50,
@@ -34,6 +64,7 @@ struct config default_config = {
     .iter_step  = 10,
     .speed      = 1.0,
     .speed_step = 0.33,
+    .cache_size = 64,
     .preset     = 0,
     .presets    = (struct fractal_info**) &default_presets,
     .presetc    = sizeof(default_presets)/sizeof(default_presets[0]),
@@ -47,12 +78,32 @@ struct state {
     bool quit;
     bool updt;
     bool pause;
+    bool held; // a mouse button is down: no new views nor times are posted.
     double t;
     double dt;
+    struct session* session; // recording, NULL otherwise.
+    struct autoiter* autoiter; // max_iter estimation, NULL otherwise.
 };
 
 void handle_events(struct state* state);
 
+/** animating tells if the frames of state change over time. */
+static bool animating(struct state* state) {
+    return state->fi.dynamic && !state->pause && state->fi.speed != 0;
+}
+
+/** vsync_enabled tells if the presents of the renderer of window wait for
+ ** the vertical sync of the display. */
+static bool vsync_enabled(SDL_Window* window, bool software) {
+    if (!software) {
+        return SDL_GL_GetSwapInterval() != 0;
+    }
+    SDL_Renderer* renderer = SDL_GetRenderer(window);
+    SDL_RendererInfo info;
+    return renderer && SDL_GetRendererInfo(renderer, &info) == 0
+        && (info.flags & SDL_RENDERER_PRESENTVSYNC);
+}
+
 int main(int argc, char* argv[]) {
     /* CLI arguments. */
     struct config cli_config = {0};
@@ -71,12 +122,60 @@ int main(int argc, char* argv[]) {
             &cli_config.max_iter, 0, "Set max iteration limit", NULL},
         {"step", '\0', POPT_ARG_INT,
             &cli_config.iter_step, 0, "Set max iteration (incr|decr)ementation step", NULL},
+        {"auto-iter", '\0', POPT_ARG_INT,
+            &cli_config.auto_iter, 0, "Estimate max iteration limit per view from a probe pass", "0|1"},
         {"preset", 'p', POPT_ARG_INT,
             &cli_config.preset, 0, "Set fractal preset to use (index of presets, from 0)", NULL},
         {"speed", '\0', POPT_ARG_DOUBLE,
             &cli_config.speed, 0, "Set dynamic fractals rendering speed", NULL},
         {"software", 's', POPT_ARG_INT,
             &cli_config.software, 0, "Use software renderer (hardware renderer by default)", "0|1"},
+        {"cache", '\0', POPT_ARG_STRING,
+            &cli_config.cache_file, 0, "Set tile cache file (software renderer only)", "FILE"},
+        {"cache-size", '\0', POPT_ARG_INT,
+            &cli_config.cache_size, 0, "Set tile cache size limit in MiB", NULL},
+        {"histogram", '\0', POPT_ARG_INT,
+            &cli_config.histogram, 0, "Use histogram colouring (software renderer only)", "0|1"},
+        {"fps-target", '\0', POPT_ARG_INT,
+            &cli_config.fps_target, 0, "Scale resolution of dynamic fractals to hold INT fps (software renderer only)", NULL},
+        {"no-vsync", '\0', POPT_ARG_NONE,
+            &no_vsync, 0, "Pace animations with a 60 fps timer rather than the vertical sync", NULL},
+        {"autotune", '\0', POPT_ARG_NONE,
+            &autotune, 0, "Pick the fastest worker & thread count per generator (software renderer only)", NULL},
+        {"pyramid", '\0', POPT_ARG_INT,
+            &pyramid_levels, 0, "Render the tile pyramid of the preset up to level INT, then exit", NULL},
+        {"output", 'o', POPT_ARG_STRING,
+            &output, 0, "Set output path of batch modes (tiles, fractal.png by default)", "PATH"},
+        {"resume", '\0', POPT_ARG_NONE,
+            &resume, 0, "Skip tiles already on disk (batch modes)", NULL},
+        {"serve", '\0', POPT_ARG_INT,
+            &serve_port, 0, "Serve tiles & renders over HTTP on localhost:INT", NULL},
+        {"queue", '\0', POPT_ARG_INT|POPT_ARGFLAG_SHOW_DEFAULT,
+            &queue_size, 0, "Set max pending renders of the HTTP server", NULL},
+        {"coordinator", '\0', POPT_ARG_STRING,
+            &coordinator_addr, 0, "Render the preset with the workers connecting to ADDR, then exit", "unix:PATH|[HOST:]PORT"},
+        {"worker", '\0', POPT_ARG_STRING,
+            &worker_addr, 0, "Render tiles for the coordinator at ADDR, then exit", "unix:PATH|[HOST:]PORT"},
+        {"spawn", '\0', POPT_ARG_INT,
+            &spawn, 0, "Fork INT local workers (coordinator mode)", NULL},
+        {"orbits", '\0', POPT_ARG_INT,
+            &orbits, 0, "Render the orbit density of the preset with INT million samples, then exit", NULL},
+        {"heatmap", '\0', POPT_ARG_NONE,
+            &heatmap, 0, "Render the cost heatmap & per-tile costs of the preset, then exit", NULL},
+        {"save-iters", '\0', POPT_ARG_STRING,
+            &save_iters_file, 0, "Render the preset & save its iterations to FILE, then exit", "FILE"},
+        {"recolor", '\0', POPT_ARG_STRING,
+            &recolor_file, 0, "Color the iterations saved in FILE to the output image, then exit", "FILE"},
+        {"atlas", '\0', POPT_ARG_STRING,
+            &atlas_size, 0, "Render an atlas of julia sets across the c-plane view of the preset, then exit", "COLSxROWS"},
+        {"thumb", '\0', POPT_ARG_INT|POPT_ARGFLAG_SHOW_DEFAULT,
+            &atlas_thumb, 0, "Set width & height of atlas thumbnails", NULL},
+        {"overlay", '\0', POPT_ARG_NONE,
+            &atlas_overlay, 0, "Blend the atlas with the mandelbrot set", NULL},
+        {"record", '\0', POPT_ARG_STRING,
+            &record_file, 0, "Record the views of the session to FILE", "FILE"},
+        {"replay", '\0', POPT_ARG_STRING,
+            &replay_file, 0, "Render the views recorded in FILE & print render times, then exit", "FILE"},
         POPT_AUTOHELP
         POPT_TABLEEND
     };
@@ -111,6 +210,101 @@ int main(int argc, char* argv[]) {
     config_fallback(&cfg, default_config);
     config_override(&cfg, cli_config);
 
+    /* Batch modes. */
+    if (pyramid_levels >= 0) {
+        rdr_sw_pool_init();
+        bool ok = pyramid_render(*(cfg.presets[cfg.preset]), cfg.width, cfg.height,
+                pyramid_levels, (output) ? output : "tiles", resume);
+        rdr_sw_pool_free();
+        config_clear(&cfg);
+        return (ok) ? EXIT_SUCCESS : EXIT_FAILURE;
+    }
+    if (serve_port > 0) {
+        rdr_sw_pool_init();
+        bool ok = server_run(&cfg, serve_port, queue_size);
+        rdr_sw_pool_free();
+        config_clear(&cfg);
+        return (ok) ? EXIT_SUCCESS : EXIT_FAILURE;
+    }
+    if (orbits > 0) {
+        rdr_sw_pool_init();
+        bool ok = orbits_render(*(cfg.presets[cfg.preset]), cfg.width, cfg.height,
+                orbits, (output) ? output : "fractal.png");
+        rdr_sw_pool_free();
+        config_clear(&cfg);
+        return (ok) ? EXIT_SUCCESS : EXIT_FAILURE;
+    }
+    if (heatmap) {
+        rdr_sw_pool_init();
+        bool ok = heatmap_render(*(cfg.presets[cfg.preset]), cfg.width, cfg.height,
+                (output) ? output : "heatmap.png");
+        rdr_sw_pool_free();
+        config_clear(&cfg);
+        return (ok) ? EXIT_SUCCESS : EXIT_FAILURE;
+    }
+    if (save_iters_file) {
+        rdr_sw_pool_init();
+        bool ok = iterfile_save(*(cfg.presets[cfg.preset]), cfg.width, cfg.height, 0.0,
+                save_iters_file);
+        rdr_sw_pool_free();
+        config_clear(&cfg);
+        return (ok) ? EXIT_SUCCESS : EXIT_FAILURE;
+    }
+    if (recolor_file) {
+        rdr_sw_pool_init();
+        bool ok = iterfile_recolor(recolor_file, (output) ? output : "fractal.png", cfg.histogram);
+        rdr_sw_pool_free();
+        config_clear(&cfg);
+        return (ok) ? EXIT_SUCCESS : EXIT_FAILURE;
+    }
+    if (atlas_size) {
+        int cols = 0, rows = 0;
+        if (sscanf(atlas_size, "%dx%d", &cols, &rows) != 2) {
+            fprintf(stderr, "Can't parse atlas size `%s` (COLSxROWS).\n", atlas_size);
+            config_clear(&cfg);
+            return EXIT_FAILURE;
+        }
+        rdr_sw_pool_init();
+        bool ok = atlas_render(*(cfg.presets[cfg.preset]), cfg.width, cols, rows, atlas_thumb,
+                atlas_overlay, (output) ? output : "atlas.png");
+        rdr_sw_pool_free();
+        config_clear(&cfg);
+        return (ok) ? EXIT_SUCCESS : EXIT_FAILURE;
+    }
+    if (replay_file) {
+        /* Options of the session, of the config for older sessions. */
+        struct session_options opts = {
+            .histogram  = cfg.histogram,
+        };
+        struct tile_cache* cache = NULL;
+        if (session_read_options(replay_file, &opts) && opts.cache_file) {
+            cache = tc_open(opts.cache_file, (size_t)opts.cache_size * 1024 * 1024);
+            rdr_sw_set_cache(cache);
+        }
+        rdr_sw_set_histogram(opts.histogram);
+        rdr_sw_pool_init();
+        bool ok = session_replay(replay_file, output);
+        rdr_sw_pool_free();
+        tc_close(cache);
+        free(opts.cache_file);
+        config_clear(&cfg);
+        return (ok) ? EXIT_SUCCESS : EXIT_FAILURE;
+    }
+    if (coordinator_addr) {
+        /* Workers are processes: no pool here, spawned ones launch theirs. */
+        bool ok = cluster_coordinate(*(cfg.presets[cfg.preset]), cfg.width, cfg.height,
+                coordinator_addr, spawn, (output) ? output : "fractal.png");
+        config_clear(&cfg);
+        return (ok) ? EXIT_SUCCESS : EXIT_FAILURE;
+    }
+    if (worker_addr) {
+        rdr_sw_pool_init();
+        bool ok = cluster_work(worker_addr);
+        rdr_sw_pool_free();
+        config_clear(&cfg);
+        return (ok) ? EXIT_SUCCESS : EXIT_FAILURE;
+    }
+
     /* Select renderer. */
     struct renderer renderer;
     if (cfg.software) {
@@ -119,6 +313,18 @@ int main(int argc, char* argv[]) {
         renderer = hw_renderer;
     }
 
+    /* Tile cache. */
+    struct tile_cache* cache = NULL;
+    if (cfg.software && cfg.cache_file) {
+        cache = tc_open(cfg.cache_file, (size_t)cfg.cache_size * 1024 * 1024);
+        rdr_sw_set_cache(cache);
+    }
+    if (cfg.software) {
+        rdr_sw_set_histogram(cfg.histogram);
+        rdr_sw_set_fps_target(cfg.fps_target);
+        rdr_sw_set_vsync(!no_vsync);
+    }
+
     /* Init. */
     SDL_Init(SDL_INIT_VIDEO);
     SDL_Window* window = SDL_CreateWindow(title,
@@ -130,8 +336,17 @@ int main(int argc, char* argv[]) {
         panic("Error: SDL can't open a window.");
     }
     renderer.init(window);
+    if (!cfg.software) {
+        /* The context of the hardware renderer is current. */
+        SDL_GL_SetSwapInterval((no_vsync) ? 0 : 1);
+    }
+    bool vsync = vsync_enabled(window, cfg.software);
+    if (cfg.software && autotune) {
+        rdr_sw_autotune(cfg.presets, cfg.presetc);
+    }
 
     /* Main loop variables. */
+    struct autoiter autoiter = {0};
     struct state state = {
         .window=   window,
         .renderer= &renderer,
@@ -140,11 +355,25 @@ int main(int argc, char* argv[]) {
         .quit=  false,
         .updt=  true,
         .pause= false,
+        .held=  false,
         .t  = 0.0,
         .dt = 0.0,
+        .session = NULL,
+        .autoiter = (cfg.auto_iter) ? &autoiter : NULL,
     };
+    if (record_file) {
+        struct session_options opts = {
+            .software   = cfg.software,
+            .histogram  = cfg.histogram,
+            .auto_iter  = cfg.auto_iter,
+            .fps_target = cfg.fps_target,
+            .cache_file = (cache) ? cfg.cache_file : NULL,
+            .cache_size = cfg.cache_size,
+        };
+        state.session = session_open(record_file, opts);
+    }
     uint32_t old_time = SDL_GetTicks();
-    uint32_t min_frame_time = 1000/60; // 60 fps limit.
+    uint32_t min_frame_time = 1000/60; // 60 fps limit, without vsync.
     uint32_t frame = 0;
     /* FPS display */
     uint32_t last_fps_display_time = old_time;
@@ -153,43 +382,71 @@ int main(int argc, char* argv[]) {
 
     /* Main loop. */
     while (!state.quit) {
-        /* Event handling */
+        /* Event handling: sleep until the next event when idle. */
+        if (!state.updt) {
+            SDL_WaitEvent(NULL);
+            old_time = SDL_GetTicks();
+        }
         handle_events(&state);
 
         /* Rendering */
         if (state.updt) {
-            renderer.render(state.fi, state.t, state.dt);
-            if (!state.fi.dynamic) {
+            /* Frames may take several calls: keep presenting until done. */
+            struct fractal_info fi = state.fi;
+            int width, height;
+            SDL_GetWindowSize(window, &width, &height);
+            if (state.autoiter) {
+                fi = autoiter_select(state.autoiter, fi, width, height, state.t);
+            }
+            bool completed = renderer.render(fi, state.t, state.dt);
+            if (state.session) {
+                /* The view rendered: estimated max_iter, frame scale. */
+                session_record(state.session, SDL_GetTicks(), width, height, fi, state.t,
+                        (cfg.software) ? rdr_sw_get_scale() : 1.0);
+            }
+            if (completed) {
+                frame++;
+            }
+            if (completed && !state.fi.dynamic) {
+                tc_print_stats(cache, stdout);
+            }
+            if (completed && (!animating(&state) || state.held)) {
                 state.updt = false;
             }
         }
 
-        /* FPS limiter */
+        /* FPS limiter: presents wait for the vertical sync if enabled. */
         uint32_t new_time = SDL_GetTicks();
         uint32_t frame_time = new_time - old_time;
         old_time = new_time;
-        if (frame_time < min_frame_time) {
+        if (!vsync && frame_time < min_frame_time) {
             SDL_Delay(min_frame_time - frame_time);
         }
-        if (state.fi.dynamic && !state.pause) {
+        if (state.fi.dynamic && !state.pause && !state.held) {
             state.dt = 0.001 * (double)frame_time;
             state.t += state.dt * state.fi.speed;
         }
-        frame++;
 
         /* Display fps in console. */
-        if (state.fi.dynamic && new_time > last_fps_display_time + fps_display_interval) {
-            fprintf(stdout, "> %d frames per second\n", frame - last_fps_display_at_frame);
+        if (animating(&state) && new_time > last_fps_display_time + fps_display_interval) {
+            if (cfg.software && cfg.fps_target) {
+                fprintf(stdout, "> %d frames per second (scale %d%%)\n",
+                        frame - last_fps_display_at_frame, (int)(rdr_sw_get_scale() * 100.0 + 0.5));
+            } else {
+                fprintf(stdout, "> %d frames per second\n", frame - last_fps_display_at_frame);
+            }
             last_fps_display_time = new_time;
             last_fps_display_at_frame = frame;
-        } else if (!state.fi.dynamic) {
+        } else if (!animating(&state)) {
             last_fps_display_time = new_time;
             last_fps_display_at_frame = frame;
         }
     }
 
     /* Deinit. */
+    session_close(state.session);
     renderer.free();
+    tc_close(cache);
     SDL_DestroyWindow(window);
     SDL_Quit();
     config_clear(&cfg);
@@ -238,19 +495,19 @@ void handle_events(struct state* state) {
                         break;
 
                     case SDLK_UP:
-                        fi_translate(&state->fi, state->window, 0,  state->cfg->translatef);
+                        fi_translate(&state->fi, width, height, 0,  state->cfg->translatef);
                         state->updt = true;
                         break;
                     case SDLK_DOWN:
-                        fi_translate(&state->fi, state->window, 0, -state->cfg->translatef);
+                        fi_translate(&state->fi, width, height, 0, -state->cfg->translatef);
                         state->updt = true;
                         break;
                     case SDLK_RIGHT:
-                        fi_translate(&state->fi, state->window,  state->cfg->translatef, 0);
+                        fi_translate(&state->fi, width, height,  state->cfg->translatef, 0);
                         state->updt = true;
                         break;
                     case SDLK_LEFT:
-                        fi_translate(&state->fi, state->window, -state->cfg->translatef, 0);
+                        fi_translate(&state->fi, width, height, -state->cfg->translatef, 0);
                         state->updt = true;
                         break;
 
@@ -309,7 +566,8 @@ void handle_events(struct state* state) {
                     case SDL_BUTTON_MIDDLE:
                         mbpx = event.button.x;
                         mbpy = event.button.y;
-                        state->updt = false;
+                        /* The frame in flight is still presented. */
+                        state->held = true;
                         break;
                 }
                 break;
@@ -329,7 +587,7 @@ void handle_events(struct state* state) {
                             int new_center_y = (mbry + mbpy) / 2;
                             double tx = ((double)(new_center_x) - center_x) / width;
                             double ty = ((double)(new_center_y) - center_y) / height;
-                            fi_translate(&state->fi, state->window, tx, -ty);
+                            fi_translate(&state->fi, width, height, tx, -ty);
                             /* ...then zoom in. */
                             double fx = width / (double)abs(mbrx - mbpx);
                             double fy = height / (double)abs(mbry - mbpy);
@@ -345,9 +603,10 @@ void handle_events(struct state* state) {
                         int dy = mbry - mbpy;
                         double tx = (double)(dx) / width;
                         double ty = (double)(dy) / height;
-                        fi_translate(&state->fi, state->window, tx, -ty);
+                        fi_translate(&state->fi, width, height, tx, -ty);
                         break;
                 }
+                state->held = false;
                 state->updt = true;
                 break;
         }
@@ -0,0 +1,300 @@
+#include "orbits.h"
+
+#include <math.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <SDL2/SDL.h>
+
+#include "png.h"
+#include "renderer_software.h"
+
+#define ORB_PASSES 16
+#define ORB_MAX_CHANNELS 3
+/* Points c are sampled in [-ORB_RADIUS, ORB_RADIUS]^2. */
+#define ORB_RADIUS 2.0
+/* Views smaller than this fraction of the sampled area use Metropolis-Hastings. */
+#define ORB_METROPOLIS_AREA 0.01
+/* Probability of a Metropolis-Hastings mutation to be a new uniform sample. */
+#define ORB_LARGE_MUTATION 0.2
+
+/** orb_chain is the Metropolis-Hastings state of a worker. */
+struct orb_chain {
+    double cr, ci;
+    int escape;
+    /** contribution is the number of orbit points of c in view. */
+    int contribution;
+    /** stay is the number of steps spent on c since its last splat. */
+    long long stay;
+};
+
+struct orbits_job {
+    struct fractal_info fi;
+    int width, height;
+    double ox, oy; // local coords of pixel (0, 0).
+    int channelc;
+    int limits[ORB_MAX_CHANNELS];
+    bool metropolis;
+    double sigma; // small mutations standard deviation.
+    long long samples; // per worker per pass.
+    int pass;
+    /* Per worker. */
+    float** shards;
+    uint64_t* rngs;
+    struct orb_chain* chains;
+    /* Merged histograms. */
+    double* total;
+    size_t pixelc;
+};
+
+/** orb_rand returns a uniform double in [0, 1) (xorshift64*). */
+static double orb_rand(uint64_t* state) {
+    uint64_t x = *state;
+    x ^= x >> 12;
+    x ^= x << 25;
+    x ^= x >> 27;
+    *state = x;
+    return (double)((x * 0x2545F4914F6CDD1DULL) >> 11) * 0x1p-53;
+}
+
+/** orb_gauss returns a normal random number (Box-Muller). */
+static double orb_gauss(uint64_t* state) {
+    double u = 1.0 - orb_rand(state);
+    double v = orb_rand(state);
+    return sqrt(-2.0 * log(u)) * cos(2 * M_PI * v);
+}
+
+/** orb_escape returns the iteration at which the orbit of c escapes like
+ ** mandelbrot, -1 if it doesn't within max_iter. */
+static int orb_escape(double cr, double ci, int max_iter) {
+    /* Main cardioid & period-2 bulb never escape. */
+    double q = (cr - 0.25) * (cr - 0.25) + ci * ci;
+    if (q * (q + (cr - 0.25)) <= 0.25 * ci * ci
+            || (cr + 1) * (cr + 1) + ci * ci <= 0.0625) {
+        return -1;
+    }
+    double zr = 0, zi = 0;
+    for (int iter = 0; iter < max_iter; iter++) {
+        double t = zr;
+        zr = (zr * zr) - (zi * zi) + cr;
+        zi = (2 * t * zi) + ci;
+        if (zr * zr + zi * zi > 4.0) {
+            return iter;
+        }
+    }
+    return -1;
+}
+
+/** orb_splat adds weight to the pixels visited by the first escape points of
+ ** the orbit of c, in the channels whose limit is above escape. Returns the
+ ** number of points in view; shard may be NULL to only count them. */
+static int orb_splat(struct orbits_job* job, float* shard, double cr, double ci,
+        int escape, float weight) {
+    int in_view = 0;
+    double zr = 0, zi = 0;
+    double inv_dpp = 1 / job->fi.dpp;
+    for (int iter = 0; iter < escape; iter++) {
+        double t = zr;
+        zr = (zr * zr) - (zi * zi) + cr;
+        zi = (2 * t * zi) + ci;
+        double px = floor((zr - job->ox) * inv_dpp + 0.5);
+        double py = floor((zi - job->oy) * inv_dpp + 0.5);
+        if (px < 0 || py < 0 || px >= job->width || py >= job->height) {
+            continue;
+        }
+        in_view++;
+        if (!shard) {
+            continue;
+        }
+        size_t p = (size_t)py * job->width + (size_t)px;
+        for (int ch = 0; ch < job->channelc && escape < job->limits[ch]; ch++) {
+            shard[ch * job->pixelc + p] += weight;
+        }
+    }
+    return in_view;
+}
+
+/** orb_uniform_worker splats the orbits of uniformly sampled points. */
+static void orb_uniform_worker(struct orbits_job* job, int workeri) {
+    float* shard = job->shards[workeri];
+    uint64_t* rng = &job->rngs[workeri];
+    for (long long s = 0; s < job->samples; s++) {
+        double cr = (2 * orb_rand(rng) - 1) * ORB_RADIUS;
+        double ci = (2 * orb_rand(rng) - 1) * ORB_RADIUS;
+        int escape = orb_escape(cr, ci, job->fi.max_iter);
+        if (escape >= 0) {
+            orb_splat(job, shard, cr, ci, escape, 1.0f);
+        }
+    }
+}
+
+/** orb_metropolis_worker walks a Metropolis-Hastings chain whose states c are
+ ** distributed as their number of orbit points in view; each state is
+ ** splatted with weight stay / contribution to keep the density unbiased. */
+static void orb_metropolis_worker(struct orbits_job* job, int workeri) {
+    float* shard = job->shards[workeri];
+    uint64_t* rng = &job->rngs[workeri];
+    struct orb_chain* chain = &job->chains[workeri];
+    for (long long s = 0; s < job->samples; s++) {
+        double cr, ci;
+        if (chain->contribution == 0 || orb_rand(rng) < ORB_LARGE_MUTATION) {
+            cr = (2 * orb_rand(rng) - 1) * ORB_RADIUS;
+            ci = (2 * orb_rand(rng) - 1) * ORB_RADIUS;
+        } else {
+            cr = chain->cr + job->sigma * orb_gauss(rng);
+            ci = chain->ci + job->sigma * orb_gauss(rng);
+        }
+        int escape = orb_escape(cr, ci, job->fi.max_iter);
+        int contribution = (escape >= 0) ? orb_splat(job, NULL, cr, ci, escape, 0) : 0;
+        if (contribution == 0 && chain->contribution == 0) {
+            continue;
+        }
+        /* Symmetric proposals: accept with the ratio of contributions. */
+        if (chain->contribution == 0
+                || orb_rand(rng) * chain->contribution < contribution) {
+            if (chain->stay > 0) {
+                orb_splat(job, shard, chain->cr, chain->ci, chain->escape,
+                        (float)chain->stay / chain->contribution);
+            }
+            chain->cr = cr;
+            chain->ci = ci;
+            chain->escape = escape;
+            chain->contribution = contribution;
+            chain->stay = 0;
+        }
+        chain->stay++;
+    }
+    /* Splat the current state so that the pass is complete. */
+    if (chain->contribution > 0 && chain->stay > 0) {
+        orb_splat(job, shard, chain->cr, chain->ci, chain->escape,
+                (float)chain->stay / chain->contribution);
+        chain->stay = 0;
+    }
+}
+
+static void orb_sample_worker(void* arg, int workeri, int workerc) {
+    (void)workerc;
+    struct orbits_job* job = arg;
+    if (job->metropolis) {
+        orb_metropolis_worker(job, workeri);
+    } else {
+        orb_uniform_worker(job, workeri);
+    }
+}
+
+/** orb_reduce_worker adds a slice of all shards to total and clears them:
+ ** a parallel reduction without shared atomics. */
+static void orb_reduce_worker(void* arg, int workeri, int workerc) {
+    struct orbits_job* job = arg;
+    size_t n = job->pixelc * job->channelc;
+    size_t start = n * workeri / workerc;
+    size_t end = n * (workeri + 1) / workerc;
+    for (int w = 0; w < workerc; w++) {
+        float* shard = job->shards[w];
+        for (size_t i = start; i < end; i++) {
+            job->total[i] += shard[i];
+            shard[i] = 0;
+        }
+    }
+}
+
+/** orb_write tone maps the merged histograms (square root of the density
+ ** relative to its maximum, per channel) to the PNG file output. */
+static bool orb_write(struct orbits_job* job, const char* output) {
+    SDL_Surface* surface = SDL_CreateRGBSurface(0, job->width, job->height, 32, 0, 0, 0, 0);
+    if (!surface) {
+        fprintf(stderr, "Can't create a %dx%d surface.\n", job->width, job->height);
+        return false;
+    }
+    double scale[ORB_MAX_CHANNELS];
+    for (int ch = 0; ch < job->channelc; ch++) {
+        double max = 0;
+        const double* h = job->total + ch * job->pixelc;
+        for (size_t i = 0; i < job->pixelc; i++) {
+            max = (h[i] > max) ? h[i] : max;
+        }
+        scale[ch] = (max > 0) ? 1 / max : 0;
+    }
+    for (int y = 0; y < job->height; y++) {
+        uint32_t* pixels = (uint32_t*)((uint8_t*)surface->pixels + y * surface->pitch);
+        for (int x = 0; x < job->width; x++) {
+            size_t p = (size_t)y * job->width + x;
+            uint8_t c[ORB_MAX_CHANNELS] = {0};
+            for (int ch = 0; ch < job->channelc; ch++) {
+                c[ch] = (uint8_t)(sqrt(job->total[ch * job->pixelc + p] * scale[ch]) * 0xff);
+            }
+            if (job->channelc == 1) {
+                c[1] = c[2] = c[0];
+            }
+            pixels[x] = SDL_MapRGB(surface->format, c[0], c[1], c[2]);
+        }
+    }
+    bool ok = png_write_surface_mt(surface, output);
+    SDL_FreeSurface(surface);
+    return ok;
+}
+
+bool orbits_render(struct fractal_info fi, int width, int height, int millions,
+        const char* output) {
+    struct orbits_job job = {0};
+    job.fi = fi;
+    job.width = width;
+    job.height = height;
+    job.ox = fi.cx - fi.dpp * (width/2);
+    job.oy = fi.cy - fi.dpp * (height/2);
+    job.pixelc = (size_t)width * height;
+    if (fi.generator == GEN_NEBULABROT) {
+        job.channelc = 3;
+        job.limits[0] = fi.max_iter;
+        job.limits[1] = (fi.max_iter / 10 > 1) ? fi.max_iter / 10 : 1;
+        job.limits[2] = (fi.max_iter / 100 > 1) ? fi.max_iter / 100 : 1;
+    } else {
+        job.channelc = 1;
+        job.limits[0] = fi.max_iter;
+    }
+    double view = (width * fi.dpp) * (height * fi.dpp);
+    job.metropolis = view < ORB_METROPOLIS_AREA * (4 * ORB_RADIUS * ORB_RADIUS);
+    job.sigma = fi.dpp * ((width > height) ? width : height) * 0.1;
+    int workerc = rdr_sw_pool_size();
+    job.samples = (long long)millions * 1000000 / ORB_PASSES / workerc + 1;
+    job.shards = calloc(workerc, sizeof(float*));
+    job.rngs = calloc(workerc, sizeof(uint64_t));
+    job.chains = calloc(workerc, sizeof(struct orb_chain));
+    job.total = calloc(job.pixelc * job.channelc, sizeof(double));
+    bool ok = job.shards && job.rngs && job.chains && job.total;
+    for (int w = 0; ok && w < workerc; w++) {
+        job.shards[w] = calloc(job.pixelc * job.channelc, sizeof(float));
+        job.rngs[w] = 0x9E3779B97F4A7C15ULL * (w + 1);
+        ok = job.shards[w] != NULL;
+    }
+    if (!ok) {
+        fprintf(stderr, "Can't allocate %d %dx%d histograms.\n", workerc + 1, width, height);
+    }
+
+    struct timespec start, now;
+    clock_gettime(CLOCK_MONOTONIC, &start);
+    fprintf(stdout, "> orbits: %d million samples, %s sampling, %d workers\n", millions,
+            (job.metropolis) ? "metropolis-hastings" : "uniform", workerc);
+    for (job.pass = 0; ok && job.pass < ORB_PASSES; job.pass++) {
+        rdr_sw_run(orb_sample_worker, &job);
+        rdr_sw_run(orb_reduce_worker, &job);
+        ok = orb_write(&job, output);
+        clock_gettime(CLOCK_MONOTONIC, &now);
+        double elapsed = (now.tv_sec - start.tv_sec) + (now.tv_nsec - start.tv_nsec) * 1e-9;
+        double done = (double)(job.pass + 1) * job.samples * workerc;
+        fprintf(stdout, "> pass %d/%d: %.0lf samples in %.3lf s (%.2lf Msamples/s), preview `%s`\n",
+                job.pass + 1, ORB_PASSES, done, elapsed, done / elapsed * 1e-6, output);
+        fflush(stdout);
+    }
+
+    for (int w = 0; job.shards && w < workerc; w++) {
+        free(job.shards[w]);
+    }
+    free(job.shards);
+    free(job.rngs);
+    free(job.chains);
+    free(job.total);
+    return ok;
+}
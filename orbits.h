@@ -0,0 +1,20 @@
+#ifndef _H_ORBITS_
+#define _H_ORBITS_
+
+#include <stdbool.h>
+
+#include "types.h"
+
+/** orbits_render renders the orbit density of the width x height view of fi
+ ** (GEN_BUDDHABROT or GEN_NEBULABROT) to the PNG file output, sampling
+ ** millions of points c with the software renderer pool (see
+ ** rdr_sw_pool_init). The orbits of escaping points are accumulated in
+ ** per-worker histograms merged after each pass; output is rewritten after
+ ** each pass as a preview. Zoomed views are sampled with Metropolis-Hastings.
+ ** Nebulabrot channels are the orbits escaping within max_iter (red),
+ ** max_iter / 10 (green) and max_iter / 100 (blue) iterations.
+ ** Returns false on error. */
+bool orbits_render(struct fractal_info fi, int width, int height, int millions,
+        const char* output);
+
+#endif
@@ -0,0 +1,370 @@
+#include "png.h"
+
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <zlib.h>
+
+#include "renderer_software.h"
+
+static const uint8_t png_signature[8] = { 0x89, 'P', 'N', 'G', '\r', '\n', 0x1a, '\n' };
+
+static void png_put_u32(uint8_t* dest, uint32_t val) {
+    dest[0] = (uint8_t)(val >> 24);
+    dest[1] = (uint8_t)(val >> 16);
+    dest[2] = (uint8_t)(val >> 8);
+    dest[3] = (uint8_t)(val);
+}
+
+/** png_put_chunk writes a chunk of type (4 chars) with len bytes of data to
+ ** dest, which must hold len + 12 bytes. Returns the chunk size. */
+static size_t png_put_chunk(uint8_t* dest, const char* type, const uint8_t* data, size_t len) {
+    png_put_u32(dest, (uint32_t)len);
+    memcpy(dest + 4, type, 4);
+    if (len) {
+        memmove(dest + 8, data, len);
+    }
+    uLong crc = crc32(0L, Z_NULL, 0);
+    crc = crc32(crc, dest + 4, (uInt)(len + 4));
+    png_put_u32(dest + 8 + len, (uint32_t)crc);
+    return len + 12;
+}
+
+bool png_encode_surface(SDL_Surface* surface, uint8_t** data, size_t* len) {
+    int width = surface->w;
+    int height = surface->h;
+    /* Raw image: each row is a filter type byte (none) followed by RGB pixels. */
+    size_t stride = 1 + 3 * (size_t)width;
+    size_t raw_len = stride * height;
+    uint8_t* raw = malloc(raw_len);
+    /* Image: signature, IHDR chunk, IDAT chunk, IEND chunk. */
+    uLongf idat_len = compressBound(raw_len);
+    size_t png_max = sizeof(png_signature) + (12 + 13) + (12 + idat_len) + 12;
+    uint8_t* png = malloc(png_max);
+    if (!raw || !png) {
+        free(raw);
+        free(png);
+        fprintf(stderr, "Can't allocate PNG buffers.\n");
+        return false;
+    }
+    uint8_t* idat = png + sizeof(png_signature) + (12 + 13) + 8;
+    for (int y = 0; y < height; y++) {
+        uint8_t* row = raw + y * stride;
+        uint32_t* pixels = (uint32_t*)((uint8_t*)surface->pixels + y * surface->pitch);
+        *(row++) = 0;
+        for (int x = 0; x < width; x++) {
+            SDL_GetRGB(pixels[x], surface->format, row, row + 1, row + 2);
+            row += 3;
+        }
+    }
+    if (compress2(idat, &idat_len, raw, raw_len, Z_DEFAULT_COMPRESSION) != Z_OK) {
+        free(raw);
+        free(png);
+        fprintf(stderr, "Can't compress PNG image.\n");
+        return false;
+    }
+    free(raw);
+    /* Header: size, bit depth 8, color type 2 (RGB), deflate, no interlace. */
+    uint8_t ihdr[13] = {0};
+    png_put_u32(ihdr, (uint32_t)width);
+    png_put_u32(ihdr + 4, (uint32_t)height);
+    ihdr[8] = 8;
+    ihdr[9] = 2;
+    size_t pos = 0;
+    memcpy(png, png_signature, sizeof(png_signature));
+    pos += sizeof(png_signature);
+    pos += png_put_chunk(png + pos, "IHDR", ihdr, sizeof(ihdr));
+    pos += png_put_chunk(png + pos, "IDAT", idat, idat_len);
+    pos += png_put_chunk(png + pos, "IEND", NULL, 0);
+    *data = png;
+    *len = pos;
+    return true;
+}
+
+bool png_write_surface(SDL_Surface* surface, const char* filename) {
+    uint8_t* png = NULL;
+    size_t len = 0;
+    if (!png_encode_surface(surface, &png, &len)) {
+        return false;
+    }
+    FILE* fp = fopen(filename, "wb");
+    if (!fp) {
+        free(png);
+        fprintf(stderr, "Can't open `%s`.\n", filename);
+        return false;
+    }
+    bool ok = fwrite(png, 1, len, fp) == len;
+    free(png);
+    if (fclose(fp) != 0 || !ok) {
+        fprintf(stderr, "Can't write `%s`.\n", filename);
+        return false;
+    }
+    return true;
+}
+
+/** PNG_BAND_BYTES is the size of the filtered rows of the bands deflated by
+ ** each worker: bands are independent deflate streams, byte aligned by a sync
+ ** flush & concatenated. */
+#define PNG_BAND_BYTES (256 * 1024)
+/** PNG_PAD is the zero padding around filter rows: the left neighbours of the
+ ** first pixel are 0, vectors may run past the last one. */
+#define PNG_PAD 16
+
+/** PNG_FILTER_GAIN is the cost ratio switching filters between rows. */
+#define PNG_FILTER_GAIN 0.8
+
+/** png_v16u is a vector of 16 bytes (gcc vector extensions). */
+typedef uint8_t png_v16u __attribute__((vector_size(16)));
+
+static inline png_v16u png_load(const uint8_t* p) {
+    png_v16u v;
+    memcpy(&v, p, sizeof(v));
+    return v;
+}
+
+static inline void png_store(uint8_t* p, png_v16u v) {
+    memcpy(p, &v, sizeof(v));
+}
+
+/** png_filter is the output of a filter type on a row. */
+struct png_filter {
+    uint8_t* row; // PNG_PAD bytes of padding before & after.
+    uint64_t cost;
+};
+
+/** png_band is the deflated output of the rows [y0, y1) of the image; bands
+ ** belong to a worker and are reused by the bands it deflates. */
+struct png_band {
+    int y0, y1;
+    uint8_t* raw;  // filtered rows.
+    uint8_t* out;  // deflated rows, zlib header first for the first band.
+    size_t raw_cap, out_cap;
+    size_t len;    // of out.
+    uLong adler;   // of raw.
+    uLong crc;     // of the IDAT chunk of out.
+    uint8_t* rows; // current & previous RGB rows, then 4 filtered rows.
+    size_t row_cap;
+    bool ok;
+};
+
+/** png_job is a pass of the workers over the next bands of the image. */
+struct png_job {
+    SDL_Surface* surface;
+    int band_rows;
+    int first;  // band of worker 0.
+    int bandc;  // bands of the image.
+    struct png_band* bands;
+};
+
+/** png_get_rgb writes the RGB bytes of row y of surface to rgb. */
+static void png_get_rgb(SDL_Surface* surface, int y, uint8_t* rgb) {
+    uint32_t* pixels = (uint32_t*)((uint8_t*)surface->pixels + y * surface->pitch);
+    SDL_PixelFormat* f = surface->format;
+    if (f->BytesPerPixel == 4 && f->Rmask == 0xff0000 && f->Gmask == 0xff00 && f->Bmask == 0xff) {
+        for (int x = 0; x < surface->w; x++) {
+            rgb[3 * x]     = (uint8_t)(pixels[x] >> 16);
+            rgb[3 * x + 1] = (uint8_t)(pixels[x] >> 8);
+            rgb[3 * x + 2] = (uint8_t)(pixels[x]);
+        }
+        return;
+    }
+    for (int x = 0; x < surface->w; x++) {
+        SDL_GetRGB(pixels[x], f, rgb + 3 * x, rgb + 3 * x + 1, rgb + 3 * x + 2);
+    }
+}
+
+/** png_filter_cost returns the runs of equal pixels of the n bytes of the
+ ** filtered row: fractals are flat areas that deflate matches across rows,
+ ** which the usual sum of the bytes as signed ones underrates. */
+static uint64_t png_filter_cost(const uint8_t* row, size_t n) {
+    uint64_t cost = 0;
+    for (size_t i = 3; i < n; i++) {
+        cost += row[i] != row[i - 3];
+    }
+    return cost;
+}
+
+/** png_filter_row filters the n bytes of the RGB row cur, whose previous row
+ ** is prev, with the none, sub, up & average filters, 16 bytes at a time,
+ ** to filters. Returns the filter type of the cheapest, keeping the type
+ ** last of the previous row unless PNG_FILTER_GAIN cheaper. */
+static int png_filter_row(const uint8_t* cur, const uint8_t* prev, size_t n,
+        struct png_filter filters[4], int last) {
+    for (size_t i = 0; i < n; i += sizeof(png_v16u)) {
+        png_v16u c = png_load(cur + i);
+        png_v16u a = png_load(cur + i - 3); // left pixel.
+        png_v16u b = png_load(prev + i);    // up pixel.
+        png_store(filters[0].row + i, c);
+        png_store(filters[1].row + i, c - a);
+        png_store(filters[2].row + i, c - b);
+        /* floor((a + b) / 2) without overflow. */
+        png_store(filters[3].row + i, c - ((a & b) + ((a ^ b) >> 1)));
+    }
+    for (int k = 0; k < 4; k++) {
+        filters[k].cost = png_filter_cost(filters[k].row, n);
+    }
+    int best = last;
+    for (int k = 0; k < 4; k++) {
+        if (filters[k].cost < filters[best].cost * PNG_FILTER_GAIN) {
+            best = k;
+        }
+    }
+    return best;
+}
+
+/** png_deflate_band filters & deflates the rows of band; last ends the
+ ** deflate stream, other bands are flushed to a byte boundary. */
+static bool png_deflate_band(SDL_Surface* surface, struct png_band* band, bool last) {
+    size_t n = 3 * (size_t)surface->w;
+    size_t stride = 1 + n;
+    size_t raw_len = stride * (band->y1 - band->y0);
+    /* Buffers. */
+    size_t row_size = PNG_PAD + ((n + 15) & ~(size_t)15) + PNG_PAD;
+    if (row_size * 6 > band->row_cap) {
+        free(band->rows);
+        band->row_cap = row_size * 6;
+        band->rows = malloc(band->row_cap);
+    }
+    if (raw_len > band->raw_cap) {
+        free(band->raw);
+        band->raw_cap = raw_len;
+        band->raw = malloc(band->raw_cap);
+    }
+    size_t out_cap = deflateBound(NULL, raw_len) + 64;
+    if (out_cap > band->out_cap) {
+        free(band->out);
+        band->out_cap = out_cap;
+        band->out = malloc(band->out_cap);
+    }
+    if (!band->rows || !band->raw || !band->out) {
+        return false;
+    }
+    memset(band->rows, 0, band->row_cap);
+    uint8_t* cur = band->rows + PNG_PAD;
+    uint8_t* prev = cur + row_size;
+    struct png_filter filters[4];
+    for (int k = 0; k < 4; k++) {
+        filters[k].row = cur + (2 + k) * row_size;
+    }
+    /* Filter. */
+    if (band->y0 > 0) {
+        png_get_rgb(surface, band->y0 - 1, prev);
+    }
+    uint8_t* raw = band->raw;
+    int type = 0;
+    for (int y = band->y0; y < band->y1; y++) {
+        png_get_rgb(surface, y, cur);
+        type = png_filter_row(cur, prev, n, filters, type);
+        *(raw++) = (uint8_t)type;
+        memcpy(raw, filters[type].row, n);
+        raw += n;
+        uint8_t* tmp = prev;
+        prev = cur;
+        cur = tmp;
+    }
+    band->adler = adler32(adler32(0L, Z_NULL, 0), band->raw, (uInt)raw_len);
+    /* Deflate. */
+    z_stream zs = {0};
+    if (deflateInit2(&zs, Z_DEFAULT_COMPRESSION, Z_DEFLATED, -15, 8, Z_DEFAULT_STRATEGY) != Z_OK) {
+        return false;
+    }
+    size_t header = 0;
+    if (band->y0 == 0) {
+        /* zlib header: deflate, 32K window, default level. */
+        band->out[0] = 0x78;
+        band->out[1] = 0x9c;
+        header = 2;
+    }
+    zs.next_in = band->raw;
+    zs.avail_in = (uInt)raw_len;
+    zs.next_out = band->out + header;
+    zs.avail_out = (uInt)(band->out_cap - header);
+    int s = deflate(&zs, (last) ? Z_FINISH : Z_SYNC_FLUSH);
+    bool ok = (last) ? s == Z_STREAM_END : (s == Z_OK && zs.avail_in == 0 && zs.avail_out > 0);
+    band->len = header + zs.total_out;
+    deflateEnd(&zs);
+    band->crc = crc32(crc32(0L, (const Bytef*)"IDAT", 4), band->out, (uInt)band->len);
+    return ok;
+}
+
+/** png_band_job deflates the band of worker workeri in the pass of job. */
+static void png_band_job(void* arg, int workeri, int workerc) {
+    struct png_job* job = (struct png_job*)arg;
+    struct png_band* band = &job->bands[workeri];
+    int b = job->first + workeri;
+    band->ok = true;
+    if (b >= job->bandc) {
+        band->y0 = band->y1 = 0;
+        return;
+    }
+    band->y0 = b * job->band_rows;
+    band->y1 = (b + 1) * job->band_rows;
+    band->y1 = (band->y1 < job->surface->h) ? band->y1 : job->surface->h;
+    band->ok = png_deflate_band(job->surface, band, b == job->bandc - 1);
+}
+
+/** png_fwrite_chunk writes a chunk of type with len bytes of data & crc (of
+ ** type & data) to fp. */
+static bool png_fwrite_chunk(FILE* fp, const char* type, const uint8_t* data, size_t len, uLong crc) {
+    uint8_t head[8], tail[4];
+    png_put_u32(head, (uint32_t)len);
+    memcpy(head + 4, type, 4);
+    png_put_u32(tail, (uint32_t)crc);
+    return fwrite(head, 1, 8, fp) == 8
+        && (len == 0 || fwrite(data, 1, len, fp) == len)
+        && fwrite(tail, 1, 4, fp) == 4;
+}
+
+bool png_write_surface_mt(SDL_Surface* surface, const char* filename) {
+    FILE* fp = fopen(filename, "wb");
+    if (!fp) {
+        fprintf(stderr, "Can't open `%s`.\n", filename);
+        return false;
+    }
+    int workerc = rdr_sw_pool_size();
+    size_t stride = 1 + 3 * (size_t)surface->w;
+    struct png_job job = {
+        .surface = surface,
+        .band_rows = (PNG_BAND_BYTES / stride > 0) ? PNG_BAND_BYTES / stride : 1,
+        .bands = calloc(workerc, sizeof(struct png_band)),
+    };
+    job.bandc = (surface->h + job.band_rows - 1) / job.band_rows;
+    /* Header: size, bit depth 8, color type 2 (RGB), deflate, no interlace. */
+    uint8_t ihdr[13] = {0};
+    png_put_u32(ihdr, (uint32_t)surface->w);
+    png_put_u32(ihdr + 4, (uint32_t)surface->h);
+    ihdr[8] = 8;
+    ihdr[9] = 2;
+    uLong crc = crc32(crc32(0L, (const Bytef*)"IHDR", 4), ihdr, sizeof(ihdr));
+    bool ok = job.bands && job.bandc > 0
+        && fwrite(png_signature, 1, sizeof(png_signature), fp) == sizeof(png_signature)
+        && png_fwrite_chunk(fp, "IHDR", ihdr, sizeof(ihdr), crc);
+    /* Image data: an IDAT chunk per band, then the Adler-32 of the rows. */
+    uLong adler = adler32(0L, Z_NULL, 0);
+    for (job.first = 0; ok && job.first < job.bandc; job.first += workerc) {
+        rdr_sw_run(png_band_job, &job);
+        for (int w = 0; ok && w < workerc && job.first + w < job.bandc; w++) {
+            struct png_band* band = &job.bands[w];
+            ok = band->ok && png_fwrite_chunk(fp, "IDAT", band->out, band->len, band->crc);
+            adler = adler32_combine(adler, band->adler, (z_off_t)(stride * (band->y1 - band->y0)));
+        }
+    }
+    if (ok) {
+        uint8_t trailer[4];
+        png_put_u32(trailer, (uint32_t)adler);
+        ok = png_fwrite_chunk(fp, "IDAT", trailer, 4, crc32(crc32(0L, (const Bytef*)"IDAT", 4), trailer, 4))
+            && png_fwrite_chunk(fp, "IEND", NULL, 0, crc32(0L, (const Bytef*)"IEND", 4));
+    }
+    for (int w = 0; job.bands && w < workerc; w++) {
+        free(job.bands[w].raw);
+        free(job.bands[w].out);
+        free(job.bands[w].rows);
+    }
+    free(job.bands);
+    if (fclose(fp) != 0 || !ok) {
+        fprintf(stderr, "Can't write `%s`.\n", filename);
+        return false;
+    }
+    return true;
+}
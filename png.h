@@ -0,0 +1,21 @@
+#ifndef _H_PNG_
+#define _H_PNG_
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <SDL2/SDL.h>
+
+/** png_encode_surface encodes surface as a 8-bit RGB PNG image to *data.
+ ** Returns false on error. Caller is responsible for calling free on *data. */
+bool png_encode_surface(SDL_Surface* surface, uint8_t** data, size_t* len);
+/** png_write_surface writes surface to filename as a 8-bit RGB PNG image.
+ ** Returns false on error. */
+bool png_write_surface(SDL_Surface* surface, const char* filename);
+/** png_write_surface_mt writes surface to filename like png_write_surface,
+ ** deflating bands of filtered rows on the workers of the software renderer
+ ** pool (see rdr_sw_pool_init) & streaming them as they are done. Must not be
+ ** called from jobs of the pool. Returns false on error. */
+bool png_write_surface_mt(SDL_Surface* surface, const char* filename);
+
+#endif
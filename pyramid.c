@@ -0,0 +1,153 @@
+#include "pyramid.h"
+
+#include <errno.h>
+#include <limits.h>
+#include <stdatomic.h>
+#include <stdio.h>
+#include <string.h>
+#include <sys/stat.h>
+#include <time.h>
+#include <unistd.h>
+
+#include "panic.h"
+#include "png.h"
+#include "renderer_software.h"
+
+struct pyramid_job {
+    struct pyramid pyr;
+    const char* dir;
+    bool resume;
+    long long tilec;
+    atomic_llong next;
+    atomic_llong rendered;
+    atomic_llong skipped;
+    atomic_llong failed;
+};
+
+/** pyramid_tile_at returns tile (z, x, y) at index k; levels are enumerated
+ ** from 0 and tiles of a level row by row. */
+static void pyramid_tile_at(long long k, int* z, long long* x, long long* y) {
+    int level = 0;
+    long long side = 1;
+    while (k >= side * side) {
+        k -= side * side;
+        side <<= 1;
+        level++;
+    }
+    *z = level;
+    *x = k % side;
+    *y = k / side;
+}
+
+/** make_dirs creates directory path and its parents (mkdir -p). */
+static bool make_dirs(const char* path) {
+    char buf[PATH_MAX];
+    if (snprintf(buf, sizeof(buf), "%s", path) >= (int)sizeof(buf)) {
+        return false;
+    }
+    for (char* p = buf + 1; *p; p++) {
+        if (*p == '/') {
+            *p = '\0';
+            if (mkdir(buf, 0755) != 0 && errno != EEXIST) {
+                return false;
+            }
+            *p = '/';
+        }
+    }
+    return mkdir(buf, 0755) == 0 || errno == EEXIST;
+}
+
+void pyramid_init(struct pyramid* pyr, struct fractal_info fi, int width, int height) {
+    pyr->fi = fi_at(fi, 0.0);
+    pyr->side = ((width > height) ? width : height) * fi.dpp;
+    pyr->ox = fi.cx - pyr->side / 2;
+    pyr->oy = fi.cy - pyr->side / 2;
+}
+
+void pyramid_render_tile(struct pyramid* pyr, SDL_Surface* tile, int z, long long x, long long y) {
+    /* Pixel lattice of level z: a power of 2 division, so tile edges are exact. */
+    struct fractal_info fi = pyr->fi;
+    fi.dpp = pyr->side / ((double)PYRAMID_TILE_SIZE * (double)(1LL << z));
+    rdr_sw_render_lattice(tile, fi, pyr->ox, pyr->oy,
+            x * PYRAMID_TILE_SIZE, y * PYRAMID_TILE_SIZE);
+}
+
+/** pyramid_worker renders tiles until all tiles of the pyramid are taken. */
+static void pyramid_worker(void* arg, int workeri, int workerc) {
+    (void)workeri;
+    (void)workerc;
+    struct pyramid_job* job = arg;
+    SDL_Surface* tile = NULL;
+    char dir[PATH_MAX];
+    char path[PATH_MAX];
+    char tmp[PATH_MAX];
+    long long k;
+    while ((k = atomic_fetch_add(&job->next, 1)) < job->tilec) {
+        int z;
+        long long x, y;
+        pyramid_tile_at(k, &z, &x, &y);
+        if (snprintf(dir, sizeof(dir), "%s/%d/%lld", job->dir, z, x) >= (int)sizeof(dir)
+                || snprintf(path, sizeof(path), "%s/%lld.png", dir, y) >= (int)sizeof(path)
+                || snprintf(tmp, sizeof(tmp), "%s/%lld.png.tmp", dir, y) >= (int)sizeof(tmp)) {
+            fprintf(stderr, "Tile path is too long in `%s`.\n", job->dir);
+            atomic_fetch_add(&job->failed, 1);
+            continue;
+        }
+        if (job->resume && access(path, F_OK) == 0) {
+            atomic_fetch_add(&job->skipped, 1);
+            continue;
+        }
+        if (!tile) {
+            tile = SDL_CreateRGBSurface(0, PYRAMID_TILE_SIZE, PYRAMID_TILE_SIZE, 32, 0, 0, 0, 0);
+            if (!tile) {
+                panic("Error: SDL can't create a surface.");
+            }
+        }
+        pyramid_render_tile(&job->pyr, tile, z, x, y);
+        /* Write then rename, so interrupted runs don't leave partial tiles. */
+        if (make_dirs(dir) && png_write_surface(tile, tmp) && rename(tmp, path) == 0) {
+            atomic_fetch_add(&job->rendered, 1);
+        } else {
+            fprintf(stderr, "Can't write tile `%s`.\n", path);
+            atomic_fetch_add(&job->failed, 1);
+        }
+        if ((k + 1) % 256 == 0) {
+            fprintf(stdout, "> %lld/%lld tiles\n", k + 1, job->tilec);
+        }
+    }
+    if (tile) {
+        SDL_FreeSurface(tile);
+    }
+}
+
+bool pyramid_render(struct fractal_info fi, int width, int height, int levels,
+        const char* dir, bool resume) {
+    if (levels < 0 || levels > 24) {
+        fprintf(stderr, "Pyramid levels must be in [0, 24].\n");
+        return false;
+    }
+    struct pyramid_job job = {0};
+    pyramid_init(&job.pyr, fi, width, height);
+    job.dir = dir;
+    job.resume = resume;
+    job.tilec = 0;
+    for (int z = 0; z <= levels; z++) {
+        job.tilec += (1LL << z) * (1LL << z);
+    }
+    atomic_init(&job.next, 0);
+    atomic_init(&job.rendered, 0);
+    atomic_init(&job.skipped, 0);
+    atomic_init(&job.failed, 0);
+
+    struct timespec start, end;
+    clock_gettime(CLOCK_MONOTONIC, &start);
+    rdr_sw_run(pyramid_worker, &job);
+    clock_gettime(CLOCK_MONOTONIC, &end);
+
+    double elapsed = (end.tv_sec - start.tv_sec) + (end.tv_nsec - start.tv_nsec) * 1e-9;
+    long long rendered = atomic_load(&job.rendered);
+    fprintf(stdout, "> pyramid `%s`: %lld tiles rendered, %lld skipped, %lld failed in %.2lf s (%.1lf tiles/s)\n",
+            dir, rendered, atomic_load(&job.skipped), atomic_load(&job.failed),
+            elapsed, (elapsed > 0) ? rendered / elapsed : 0.0);
+    return atomic_load(&job.failed) == 0;
+}
@@ -0,0 +1,36 @@
+#ifndef _H_PYRAMID_
+#define _H_PYRAMID_
+
+#include <stdbool.h>
+
+#include "types.h"
+
+/** PYRAMID_TILE_SIZE is the width and height in pixels of a pyramid tile. */
+#define PYRAMID_TILE_SIZE 256
+
+/** pyramid is the geometry of a tile pyramid. */
+struct pyramid {
+    struct fractal_info fi;
+    /** ox, oy is the top left corner of the pyramid in local coords. */
+    double ox, oy;
+    /** side is the size of the pyramid in local coords. */
+    double side;
+};
+
+/** pyramid_init sets the geometry of the pyramid of fi (see pyramid_render). */
+void pyramid_init(struct pyramid* pyr, struct fractal_info fi, int width, int height);
+/** pyramid_render_tile renders tile (z, x, y) of pyr to tile on the calling
+ ** thread; tile must be PYRAMID_TILE_SIZE pixels wide & high. */
+void pyramid_render_tile(struct pyramid* pyr, SDL_Surface* tile, int z, long long x, long long y);
+
+/** pyramid_render renders levels 0 to levels of the tile pyramid of fi to
+ ** dir/z/x/y.png, one tile per worker of the software renderer pool at a time
+ ** (see rdr_sw_pool_init).
+ ** Level 0 is a single tile covering the square of side max(width, height)
+ ** pixels centered on the view of fi; each level splits the tiles in 4.
+ ** Tiles already on disk are skipped if resume is set.
+ ** Returns false if a tile can't be written. */
+bool pyramid_render(struct fractal_info fi, int width, int height, int levels,
+        const char* dir, bool resume);
+
+#endif
@@ -0,0 +1,319 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+#include "compute.h"
+#include "iterfile.h"
+#include "libfractal.h"
+#include "panic.h"
+#include "renderer_software.h"
+
+#define BENCHMARK_IMPL
+#include "benchmark.h"
+
+/* Golden views are small: the matrix must run in seconds. */
+#define REG_WIDTH 160
+#define REG_HEIGHT 120
+/* Timed views are larger: a render of a golden view is sub-millisecond. */
+#define REG_PERF_WIDTH 320
+#define REG_PERF_HEIGHT 240
+/** REG_DIR holds the golden iteration files & the per host baselines. */
+#define REG_DIR "regression"
+/** REG_TOLERANCE is the share of pixels, in per mille, the vectorized & float
+ ** paths may differ by from the scalar golden data. */
+#define REG_TOLERANCE 10
+/** REG_THRESHOLD is the slowdown, in percent of the baseline, that fails a
+ ** case. */
+#ifndef REG_THRESHOLD
+#define REG_THRESHOLD 10
+#endif
+/** REG_RUNS & REG_MIN_MS are the least number of timed renders of a case &
+ ** their least total time; the median counts. REG_MAX_RUNS bounds them. */
+#ifndef REG_RUNS
+#define REG_RUNS 5
+#endif
+#define REG_MIN_MS 250.0
+#define REG_MAX_RUNS 1000
+
+/** reg_case is a view of the matrix, rendered at time t. */
+struct reg_case {
+    const char* name;
+    struct fractal_info fi;
+    double t;
+};
+
+static const struct reg_case reg_cases[] = {
+    {"mandelbrot", {.generator = GEN_MANDELBROT, .max_iter = 50,
+        .cx = -0.7, .dpp = 0.0175}, 0.0},
+    {"seahorse", {.generator = GEN_MANDELBROT, .max_iter = 500,
+        .cx = -0.745, .cy = 0.105, .dpp = 1e-5}, 0.0},
+    {"deep", {.generator = GEN_MANDELBROT, .max_iter = 2000,
+        .cx = -0.743643887037151, .cy = 0.131825904205330, .dpp = 1e-10}, 0.0},
+    {"julia", {.generator = GEN_JULIA, .max_iter = 80,
+        .dpp = 0.02125, .jx = -0.8, .jy = 0.156}, 0.0},
+    {"julia_multiset2", {.generator = GEN_JULIA_MULTISET, .dynamic = true, .speed = 1.0,
+        .max_iter = 50, .dpp = 0.02125, .jx = 0.7885, .jy = 0.7885, .n = 2}, 0.7},
+    {"julia_multiset3", {.generator = GEN_JULIA_MULTISET, .dynamic = true, .speed = 1.0,
+        .max_iter = 50, .dpp = 0.02125, .jx = 0.7885, .jy = 0.7885, .n = 3}, 2.0},
+};
+#define REG_CASES (sizeof(reg_cases) / sizeof(reg_cases[0]))
+
+/** reg_scalar computes the iterations of c pixel by pixel with the generator
+ ** functions: the reference of the other paths. */
+static void reg_scalar(const struct reg_case* c, int32_t* iters) {
+    struct fractal_info fi = fi_at(c->fi, c->t);
+    fractal_generator gen = compute_generator(fi.generator);
+    for (int y = 0; y < REG_HEIGHT; y++) {
+        double iy = fi.cy + fi.dpp * (y - REG_HEIGHT/2);
+        for (int x = 0; x < REG_WIDTH; x++) {
+            *(iters++) = gen(fi.cx + fi.dpp * (x - REG_WIDTH/2), iy,
+                    fi.jx, fi.jy, fi.n, fi.max_iter);
+        }
+    }
+}
+
+/** reg_golden_path returns the golden iteration file of c (to free). */
+static char* reg_golden_path(const struct reg_case* c) {
+    char* path = malloc(strlen(c->name) + sizeof(REG_DIR "/.iters"));
+    sprintf(path, REG_DIR "/%s.iters", c->name);
+    return path;
+}
+
+/** reg_golden_read reads the golden iterations of c to iters. Returns false
+ ** if they are missing, of another view or corrupted. */
+static bool reg_golden_read(const struct reg_case* c, int32_t* iters) {
+    char* path = reg_golden_path(c);
+    struct iterfile itf;
+    bool opened = iterfile_open(path, &itf);
+    bool ok = opened;
+    if (ok && (itf.width != REG_WIDTH || itf.height != REG_HEIGHT
+            || !fi_equal(itf.fi, c->fi) || itf.t != c->t)) {
+        fprintf(stderr, "Golden file `%s` is not of this view.\n", path);
+        ok = false;
+    }
+    int32_t tile[ITERFILE_TILE_SIZE * ITERFILE_TILE_SIZE];
+    for (int ty = 0; ok && ty < itf.tiles_y; ty++) {
+        for (int tx = 0; ok && tx < itf.tiles_x; tx++) {
+            if (!iterfile_read_tile(&itf, tx, ty, tile)) {
+                fprintf(stderr, "Can't read golden file `%s`.\n", path);
+                ok = false;
+                break;
+            }
+            int x0 = tx * ITERFILE_TILE_SIZE, y0 = ty * ITERFILE_TILE_SIZE;
+            int w = (x0 + ITERFILE_TILE_SIZE < REG_WIDTH) ? ITERFILE_TILE_SIZE : REG_WIDTH - x0;
+            int h = (y0 + ITERFILE_TILE_SIZE < REG_HEIGHT) ? ITERFILE_TILE_SIZE : REG_HEIGHT - y0;
+            for (int y = 0; y < h; y++) {
+                memcpy(iters + (size_t)(y0 + y) * REG_WIDTH + x0, tile + y * w, w * sizeof(int32_t));
+            }
+        }
+    }
+    if (opened) {
+        iterfile_close(&itf);
+    }
+    free(path);
+    return ok;
+}
+
+/** reg_diff returns the number of pixels iters differs from golden by. */
+static int reg_diff(const int32_t* golden, const int32_t* iters) {
+    int diff = 0;
+    for (int p = 0; p < REG_WIDTH * REG_HEIGHT; p++) {
+        diff += golden[p] != iters[p];
+    }
+    return diff;
+}
+
+/** reg_check prints the result of path of c: at most tolerance per mille of
+ ** the pixels may differ. Returns false on failure. */
+static bool reg_check(const struct reg_case* c, const char* path, int diff, int tolerance) {
+    bool ok = diff * 1000 <= tolerance * REG_WIDTH * REG_HEIGHT;
+    fprintf(stdout, "> %-16s %-8s %s (%d pixels differ)\n", c->name, path, ok ? "ok" : "FAILED", diff);
+    return ok;
+}
+
+/** reg_correctness compares the paths of c to its golden data: the scalar
+ ** path exactly, the vectorized, pooled & workers paths within
+ ** REG_TOLERANCE. Returns false on failure. */
+static bool reg_correctness(const struct reg_case* c, struct lf_ctx* ctx, SDL_Surface* buf) {
+    size_t count = REG_WIDTH * REG_HEIGHT;
+    int32_t* golden = malloc(count * sizeof(int32_t));
+    int32_t* iters = malloc(count * sizeof(int32_t));
+    if (!golden || !iters) {
+        panic("Error: can't allocate iteration buffers.");
+    }
+    bool ok = reg_golden_read(c, golden);
+    if (ok) {
+        struct fractal_info fi = fi_at(c->fi, c->t);
+        reg_scalar(c, iters);
+        ok &= reg_check(c, "scalar", reg_diff(golden, iters), 0);
+        compute_iters(iters, fi, REG_WIDTH, REG_HEIGHT, 0, 0, REG_WIDTH, REG_HEIGHT);
+        ok &= reg_check(c, "simd", reg_diff(golden, iters), REG_TOLERANCE);
+        lf_render_iters(ctx, c->fi, c->t, iters, REG_WIDTH, REG_HEIGHT);
+        ok &= reg_check(c, "pool", reg_diff(golden, iters), REG_TOLERANCE);
+        /* Colors: distinct counts may share a gray level, not more. */
+        rdr_sw_render_buffer(buf, c->fi, c->t);
+        int diff = 0;
+        for (int y = 0; y < REG_HEIGHT; y++) {
+            uint32_t* row = (uint32_t*)((uint8_t*)buf->pixels + y * buf->pitch);
+            for (int x = 0; x < REG_WIDTH; x++) {
+                uint32_t color = rdr_sw_map_color(buf->format, golden[y * REG_WIDTH + x], fi.max_iter);
+                diff += (row[x] & 0xffffff) != (color & 0xffffff);
+            }
+        }
+        ok &= reg_check(c, "workers", diff, REG_TOLERANCE);
+    }
+    free(iters);
+    free(golden);
+    return ok;
+}
+
+static int cmp_double(const void* a, const void* b) {
+    double x = *(const double*)a, y = *(const double*)b;
+    return (x > y) - (x < y);
+}
+
+/** reg_time returns the median time of renders of c to buf, in ms: at least
+ ** REG_RUNS of them & REG_MIN_MS in total. */
+static double reg_time(const struct reg_case* c, SDL_Surface* buf) {
+    /* The view of c at the size of buf. */
+    struct fractal_info fi = c->fi;
+    fi.dpp *= (double)REG_WIDTH / buf->w;
+    double runs[REG_MAX_RUNS];
+    double total = 0.0;
+    int n = 0;
+    while (n < REG_MAX_RUNS && (n < REG_RUNS || total < REG_MIN_MS)) {
+        long long startt = benchmark_get_time_ns();
+        rdr_sw_render_buffer(buf, fi, c->t);
+        runs[n] = (double)(benchmark_get_time_ns() - startt) / 1e6;
+        total += runs[n++];
+    }
+    qsort(runs, n, sizeof(double), cmp_double);
+    return (n % 2) ? runs[n / 2] : 0.5 * (runs[n / 2 - 1] + runs[n / 2]);
+}
+
+/** reg_baseline_path returns the baseline file of this host (to free). */
+static char* reg_baseline_path(void) {
+    char host[256] = "localhost";
+    if (gethostname(host, sizeof(host)) != 0) {
+        strcpy(host, "localhost");
+    }
+    host[sizeof(host) - 1] = '\0';
+    char* path = malloc(strlen(host) + sizeof(REG_DIR "/baseline-.txt"));
+    sprintf(path, REG_DIR "/baseline-%s.txt", host);
+    return path;
+}
+
+/** reg_performance times the cases at the size of buf & compares them to the baseline of this
+ ** host, written first if missing or if save. Returns false if a case is
+ ** more than REG_THRESHOLD percent slower than its baseline. */
+static bool reg_performance(SDL_Surface* buf, bool save) {
+    double ms[REG_CASES];
+    for (size_t i = 0; i < REG_CASES; i++) {
+        rdr_sw_render_buffer(buf, reg_cases[i].fi, reg_cases[i].t); // warm up.
+        ms[i] = reg_time(&reg_cases[i], buf);
+    }
+    char* path = reg_baseline_path();
+    double baseline[REG_CASES] = {0};
+    FILE* fp = (save) ? NULL : fopen(path, "r");
+    char line[256];
+    while (fp && fgets(line, sizeof(line), fp)) {
+        char name[64];
+        double v;
+        if (sscanf(line, "%63s %lf", name, &v) != 2) {
+            continue;
+        }
+        for (size_t i = 0; i < REG_CASES; i++) {
+            if (strcmp(name, reg_cases[i].name) == 0) {
+                baseline[i] = v;
+            }
+        }
+    }
+    if (fp) {
+        fclose(fp);
+    } else {
+        fp = fopen(path, "w");
+        if (!fp) {
+            fprintf(stderr, "Can't write baseline file `%s`.\n", path);
+        }
+        for (size_t i = 0; fp && i < REG_CASES; i++) {
+            fprintf(fp, "%s %.3lf\n", reg_cases[i].name, ms[i]);
+            baseline[i] = ms[i];
+        }
+        if (fp) {
+            fclose(fp);
+            fprintf(stdout, "> Baseline saved to `%s`.\n", path);
+        }
+    }
+    bool ok = true;
+    for (size_t i = 0; i < REG_CASES; i++) {
+        if (baseline[i] <= 0.0) {
+            fprintf(stdout, "> %-16s %7.3lf ms, no baseline\n", reg_cases[i].name, ms[i]);
+            continue;
+        }
+        double change = (ms[i] / baseline[i] - 1.0) * 100.0;
+        bool slow = change > REG_THRESHOLD;
+        fprintf(stdout, "> %-16s %7.3lf ms, baseline %7.3lf ms (%+.1lf%%) %s\n", reg_cases[i].name,
+                ms[i], baseline[i], change, slow ? "FAILED" : "ok");
+        ok &= !slow;
+    }
+    free(path);
+    return ok;
+}
+
+/** reg_save_golden renders the golden data of the cases with the scalar
+ ** path. Returns false on error. */
+static bool reg_save_golden(void) {
+    int32_t* iters = malloc(REG_WIDTH * REG_HEIGHT * sizeof(int32_t));
+    if (!iters) {
+        panic("Error: can't allocate iteration buffers.");
+    }
+    bool ok = true;
+    for (size_t i = 0; i < REG_CASES; i++) {
+        reg_scalar(&reg_cases[i], iters);
+        char* path = reg_golden_path(&reg_cases[i]);
+        if (iterfile_write(reg_cases[i].fi, REG_WIDTH, REG_HEIGHT, reg_cases[i].t, iters, path)) {
+            fprintf(stdout, "> Golden data saved to `%s`.\n", path);
+        } else {
+            ok = false;
+        }
+        free(path);
+    }
+    free(iters);
+    return ok;
+}
+
+/* Usage: regression [golden|baseline]; golden rewrites the golden data,
+ * baseline the timings of this host, before checking them. */
+int main(int argc, char* argv[])
+{
+    bool golden = argc > 1 && strcmp(argv[1], "golden") == 0;
+    bool baseline = argc > 1 && strcmp(argv[1], "baseline") == 0;
+    rdr_sw_pool_init();
+    /* libfractal renders on the workers of the software renderer. */
+    struct lf_ctx* ctx = lf_ctx_open(rdr_sw_pool_get());
+    SDL_Surface* buf = SDL_CreateRGBSurface(0, REG_WIDTH, REG_HEIGHT, 32, 0, 0, 0, 0);
+    if (!buf) {
+        panic("Error: SDL can't create a surface.");
+    }
+
+    bool ok = !golden || reg_save_golden();
+    fprintf(stdout, "Correctness (%dx%d, tolerance %d per mille):\n", REG_WIDTH, REG_HEIGHT, REG_TOLERANCE);
+    for (size_t i = 0; i < REG_CASES; i++) {
+        ok &= reg_correctness(&reg_cases[i], ctx, buf);
+    }
+    SDL_Surface* perf = SDL_CreateRGBSurface(0, REG_PERF_WIDTH, REG_PERF_HEIGHT, 32, 0, 0, 0, 0);
+    if (!perf) {
+        panic("Error: SDL can't create a surface.");
+    }
+    fprintf(stdout, "Performance (%dx%d, median of %d+ runs & %.0lf+ ms, threshold %d%%):\n",
+            REG_PERF_WIDTH, REG_PERF_HEIGHT, REG_RUNS, REG_MIN_MS, REG_THRESHOLD);
+    ok &= reg_performance(perf, baseline);
+    fprintf(stdout, "%s\n", ok ? "Regression: ok." : "Regression: FAILED.");
+
+    SDL_FreeSurface(perf);
+    SDL_FreeSurface(buf);
+    lf_ctx_close(ctx);
+    rdr_sw_pool_free();
+    return (ok) ? EXIT_SUCCESS : EXIT_FAILURE;
+}
@@ -0,0 +1,31 @@
+regression_out:=$(build_dir)/regression
+
+# THRESHOLD sets the slowdown, in percent of the baseline, that fails a case.
+THRESHOLD?=10
+REG_CFLAGS:=-DREG_THRESHOLD=$(THRESHOLD)
+
+# Check the golden data & timings of this host (saved on first run).
+regression: regression_clean $(regression_out)
+	@./$(regression_out)
+
+# Rewrite the golden data from the scalar path, then check.
+regression-golden: regression_clean $(regression_out)
+	@./$(regression_out) golden
+
+# Rewrite the baseline of this host, then check.
+regression-baseline: regression_clean $(regression_out)
+	@./$(regression_out) baseline
+
+$(regression_out): $(build_dir)/regression.o $(objects_no_main)
+	@$(CC) $(LDFLAGS) $(LDLIBS) $^ -o $@
+
+$(build_dir)/regression.o: regression.c $$(@D)/.f
+	@$(CC) $(CFLAGS) $(REG_CFLAGS) -c -o $@ $<
+
+regression_clean:
+	@rm -f $(build_dir)/regression.o $(regression_out)
+
+clean:: regression_clean
+
+# List of all special targets (always out-of-date).
+.PHONY: regression regression-golden regression-baseline regression_clean
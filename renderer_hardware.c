@@ -146,7 +146,7 @@ void rdr_hw_resize(int width, int height) {
     glViewport(0, 0, width, height);
 }
 
-void rdr_hw_render(struct fractal_info fi, double t, double dt) {
+bool rdr_hw_render(struct fractal_info fi, double t, double dt) {
     fi.cy *= -1; // invert y coord to act like software renderer.
 
     int width, height;
@@ -201,4 +201,5 @@ void rdr_hw_render(struct fractal_info fi, double t, double dt) {
     glDrawArrays(GL_TRIANGLE_STRIP, 0, 6);
 
     SDL_GL_SwapWindow(lwindow);
+    return true;
 }
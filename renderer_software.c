@@ -2,424 +2,1656 @@
 
 #include <limits.h>
 #include <math.h>
+#include <stdatomic.h>
+#include <sys/mman.h>
+#include <time.h>
+#include <unistd.h>
 #include <SDL2/SDL.h>
 
+#include "compute.h"
+#include "config.h"
+#include "libfractal.h"
 #include "panic.h"
-#include "generator/julia.h"
-#include "generator/julia_multiset.h"
-#include "generator/mandelbrot.h"
+#include "tile_cache.h"
 
 #ifdef MT
 #include <pthread.h>
-#include <sys/sysinfo.h>
-#include <time.h>
 #endif
 
-#ifndef M_PI
-#define M_PI 3.14159265358979323846
-#define M_PI_2 1.57079632679489661923
-#endif
+/** rdr_sw_store is a buffer reused across resizes: its capacity grows
+ ** geometrically and only shrinks when freed (see rdr_sw_store_reserve). */
+struct rdr_sw_store {
+    void* mem;
+    size_t cap; // bytes.
+};
 
-typedef int (*fractal_generator)(double ix, double iy, double cx, double cy, int n, int max_iter);
+/** RDR_SW_STORES are the stores of the buffers of rdr_sw_render. */
+enum {
+    RDR_SW_STORE_BUFFER,
+    RDR_SW_STORE_TILED,
+#ifdef MT
+    RDR_SW_STORE_FRONT,
+    RDR_SW_STORE_FRONT_TILED,
+#endif
+    RDR_SW_STORES,
+};
 
 static struct {
     SDL_Renderer* renderer;
+    /** texture is tex_w x tex_h, at least the window size: frames are
+     ** uploaded & presented from its top left corner. */
     SDL_Texture* texture;
+    int tex_w, tex_h;
+    SDL_Rect shown; // area of texture of the last frame presented.
+    double resize_ms; // when the window was resized, 0 if texture was lost.
+    /** buffer & front are surfaces over the pixels of stores. */
+    struct rdr_sw_store stores[RDR_SW_STORES];
     SDL_Surface* buffer;
+    struct tile_cache* cache;
+    bool histogram; // histogram colouring.
+    bool vsync; // presents wait for the vertical sync.
+    struct rdr_sw_profile* profile; // see rdr_sw_profile_buffer.
+    /** tiled is the tile-major copy of buffer written by the area worker
+     ** (see rdr_sw_tiled_index), NULL unless RDR_SW_TILED_FRAMES; tiled_frame tells if it holds the last
+     ** frame posted rather than buffer. */
+    uint32_t* tiled;
+    bool tiled_frame;
+    /** view is a surface over the pixels of buffer at the size of the frames
+     ** of dynamic fractals, scale times the window (see rdr_sw_view). */
+    SDL_Surface* view;
+    int fps_target; // 0: frames at the size of the window.
+    double scale;
+    double frame_scale; // of the frame in flight or last rendered.
+    double frame_t;     // its time.
+    /** generation is bumped to abort the frame in flight. */
+    atomic_uint generation;
+#ifdef MT
+    /* Frame in flight or last rendered by rdr_sw_render. */
+    bool posted;   // workers are rendering it.
+    bool started;  // a frame was posted.
+    bool complete; // it was not aborted.
+    unsigned frame_gen;
+    struct fractal_info frame_fi;
+    double frame_start; // ms, when it was posted.
+    /** front is the last complete frame of dynamic fractals, presented while
+     ** the workers render the next one to buffer; buffers are swapped when
+     ** it completes. front_valid tells if it holds a frame of the view. */
+    SDL_Surface* front;
+    SDL_Surface* front_view;
+    uint32_t* front_tiled;
+    bool front_tiled_frame;
+    bool front_valid;
+    double latency; // ms from post to present of frames, moving average.
+#endif
 } fractal;
 
+/** worker takes a rdr_context* and returns NULL. */
+typedef void* (*worker)(void*);
+
+/** rdr_sw_hist_slot is the histogram of a worker; counts are zero between
+ ** frames, [lo, hi) bounds the non zero ones. Cache aligned: workers update
+ ** lo & hi per pixel. */
+struct rdr_sw_hist_slot {
+    uint32_t* counts;
+    int lo, hi;
+    uint64_t sum; // pixels of the slice of the worker after the merge.
+} __attribute__((aligned(64)));
+
+/** rdr_sw_hist is the state of histogram colouring shared by the workers. */
+struct rdr_sw_hist {
+    int32_t* iters;   // iteration count per pixel.
+    size_t pixels;    // size of iters.
+    uint32_t* lut;    // merged histogram, then color per iteration count.
+    int size;         // entries per histogram.
+    int slotc;
+    struct rdr_sw_hist_slot* slots; // one per worker.
+};
+
 /* Workers arguments */
 struct rdr_context {
     SDL_Surface* buf;
     struct fractal_info fi;
+    struct tile_cache* cache;
+    struct rdr_sw_hist* hist; // histogram colouring state, NULL otherwise.
+    struct rdr_sw_profile* profile; // cost recording, NULL otherwise.
+    uint32_t* tiled; // tile-major pixels replacing buf->pixels, or NULL.
+    rdr_sw_job job;
+    void* job_arg;
     int workeri; // worker index.
     int workerc; // worker count.
+    unsigned generation; // frame generation of the work order.
 #ifdef MT
-    bool done;
-    pthread_mutex_t* mutex_work;
-    pthread_cond_t* cond_work;
-    pthread_mutex_t* mutex_done;
-    pthread_cond_t* cond_done;
+    worker wk;   // work order.
+    pthread_barrier_t* barrier; // phases of rdr_sw_hist_worker.
+    double done_ms; // when the last work order was done.
 #endif
 };
 
+static struct rdr_sw_hist hist;
+
+/** RDR_SW_GENERATORS is the number of generators (see enum generator). */
+#define RDR_SW_GENERATORS (GEN_NEBULABROT + 1)
+
+/** rdr_sw_tuning is the worker & thread count rendering a generator,
+ ** chosen by rdr_sw_autotune; wk is NULL for the defaults. */
+struct rdr_sw_tuning {
+    worker wk;
+    size_t threads;
+};
+
+static struct rdr_sw_tuning tunings[RDR_SW_GENERATORS];
+
 /* Workers */
 #ifdef MT
-static pthread_t* workers;
+/** workers is the libfractal pool running the work orders, one band per
+ ** worker context: a single pool serves the window, the batch modes & the
+ ** libfractal contexts opened on it (see rdr_sw_pool_get). */
+static struct lf_pool* workers;
 static size_t workerc;
 static struct rdr_context* worker_ctx;
-static pthread_mutex_t worker_mutex_done;
-static pthread_cond_t worker_cond_done;
+static struct lf_job* worker_job; // work order in flight, or NULL.
+static pthread_barrier_t worker_barrier;
+static size_t worker_barrier_count;
+static worker worker_default;
 #endif
 
-/** worker takes a rdr_context* and returns NULL. */
-typedef void* (*worker)(void*);
-
 /* Workers */
 static void* rdr_sw_area_worker(void* arg);
 static void* rdr_sw_line_worker(void* arg);
+static void* rdr_sw_tile_worker(void* arg);
+static void* rdr_sw_job_worker(void* arg);
+static void* rdr_sw_hist_worker(void* arg);
+#ifdef MT
+static void rdr_sw_wait_mt(void);
+static void rdr_sw_abort_mt(void);
+#endif
+
+/** RDR_SW_TILE is the side of the tiles of tile-major buffers: a tile row
+ ** is a 64 bytes cache line. */
+#define RDR_SW_TILE 16
+
+/** RDR_SW_TILED_FRAMES tells if the area worker renders interactive frames
+ ** tile-major. Off unless built with RDR_SW_TILED: the swizzle on upload costs
+ ** more than it saves on one core at 4K (see benchmark_sw_area_worker_tiled). */
+#ifdef RDR_SW_TILED
+#define RDR_SW_TILED_FRAMES true
+#else
+#define RDR_SW_TILED_FRAMES false
+#endif
+
+/** rdr_sw_tiled_index returns the index of pixel (x, y) in a tile-major
+ ** buffer of width pixels: RDR_SW_TILE x RDR_SW_TILE tiles, row by row, each
+ ** stored row by row. */
+static inline size_t rdr_sw_tiled_index(int x, int y, int width) {
+    size_t tilesx = (width + RDR_SW_TILE - 1) / RDR_SW_TILE;
+    size_t row = ((y / RDR_SW_TILE) * tilesx * RDR_SW_TILE + y % RDR_SW_TILE) * RDR_SW_TILE;
+    return row + (x / RDR_SW_TILE) * RDR_SW_TILE * RDR_SW_TILE + x % RDR_SW_TILE;
+}
+
+/** rdr_sw_tiled_x returns the offset of pixel x from pixel 0 of its row in a
+ ** tile-major buffer. */
+static inline size_t rdr_sw_tiled_x(int x) {
+    return (size_t)(x / RDR_SW_TILE) * RDR_SW_TILE * RDR_SW_TILE + x % RDR_SW_TILE;
+}
+
+/** rdr_sw_tiled_size returns the bytes of a tile-major buffer of width x
+ ** height pixels. */
+static size_t rdr_sw_tiled_size(int width, int height) {
+    size_t tilesx = (width + RDR_SW_TILE - 1) / RDR_SW_TILE;
+    size_t tilesy = (height + RDR_SW_TILE - 1) / RDR_SW_TILE;
+    return tilesx * tilesy * RDR_SW_TILE * RDR_SW_TILE * sizeof(uint32_t);
+}
+
+/** rdr_sw_tiled_alloc returns a cache aligned tile-major buffer of width x
+ ** height pixels. */
+static uint32_t* rdr_sw_tiled_alloc(int width, int height) {
+    return aligned_alloc(64, rdr_sw_tiled_size(width, height));
+}
+
+/** RDR_SW_HUGE_PAGE is the size of transparent huge pages (x86-64, arm64
+ ** with 4 KiB pages). */
+#define RDR_SW_HUGE_PAGE (2 << 20)
+
+/** rdr_sw_huge_alloc returns size bytes, huge page aligned & backed when
+ ** size spans huge pages (transparent huge pages permitting), cache line
+ ** aligned otherwise; NULL on error. Frame buffers are walked in full every
+ ** frame: huge pages spare TLB misses. */
+static void* rdr_sw_huge_alloc(size_t size) {
+    if (size < RDR_SW_HUGE_PAGE) {
+        return aligned_alloc(64, (size + 63) / 64 * 64);
+    }
+    size = (size + RDR_SW_HUGE_PAGE - 1) / RDR_SW_HUGE_PAGE * RDR_SW_HUGE_PAGE;
+    void* mem = aligned_alloc(RDR_SW_HUGE_PAGE, size);
+#ifdef MADV_HUGEPAGE
+    if (mem) {
+        madvise(mem, size, MADV_HUGEPAGE);
+    }
+#endif
+    return mem;
+}
+
+/** rdr_sw_store_reserve returns the memory of st, of at least size bytes:
+ ** content is lost when it grows, to size or half its capacity more. */
+static void* rdr_sw_store_reserve(struct rdr_sw_store* st, size_t size) {
+    if (size > st->cap) {
+        size_t cap = st->cap + st->cap / 2;
+        cap = (cap > size) ? cap : size;
+        free(st->mem);
+        st->mem = rdr_sw_huge_alloc(cap);
+        st->cap = (st->mem) ? cap : 0;
+        if (!st->mem) {
+            panic("Error: can't allocate the frame buffers.");
+        }
+    }
+    return st->mem;
+}
+
+/** rdr_sw_store_free frees the memory of st. */
+static void rdr_sw_store_free(struct rdr_sw_store* st) {
+    free(st->mem);
+    *st = (struct rdr_sw_store){0};
+}
+
+/** rdr_sw_store_surface sets surf to a width x height surface over the
+ ** memory of st. */
+static void rdr_sw_store_surface(struct rdr_sw_store* st, SDL_Surface** surf, int width, int height) {
+    void* pixels = rdr_sw_store_reserve(st, (size_t)width * height * sizeof(uint32_t));
+    if (*surf) {
+        SDL_FreeSurface(*surf);
+    }
+    *surf = SDL_CreateRGBSurfaceFrom(pixels, width, height, 32, width * 4, 0, 0, 0, 0);
+    if (!*surf) {
+        panic("Error: SDL can't create a surface.");
+    }
+}
+
+/** rdr_sw_v4u is 4 pixels; rdr_sw_v4u_u may be unaligned. */
+typedef uint32_t rdr_sw_v4u __attribute__((vector_size(16)));
+typedef uint32_t rdr_sw_v4u_u __attribute__((vector_size(16), aligned(4)));
+
+/** rdr_sw_swizzle copies the tile-major buffer tiled of width x height
+ ** pixels to the row-major pixels of pitch bytes, a cache line at a time. */
+static void rdr_sw_swizzle(uint32_t* pixels, int pitch, const uint32_t* tiled, int width, int height) {
+    int tilesx = (width + RDR_SW_TILE - 1) / RDR_SW_TILE;
+    for (int y = 0; y < height; y++) {
+        uint32_t* dst = (uint32_t*)((uint8_t*)pixels + (size_t)y * pitch);
+        const uint32_t* src = tiled + rdr_sw_tiled_index(0, y, width);
+        int tx = 0;
+        for (; tx < width / RDR_SW_TILE; tx++) {
+            const rdr_sw_v4u* s = (const rdr_sw_v4u*)(src + (size_t)tx * RDR_SW_TILE * RDR_SW_TILE);
+            rdr_sw_v4u_u* d = (rdr_sw_v4u_u*)(dst + tx * RDR_SW_TILE);
+            d[0] = s[0];
+            d[1] = s[1];
+            d[2] = s[2];
+            d[3] = s[3];
+        }
+        if (tx < tilesx) {
+            memcpy(dst + tx * RDR_SW_TILE, src + (size_t)tx * RDR_SW_TILE * RDR_SW_TILE,
+                    (width - tx * RDR_SW_TILE) * sizeof(uint32_t));
+        }
+    }
+}
 
+/** rdr_sw_stale tells if the frame of ctx was aborted by a newer one;
+ ** workers check it between tiles. */
+static bool rdr_sw_stale(struct rdr_context* ctx) {
+    return atomic_load_explicit(&fractal.generation, memory_order_relaxed) != ctx->generation;
+}
+
+/** rdr_sw_get_worker returns the worker matching the renderer settings. */
+static worker rdr_sw_get_worker(void) {
+    if (fractal.histogram) {
+        return rdr_sw_hist_worker;
+    }
+    return (fractal.cache) ? rdr_sw_tile_worker : rdr_sw_area_worker;
+}
+
+/** rdr_sw_get_tuning returns the worker & thread count rendering fi. */
+static struct rdr_sw_tuning rdr_sw_get_tuning(struct fractal_info fi) {
+#ifdef MT
+    struct rdr_sw_tuning tuning = {worker_default, workerc};
+#else
+    struct rdr_sw_tuning tuning = {rdr_sw_get_worker(), 1};
+#endif
+    if (fi.generator < RDR_SW_GENERATORS && tunings[fi.generator].wk) {
+        tuning = tunings[fi.generator];
+    }
+    return tuning;
+}
+
+/** rdr_sw_barrier waits for all workers of the work order of ctx. */
+static void rdr_sw_barrier(struct rdr_context* ctx) {
 #ifdef MT
+    if (ctx->barrier) {
+        int s = pthread_barrier_wait(ctx->barrier);
+        if (s != 0 && s != PTHREAD_BARRIER_SERIAL_THREAD) panicen(s, "pthread_barrier_wait");
+    }
+#else
+    (void)ctx;
+#endif
+}
+
+/** rdr_sw_hist_reserve sizes hist for width x height frames of max_iter
+ ** with workerc workers. Workers must be idle. */
+static void rdr_sw_hist_reserve(int width, int height, int max_iter, int workerc) {
+    size_t pixels = (size_t)width * height;
+    if (pixels > hist.pixels) {
+        /* Grows like frame buffers (see rdr_sw_store_reserve). */
+        pixels = (hist.pixels + hist.pixels / 2 > pixels) ? hist.pixels + hist.pixels / 2 : pixels;
+        free(hist.iters);
+        hist.iters = rdr_sw_huge_alloc(pixels * sizeof(int32_t));
+        hist.pixels = pixels;
+    }
+    if (max_iter + 1 > hist.size || workerc != hist.slotc) {
+        for (int w = 0; w < hist.slotc; w++) {
+            free(hist.slots[w].counts);
+        }
+        free(hist.slots);
+        free(hist.lut);
+        hist.size = (max_iter + 1 > hist.size) ? max_iter + 1 : hist.size;
+        hist.slotc = workerc;
+        hist.slots = aligned_alloc(64, workerc * sizeof(struct rdr_sw_hist_slot));
+        for (int w = 0; w < workerc; w++) {
+            hist.slots[w].counts = calloc(hist.size, sizeof(uint32_t));
+            hist.slots[w].lo = 0;
+            hist.slots[w].hi = 0;
+        }
+        hist.lut = malloc(hist.size * sizeof(uint32_t));
+    }
+    if (!hist.iters || !hist.slots || !hist.lut) {
+        panic("Error: can't allocate histogram buffers.");
+    }
+}
+
+/** rdr_sw_hist_free frees the buffers of histogram colouring. */
+static void rdr_sw_hist_free(void) {
+    for (int w = 0; w < hist.slotc; w++) {
+        free(hist.slots[w].counts);
+    }
+    free(hist.slots);
+    free(hist.lut);
+    free(hist.iters);
+    hist = (struct rdr_sw_hist){0};
+}
+
+/** rdr_sw_hist_put stores the iteration count iter of pixel p & counts it in
+ ** the histogram of the worker of ctx; max_iter is not counted. */
+static inline void rdr_sw_hist_put(struct rdr_context* ctx, size_t p, int32_t iter) {
+    struct rdr_sw_hist_slot* slot = &ctx->hist->slots[ctx->workeri];
+    ctx->hist->iters[p] = iter;
+    if (iter < ctx->fi.max_iter) {
+        slot->counts[iter]++;
+        if (iter < slot->lo) slot->lo = iter;
+        if (iter >= slot->hi) slot->hi = iter + 1;
+    }
+}
+
+/** rdr_sw_now_ms returns the monotonic time in ms. */
+static double rdr_sw_now_ms(void) {
+    struct timespec tp;
+    clock_gettime(CLOCK_MONOTONIC, &tp);
+    return tp.tv_sec * 1e3 + tp.tv_nsec * 1e-6;
+}
+
+/** rdr_sw_tile_begin starts the profile of the w x h tile at (x, y). */
+static void rdr_sw_tile_begin(struct rdr_context* ctx, struct rdr_sw_tile_stat* tile,
+        int x, int y, int w, int h) {
+    if (!ctx->profile) {
+        return;
+    }
+    *tile = (struct rdr_sw_tile_stat){x, y, w, h, ctx->workeri, rdr_sw_now_ms(), 0, 0};
+}
+
+/** rdr_sw_tile_cost records the iterations of count pixels computed from
+ ** pixel p of the buffer to tile & to the cost of the pixels. */
+static void rdr_sw_tile_cost(struct rdr_context* ctx, struct rdr_sw_tile_stat* tile,
+        const int32_t* iters, size_t p, int count) {
+    if (!ctx->profile) {
+        return;
+    }
+    for (int i = 0; i < count; i++) {
+        ctx->profile->cost[p + i] = iters[i];
+        tile->iters += iters[i];
+    }
+    tile->pixels += count;
+}
+
+/** rdr_sw_tile_end stores the profile of tile. */
+static void rdr_sw_tile_end(struct rdr_context* ctx, struct rdr_sw_tile_stat* tile) {
+    struct rdr_sw_profile* prof = ctx->profile;
+    if (!prof) {
+        return;
+    }
+    tile->ms = rdr_sw_now_ms() - tile->ms;
+    int k = atomic_fetch_add(&prof->tilec, 1);
+    if (k < prof->tilecap) {
+        prof->tiles[k] = *tile;
+    }
+}
+
+#ifdef MT
+/** rdr_sw_thread runs the work order of worker context band on a worker of
+ ** the pool. */
+static void rdr_sw_thread(void* arg, int band, int bandc) {
+    (void)arg; (void)bandc;
+    struct rdr_context* ctx = &worker_ctx[band];
+    ctx->wk(ctx);
+    ctx->done_ms = rdr_sw_now_ms();
+}
+
+/** rdr_sw_threads_init opens a pool of one worker per processor;
+ ** wk is the worker used to render frames. */
 static void rdr_sw_threads_init(worker wk) {
-    int s = 0;
-    workerc = (size_t)get_nprocs();
-    workers = calloc(workerc, sizeof(pthread_t));
+    worker_default = wk;
+    workers = lf_pool_open(0);
+    workerc = (size_t)lf_pool_size(workers);
     worker_ctx = calloc(workerc, sizeof(struct rdr_context));
-    s = pthread_mutex_init(&worker_mutex_done, NULL);
-    if (s != 0) panicen(s, "pthread_mutex_init");
-    s = pthread_cond_init(&worker_cond_done, NULL);
-    if (s != 0) panicen(s, "pthread_cond_init");
+    if (!worker_ctx) {
+        panic("Error: can't allocate the worker contexts.");
+    }
+    int s = pthread_barrier_init(&worker_barrier, NULL, workerc);
+    if (s != 0) panicen(s, "pthread_barrier_init");
+    worker_barrier_count = workerc;
     for (size_t w = 0; w < workerc; w++) {
-        /* Worker argument */
-        worker_ctx[w].buf = NULL;
         worker_ctx[w].workeri = w;
         worker_ctx[w].workerc = workerc;
-        worker_ctx[w].done = false;
-        worker_ctx[w].mutex_work = calloc(1, sizeof(pthread_mutex_t));
-        worker_ctx[w].cond_work = calloc(1, sizeof(pthread_cond_t));
-        worker_ctx[w].mutex_done = &worker_mutex_done;
-        worker_ctx[w].cond_done = &worker_cond_done;
-        /* Launch worker */
-        s = pthread_mutex_init(worker_ctx[w].mutex_work, NULL);
-        if (s != 0) panicen(s, "pthread_mutex_init");
-        s = pthread_cond_init(worker_ctx[w].cond_work, NULL);
-        if (s != 0) panicen(s, "pthread_cond_init");
-        s = pthread_create(&workers[w], NULL, wk, &worker_ctx[w]);
-        if (s != 0) panicen(s, "pthread_create");
+        worker_ctx[w].barrier = &worker_barrier;
     }
 }
-#endif
 
-#ifdef MT
 static void rdr_sw_threads_free(void) {
-    int s = 0;
-    for (size_t w = 0; w < workerc; w++) {
-        s = pthread_cancel(workers[w]);
-        if (s != 0) panicen(s, "pthread_cancel");
-        s = pthread_mutex_destroy(worker_ctx[w].mutex_work);
-        if (s != 0) panicen(s, "pthread_mutex_destroy");
-        s = pthread_cond_destroy(worker_ctx[w].cond_work);
-        if (s != 0) panicen(s, "pthread_cond_destroy");
-        free(worker_ctx[w].mutex_work);
-        free(worker_ctx[w].cond_work);
-    }
-    s = pthread_mutex_destroy(&worker_mutex_done);
-    if (s != 0) panicen(s, "pthread_mutex_destroy");
-    s = pthread_cond_destroy(&worker_cond_done);
-    if (s != 0) panicen(s, "pthread_cond_destroy");
-    free(workers);
+    rdr_sw_wait_mt();
+    lf_pool_close(workers);
+    int s = pthread_barrier_destroy(&worker_barrier);
+    if (s != 0) panicen(s, "pthread_barrier_destroy");
     free(worker_ctx);
+    workers = NULL;
+    worker_ctx = NULL;
+    workerc = 0;
 }
 #endif
 
 void rdr_sw_init(SDL_Window* window) {
     int width, height;
     SDL_GetWindowSize(window, &width, &height);
-    fractal.renderer = SDL_CreateRenderer(window, -1, 0);
+    fractal.renderer = SDL_CreateRenderer(window, -1, (fractal.vsync) ? SDL_RENDERER_PRESENTVSYNC : 0);
     if (!fractal.renderer) {
         rdr_sw_free();
         panic("Error: SDL can't create a renderer.");
     }
     rdr_sw_resize(width, height);
 #ifdef MT
-    rdr_sw_threads_init(rdr_sw_area_worker);
+    rdr_sw_threads_init(rdr_sw_get_worker());
 #endif
 }
 
+void rdr_sw_set_cache(struct tile_cache* cache) {
+    fractal.cache = cache;
+}
+
+void rdr_sw_set_histogram(bool histogram) {
+    fractal.histogram = histogram;
+}
+
+void rdr_sw_set_vsync(bool vsync) {
+    fractal.vsync = vsync;
+}
+
+void rdr_sw_set_fps_target(int fps) {
+    fractal.fps_target = (fps > 0) ? fps : 0;
+    fractal.scale = 1.0;
+}
+
+double rdr_sw_get_scale(void) {
+    return (fractal.frame_scale > 0) ? fractal.frame_scale : 1.0;
+}
+
 void rdr_sw_free(void) {
+#ifdef MT
+    if (workers) {
+        rdr_sw_abort_mt();
+    }
+#endif
     if (fractal.renderer) {
         SDL_DestroyRenderer(fractal.renderer);
     }
     if (fractal.texture) {
         SDL_DestroyTexture(fractal.texture);
     }
+    fractal.texture = NULL;
+    fractal.tex_w = fractal.tex_h = 0;
+    fractal.shown = (SDL_Rect){0};
     if (fractal.buffer) {
         SDL_FreeSurface(fractal.buffer);
+        fractal.buffer = NULL;
+    }
+    fractal.tiled = NULL;
+    if (fractal.view) {
+        SDL_FreeSurface(fractal.view);
+        fractal.view = NULL;
+    }
+#ifdef MT
+    if (fractal.front) {
+        SDL_FreeSurface(fractal.front);
+        fractal.front = NULL;
+    }
+    if (fractal.front_view) {
+        SDL_FreeSurface(fractal.front_view);
+        fractal.front_view = NULL;
+    }
+    fractal.front_tiled = NULL;
+    if (workers) {
+        rdr_sw_threads_free();
     }
-#ifdef LT
-    rdr_sw_threads_free();
 #endif
+    for (int i = 0; i < RDR_SW_STORES; i++) {
+        rdr_sw_store_free(&fractal.stores[i]);
+    }
+    rdr_sw_hist_free();
 }
 
-/* renderer interface */
-static fractal_generator rdr_sw_get_generator(enum generator gen) {
-    switch (gen) {
-    case GEN_JULIA:
-        return julia;
-        break;
-    case GEN_JULIA_MULTISET:
-        return julia_multiset;
-        break;
-    default:
-    case GEN_MANDELBROT:
-        return mandelbrot;
-        break;
-    }
+void rdr_sw_pool_init(void) {
+#ifdef MT
+    rdr_sw_threads_init(rdr_sw_get_worker());
+#endif
+}
+
+int rdr_sw_pool_size(void) {
+#ifdef MT
+    return (workers) ? (int)workerc : 1;
+#else
+    return 1;
+#endif
+}
+
+struct lf_pool* rdr_sw_pool_get(void) {
+#ifdef MT
+    return workers;
+#else
     return NULL;
+#endif
+}
+
+void rdr_sw_pool_free(void) {
+#ifdef MT
+    if (workers) {
+        rdr_sw_threads_free();
+    }
+#endif
 }
 
 void rdr_sw_resize(int width, int height) {
-    /* New texture. */
-    if (fractal.texture) {
-        SDL_DestroyTexture(fractal.texture);
+#ifdef MT
+    /* Workers must not write to the old surface. */
+    if (workers) {
+        rdr_sw_abort_mt();
     }
-    fractal.texture = SDL_CreateTexture(fractal.renderer,
-            SDL_PIXELFORMAT_ARGB8888,
-            SDL_TEXTUREACCESS_STREAMING,
-           width, height);
-    if (!fractal.texture) {
-        rdr_sw_free();
-        panic("Error: SDL can't create a texture.");
+#endif
+    /* Texture, grown like stores: it keeps the last frame while the size
+     ** settles (see rdr_sw_render). */
+    fractal.resize_ms = rdr_sw_now_ms();
+    if (!fractal.texture || width > fractal.tex_w || height > fractal.tex_h) {
+        if (fractal.texture) {
+            SDL_DestroyTexture(fractal.texture);
+        }
+        int tex_w = (width > fractal.tex_w) ? fractal.tex_w + fractal.tex_w / 2 : fractal.tex_w;
+        int tex_h = (height > fractal.tex_h) ? fractal.tex_h + fractal.tex_h / 2 : fractal.tex_h;
+        tex_w = (tex_w > width) ? tex_w : width;
+        tex_h = (tex_h > height) ? tex_h : height;
+        fractal.texture = SDL_CreateTexture(fractal.renderer,
+                SDL_PIXELFORMAT_ARGB8888,
+                SDL_TEXTUREACCESS_STREAMING,
+                tex_w, tex_h);
+        if (!fractal.texture) {
+            /* Beyond the texture size limit of the renderer? */
+            tex_w = width;
+            tex_h = height;
+            fractal.texture = SDL_CreateTexture(fractal.renderer,
+                    SDL_PIXELFORMAT_ARGB8888,
+                    SDL_TEXTUREACCESS_STREAMING,
+                    tex_w, tex_h);
+        }
+        if (!fractal.texture) {
+            rdr_sw_free();
+            panic("Error: SDL can't create a texture.");
+        }
+        fractal.tex_w = tex_w;
+        fractal.tex_h = tex_h;
+        fractal.shown = (SDL_Rect){0};
+        fractal.resize_ms = 0.0;
     }
-    /* New surface. */
-    if (fractal.buffer) {
-        SDL_FreeSurface(fractal.buffer);
+    /* Surfaces & tile-major buffers over the stores. */
+    rdr_sw_store_surface(&fractal.stores[RDR_SW_STORE_BUFFER], &fractal.buffer, width, height);
+    if (fractal.view) {
+        SDL_FreeSurface(fractal.view);
+        fractal.view = NULL;
     }
-    fractal.buffer = SDL_CreateRGBSurface(0, width, height, 32, 0, 0, 0, 0);
-    if (!fractal.buffer) {
-        rdr_sw_free();
-        panic("Error: SDL can't create a surface.");
+    fractal.tiled = (RDR_SW_TILED_FRAMES) ? rdr_sw_store_reserve(&fractal.stores[RDR_SW_STORE_TILED],
+            rdr_sw_tiled_size(width, height)) : NULL;
+    fractal.tiled_frame = false;
+#ifdef MT
+    /* Front buffers of dynamic fractals. */
+    rdr_sw_store_surface(&fractal.stores[RDR_SW_STORE_FRONT], &fractal.front, width, height);
+    if (fractal.front_view) {
+        SDL_FreeSurface(fractal.front_view);
+        fractal.front_view = NULL;
     }
+    fractal.front_tiled = (RDR_SW_TILED_FRAMES) ? rdr_sw_store_reserve(&fractal.stores[RDR_SW_STORE_FRONT_TILED],
+            rdr_sw_tiled_size(width, height)) : NULL;
+    fractal.front_tiled_frame = false;
+    fractal.front_valid = false;
+#endif
 }
 
+uint32_t rdr_sw_map_color(SDL_PixelFormat* format, int iter, int max_iter) {
+    uint8_t color = compute_gray(iter, max_iter);
+    return SDL_MapRGB(format, color, color, color);
+}
 
 /** rdr_sw_line_worker renders a contiguous set of lines to buffer.
  ** ctx->buf is modified directly; it must not be realloc during work. */
 static void* rdr_sw_line_worker(void* arg) {
     struct rdr_context* ctx = (struct rdr_context*) arg;
-#ifdef MT
-    int s = 0;
-    while (true) {
-        /* Wait for work order to be given. */
-        s = pthread_mutex_lock(ctx->mutex_work);
-        if (s != 0) panicen(s, "pthread_mutex_lock");
-        s = pthread_cond_wait(ctx->cond_work, ctx->mutex_work);
-        if (s != 0) panicen(s, "pthread_cond_wait");
-        ctx->done = false;
-        /* Copy context vars. */
-#endif
-        /* Proxy variables. */
-        int width  = ctx->buf->w;
-        int height = ctx->buf->h;
-        struct fractal_info fi = ctx->fi;
-        fractal_generator gen = rdr_sw_get_generator(ctx->fi.generator);
-        /* Worker specific. */
-        int start_line = (ctx->workeri * height) / ctx->workerc;
-        int lines_per_wk = height / ctx->workerc;
-        /* Painting variables. */
-        uint32_t* pixels = (uint32_t*)ctx->buf->pixels + start_line * width;
-        SDL_PixelFormat* format = ctx->buf->format;
-#ifdef MT
-        s = pthread_mutex_unlock(ctx->mutex_work);
-        if (s != 0) panicen(s, "pthread_mutex_unlock");
-#endif
-        /* Calculate iteration per pixel. */
-        for(int y = start_line; y < start_line + lines_per_wk; y++) {
-            for(int x = 0; x < width; x++) {
-                // Calculate a pixel.
-                int iter = gen(
-                            fi.cx + fi.dpp * (x - width/2), // ix.
-                            fi.cy + fi.dpp * (y - height/2), // iy.
-                            fi.jx,
-                            fi.jy,
-                            fi.n,
-                            fi.max_iter);
-
-                if (iter == fi.max_iter) {
-                    iter = 0;
-                }
+    /* Proxy variables. */
+    int width  = ctx->buf->w;
+    int height = ctx->buf->h;
+    struct fractal_info fi = ctx->fi;
+    fractal_generator gen = compute_generator(ctx->fi.generator);
+    /* Worker specific. */
+    int start_line = (ctx->workeri * height) / ctx->workerc;
+    int end_line = ((ctx->workeri + 1) * height) / ctx->workerc;
+    /* Painting variables. */
+    uint32_t* pixels = (uint32_t*)ctx->buf->pixels + start_line * width;
+    SDL_PixelFormat* format = ctx->buf->format;
+    struct rdr_sw_tile_stat tile;
+    rdr_sw_tile_begin(ctx, &tile, 0, start_line, width, end_line - start_line);
+    /* Calculate iteration per pixel. */
+    for(int y = start_line; y < end_line; y++) {
+        if (rdr_sw_stale(ctx)) {
+            break;
+        }
+        for(int x = 0; x < width; x++) {
+            // Calculate a pixel.
+            int iter = gen(
+                        fi.cx + fi.dpp * (x - width/2), // ix.
+                        fi.cy + fi.dpp * (y - height/2), // iy.
+                        fi.jx,
+                        fi.jy,
+                        fi.n,
+                        fi.max_iter);
 
-                double ratio = (double)(iter) / fi.max_iter;
-                uint8_t color = (uint8_t)(ratio * 0xff);
-                *(pixels++) = SDL_MapRGB(format, color, color, color);
-            }
+            *(pixels++) = rdr_sw_map_color(format, iter, fi.max_iter);
+            rdr_sw_tile_cost(ctx, &tile, &iter, x + (size_t)y * width, 1);
         }
-#ifdef MT
-        s = pthread_mutex_lock(ctx->mutex_done);
-        if (s != 0) panicen(s, "pthread_mutex_lock");
-        ctx->done = true;
-        pthread_cond_signal(ctx->cond_done);
-        s = pthread_mutex_unlock(ctx->mutex_done);
-        if (s != 0) panicen(s, "pthread_mutex_unlock");
     }
-#endif
+    rdr_sw_tile_end(ctx, &tile);
     return NULL;
 }
 
+/** rdr_sw_mirror is the symmetry of a view: pixel (x, y) has the iteration
+ ** count of pixel (kx - x, ky - y) if x, of pixel (x, ky - y) otherwise. */
+struct rdr_sw_mirror {
+    bool x, y;
+    int kx, ky;
+};
+
+/** rdr_sw_mirror_axis sets *k so that pixel v of size pixels mirrors pixel
+ ** *k - v about 0, given the center c of the view. Returns false unless the
+ ** view is centered on 0: pixel v is at c + dpp * (v - size/2), the exact
+ ** opposite of pixel *k - v only if c is 0, not after a pan by whole pixels
+ ** (rounded coordinates may differ at the boundary of the set). */
+static bool rdr_sw_mirror_axis(double c, int size, int* k) {
+    if (c != 0.0) {
+        return false;
+    }
+    *k = 2 * (size/2);
+    return *k > 0 && *k < 2 * size - 1;
+}
+
+/** rdr_sw_get_mirror returns the symmetry of the width x height view of fi:
+ ** the Mandelbrot set is symmetric about the real axis and quadratic Julia
+ ** sets about the origin; coordinates of mirrored pixels are exact opposites
+ ** (see rdr_sw_mirror_axis), so are their iteration counts. */
+static struct rdr_sw_mirror rdr_sw_get_mirror(struct fractal_info fi, int width, int height) {
+    struct rdr_sw_mirror m = {0};
+    switch (fi.generator) {
+        case GEN_MANDELBROT:
+            m.y = rdr_sw_mirror_axis(fi.cy, height, &m.ky);
+            break;
+        case GEN_JULIA:
+            m.x = rdr_sw_mirror_axis(fi.cx, width, &m.kx);
+            m.y = m.x && rdr_sw_mirror_axis(fi.cy, height, &m.ky);
+            m.x = m.y;
+            break;
+        default:
+            break;
+    }
+    return m;
+}
+
+/** rdr_sw_mirror_skip tells if pixel (x, y) is rendered along with its mirror
+ ** (mx, my), row_mirrored telling if my is in the view. */
+static bool rdr_sw_mirror_skip(struct rdr_sw_mirror m, bool row_mirrored, int width, int x, int y) {
+    if (!row_mirrored) {
+        return false;
+    }
+    int mx = (m.x) ? m.kx - x : x;
+    int my = m.ky - y;
+    return mx >= 0 && mx < width && (my < y || (my == y && mx < x));
+}
+
 /** rdr_sw_area_worker renders rectangles to buffer.
- ** ctx->buf is modified directly; it must not be realloc during work.
+ ** ctx->buf is modified directly, or ctx->tiled if set; it must not be
+ ** realloc during work.
  ** Better load distribution than rdr_sw_line_worker.
  ** Example: 4 workers, the second one renders
  **     .x..
  **     ..x.
  **     ...x
  **     x...
+ ** Pixels mirrored by the view symmetry are written along with their mirror
+ ** by the worker of the first of the two (see rdr_sw_get_mirror).
  */
 static void* rdr_sw_area_worker(void* arg) {
     struct rdr_context* ctx = (struct rdr_context*) arg;
-#ifdef MT
-    int s = 0;
-    while (true) {
-        /* Wait for work order to be given. */
-        s = pthread_mutex_lock(ctx->mutex_work);
-        if (s != 0) panicen(s, "pthread_mutex_lock");
-        s = pthread_cond_wait(ctx->cond_work, ctx->mutex_work);
-        if (s != 0) panicen(s, "pthread_cond_wait");
-        ctx->done = false;
-        /* Copy context vars. */
-#endif
-        /* Proxy variables. */
-        int width  = ctx->buf->w;
-        int height = ctx->buf->h;
-        struct fractal_info fi = ctx->fi;
-        fractal_generator gen = rdr_sw_get_generator(ctx->fi.generator);
-        /* Worker specific. */
-        int recw = width / ctx->workerc;
-        int rech = height / ctx->workerc;
-        /* Painting variables. */
-        uint32_t* pixels = ctx->buf->pixels;
-        SDL_PixelFormat* format = ctx->buf->format;
-        int workeri = ctx->workeri;
-        int workerc = ctx->workerc;
-#ifdef MT
-        s = pthread_mutex_unlock(ctx->mutex_work);
-        if (s != 0) panicen(s, "pthread_mutex_unlock");
-#endif
-        /* Calculate iteration per pixel. */
-        int recoffset = workeri;
-        int maxoffset = workerc - 1;
-        for (int reci = 0; reci < workerc; reci++) {
-            int xi = recoffset * recw;
-            int yi = reci * rech;
-            int xm = (xi + recw < width) ? xi + recw : width;
-            if (recoffset == maxoffset) xm = width;
-            int ym = (yi + rech < height) ? yi + rech : height;
-            if (reci == maxoffset) ym = height;
-            for (int y = yi; y < ym; y++) {
-                for (int x = xi; x < xm; x++) {
-                    // Calculate a pixel.
-                    int iter = gen(
-                                fi.cx + fi.dpp * (x - width/2), // ix.
-                                fi.cy + fi.dpp * (y - height/2), // iy.
-                                fi.jx,
-                                fi.jy,
-                                fi.n,
-                                fi.max_iter);
-
-                    if (iter == fi.max_iter) {
-                        iter = 0;
+    /* Proxy variables. */
+    int width  = ctx->buf->w;
+    int height = ctx->buf->h;
+    struct fractal_info fi = ctx->fi;
+    bool f32 = compute_float_safe(fi, width, height);
+    /* Worker specific. */
+    int recw = width / ctx->workerc;
+    int rech = height / ctx->workerc;
+    /* Painting variables. */
+    uint32_t* pixels = (ctx->tiled) ? ctx->tiled : ctx->buf->pixels;
+    SDL_PixelFormat* format = ctx->buf->format;
+    int workeri = ctx->workeri;
+    int workerc = ctx->workerc;
+    struct rdr_sw_mirror m = rdr_sw_get_mirror(fi, width, height);
+    int32_t iters[width];
+    /* Calculate iteration per pixel. */
+    int recoffset = workeri;
+    int maxoffset = workerc - 1;
+    for (int reci = 0; reci < workerc; reci++) {
+        int xi = recoffset * recw;
+        int yi = reci * rech;
+        int xm = (xi + recw < width) ? xi + recw : width;
+        if (recoffset == maxoffset) xm = width;
+        int ym = (yi + rech < height) ? yi + rech : height;
+        if (reci == maxoffset) ym = height;
+        struct rdr_sw_tile_stat tile;
+        rdr_sw_tile_begin(ctx, &tile, xi, yi, xm - xi, ym - yi);
+        for (int y = yi; y < ym; y++) {
+            if (rdr_sw_stale(ctx)) {
+                return NULL;
+            }
+            int my = (m.y) ? m.ky - y : -1;
+            bool row_mirrored = my >= 0 && my < height;
+            /* Rows of tile-major buffers. */
+            uint32_t* row = pixels + ((ctx->tiled) ? rdr_sw_tiled_index(0, y, width) : 0);
+            uint32_t* mrow = pixels + ((ctx->tiled && row_mirrored) ? rdr_sw_tiled_index(0, my, width) : 0);
+            int x = xi;
+            while (x < xm) {
+                /* Calculate a run of pixels not rendered with their mirror. */
+                int x1 = x;
+                while (x1 < xm && !rdr_sw_mirror_skip(m, row_mirrored, width, x1, y)) {
+                    x1++;
+                }
+                if (x1 == x) {
+                    x++;
+                    continue;
+                }
+                compute_row(iters, fi, width, height, x, y, x1 - x, f32);
+                rdr_sw_tile_cost(ctx, &tile, iters, x + (size_t)y * width, x1 - x);
+                if (ctx->hist) {
+                    for (int i = 0; x < x1; x++, i++) {
+                        rdr_sw_hist_put(ctx, x + (size_t)y * width, iters[i]);
+                        int mx = (m.x) ? m.kx - x : x;
+                        if (row_mirrored && mx >= 0 && mx < width && (mx != x || my != y)) {
+                            rdr_sw_hist_put(ctx, mx + (size_t)my * width, iters[i]);
+                        }
                     }
+                    continue;
+                }
+                for (int i = 0; x < x1; x++, i++) {
+                    uint32_t color = rdr_sw_map_color(format, iters[i], fi.max_iter);
+                    int mx = (m.x) ? m.kx - x : x;
+                    bool mirrored = row_mirrored && mx >= 0 && mx < width;
+                    if (ctx->tiled) {
+                        row[rdr_sw_tiled_x(x)] = color;
+                        if (mirrored) {
+                            mrow[rdr_sw_tiled_x(mx)] = color;
+                        }
+                        continue;
+                    }
+                    *(pixels + x + y * width) = color;
+                    if (mirrored) {
+                        *(pixels + mx + my * width) = color;
+                    }
+                }
+            }
+        }
+        rdr_sw_tile_end(ctx, &tile);
+        recoffset = (recoffset + 1) % workerc;
+    }
+    return NULL;
+}
 
-                    double ratio = (double)(iter) / fi.max_iter;
-                    uint8_t color = (uint8_t)(ratio * 0xff);
-                    *(pixels + x + y * width) = SDL_MapRGB(format, color, color, color);
+/** floor_div returns a / b rounded toward negative infinity (b > 0). */
+static int64_t floor_div(int64_t a, int64_t b) {
+    return (a >= 0) ? a / b : -((-a + b - 1) / b);
+}
+
+/** rdr_sw_tile_worker renders the TC_TILE_SIZE tiles of the tile cache pixel
+ ** lattice covering buffer; tile k is rendered by worker k % workerc.
+ ** ctx->buf is modified directly; it must not be realloc during work.
+ ** The view is snapped to the closest lattice (less than a pixel away).
+ ** Tiles of static views are served from & stored to ctx->cache. */
+static void* rdr_sw_tile_worker(void* arg) {
+    struct rdr_context* ctx = (struct rdr_context*) arg;
+    /* Proxy variables. */
+    int width  = ctx->buf->w;
+    int height = ctx->buf->h;
+    struct fractal_info fi = ctx->fi;
+    struct tile_cache* cache = (ctx->fi.dynamic) ? NULL : ctx->cache;
+    /* Pixel lattice. */
+    int32_t level = tc_level(fi.dpp);
+    double dpp = tc_level_dpp(level);
+    struct fractal_info lfi = fi;
+    lfi.dpp = dpp;
+    int64_t gx0 = llround(fi.cx / dpp) - width/2;
+    int64_t gy0 = llround(fi.cy / dpp) - height/2;
+    /* Painting variables. */
+    uint32_t* pixels = ctx->buf->pixels;
+    SDL_PixelFormat* format = ctx->buf->format;
+    int workeri = ctx->workeri;
+    int workerc = ctx->workerc;
+    const int64_t ts = TC_TILE_SIZE;
+    int64_t tx0 = floor_div(gx0, ts);
+    int64_t ty0 = floor_div(gy0, ts);
+    int64_t tilesx = floor_div(gx0 + width - 1, ts) - tx0 + 1;
+    int64_t tilesy = floor_div(gy0 + height - 1, ts) - ty0 + 1;
+    int32_t iters[TC_TILE_SIZE * TC_TILE_SIZE];
+    for (int64_t k = workeri; k < tilesx * tilesy; k += workerc) {
+        if (rdr_sw_stale(ctx)) {
+            break;
+        }
+        int64_t tx = tx0 + k % tilesx;
+        int64_t ty = ty0 + k / tilesx;
+        /* Visible part of the tile. */
+        int i0 = (int)((gx0 > tx * ts) ? gx0 - tx * ts : 0);
+        int j0 = (int)((gy0 > ty * ts) ? gy0 - ty * ts : 0);
+        int i1 = (int)((gx0 + width < (tx + 1) * ts) ? gx0 + width - tx * ts : ts);
+        int j1 = (int)((gy0 + height < (ty + 1) * ts) ? gy0 + height - ty * ts : ts);
+        struct tc_key key = tc_key_make(fi, level, tx, ty);
+        struct rdr_sw_tile_stat tile;
+        int x0 = (int)(tx * ts + i0 - gx0), y0 = (int)(ty * ts + j0 - gy0);
+        rdr_sw_tile_begin(ctx, &tile, x0, y0, i1 - i0, j1 - j0);
+        if (!cache || !tc_get(cache, &key, iters)) {
+            /* Cached tiles must be complete. */
+            int ci0 = (cache) ? 0 : i0, ci1 = (cache) ? ts : i1;
+            int cj0 = (cache) ? 0 : j0, cj1 = (cache) ? ts : j1;
+            /* Float if safe for the tile: cached tiles don't depend on
+             * the view. */
+            struct fractal_info tfi = lfi;
+            tfi.cx = (double)(tx * ts + ts/2) * dpp;
+            tfi.cy = (double)(ty * ts + ts/2) * dpp;
+            bool f32 = compute_float_safe(tfi, ts, ts);
+            for (int j = cj0; j < cj1; j++) {
+                compute_points(iters + ci0 + j * ts, lfi, (double)(tx * ts) * dpp, ci0,
+                        (double)(ty * ts + j) * dpp, ci1 - ci0, f32);
+            }
+            if (cache) {
+                tc_put(cache, &key, iters);
+            }
+            /* Cost of the visible pixels; cache hits cost nothing. */
+            for (int j = j0; j < j1; j++) {
+                rdr_sw_tile_cost(ctx, &tile, iters + i0 + j * ts,
+                        x0 + (size_t)(y0 + j - j0) * width, i1 - i0);
+            }
+        }
+        for (int j = j0; j < j1; j++) {
+            int y = (int)(ty * ts + j - gy0);
+            for (int i = i0; i < i1; i++) {
+                int x = (int)(tx * ts + i - gx0);
+                if (ctx->hist) {
+                    rdr_sw_hist_put(ctx, x + (size_t)y * width, iters[i + j * ts]);
+                } else {
+                    *(pixels + x + y * width) = rdr_sw_map_color(format, iters[i + j * ts], fi.max_iter);
                 }
             }
-            recoffset = (recoffset + 1) % workerc;
         }
-#ifdef MT
-        s = pthread_mutex_lock(ctx->mutex_done);
-        if (s != 0) panicen(s, "pthread_mutex_lock");
-        ctx->done = true;
-        pthread_cond_signal(ctx->cond_done);
-        s = pthread_mutex_unlock(ctx->mutex_done);
-        if (s != 0) panicen(s, "pthread_mutex_unlock");
+        rdr_sw_tile_end(ctx, &tile);
     }
-#endif
     return NULL;
 }
 
+/** rdr_sw_hist_worker renders buffer with histogram colouring: the gray
+ ** level of an iteration count is the share of the escaping pixels with at
+ ** most this count. Workers, separated by barriers:
+ **  1. compute iteration counts & their own histogram (area or tile worker),
+ **  2. merge & reset a slice of the histograms, summing their pixels,
+ **  3. turn their slice to colors (prefix sum offset by the previous slices),
+ **  4. map a band of rows.
+ ** Stale frames still run 2 to keep histograms zeroed. */
+static void* rdr_sw_hist_worker(void* arg) {
+    struct rdr_context* ctx = (struct rdr_context*) arg;
+    struct rdr_sw_hist* h = ctx->hist;
+    struct rdr_sw_hist_slot* slot = &h->slots[ctx->workeri];
+    int max_iter = ctx->fi.max_iter;
+    int workeri = ctx->workeri;
+    int workerc = ctx->workerc;
+    /* 1. Iteration counts. */
+    slot->lo = max_iter;
+    slot->hi = 0;
+    if (ctx->cache) {
+        rdr_sw_tile_worker(ctx);
+    } else {
+        rdr_sw_area_worker(ctx);
+    }
+    rdr_sw_barrier(ctx);
+    /* 2. Merge the slice [i0, i1) of the range of counts. */
+    int lo = max_iter, hi = 0;
+    for (int w = 0; w < workerc; w++) {
+        if (h->slots[w].lo < lo) lo = h->slots[w].lo;
+        if (h->slots[w].hi > hi) hi = h->slots[w].hi;
+    }
+    if (hi < lo) {
+        hi = lo;
+    }
+    int i0 = lo + (int)((int64_t)(hi - lo) * workeri / workerc);
+    int i1 = lo + (int)((int64_t)(hi - lo) * (workeri + 1) / workerc);
+    uint32_t* lut = h->lut;
+    memset(lut + i0, 0, (i1 - i0) * sizeof(uint32_t));
+    for (int w = 0; w < workerc; w++) {
+        uint32_t* counts = h->slots[w].counts;
+        for (int i = i0; i < i1; i++) {
+            lut[i] += counts[i];
+            counts[i] = 0;
+        }
+    }
+    uint64_t sum = 0;
+    for (int i = i0; i < i1; i++) {
+        sum += lut[i];
+    }
+    slot->sum = sum;
+    rdr_sw_barrier(ctx);
+    /* 3. Colors of the slice. */
+    SDL_PixelFormat* format = ctx->buf->format;
+    bool stale = rdr_sw_stale(ctx);
+    if (!stale) {
+        uint64_t cum = 0, total = 0;
+        for (int w = 0; w < workerc; w++) {
+            if (w < workeri) {
+                cum += h->slots[w].sum;
+            }
+            total += h->slots[w].sum;
+        }
+        uint32_t palette[256];
+        for (int c = 0; c < 256; c++) {
+            palette[c] = SDL_MapRGB(format, c, c, c);
+        }
+        compute_hist_colors(lut, i0, i1, cum, total, palette);
+    }
+    rdr_sw_barrier(ctx);
+    /* 4. Pixels of the rows [y0, y1). */
+    if (stale || rdr_sw_stale(ctx)) {
+        return NULL;
+    }
+    int width = ctx->buf->w;
+    int height = ctx->buf->h;
+    int y0 = height * workeri / workerc;
+    int y1 = height * (workeri + 1) / workerc;
+    uint32_t black = SDL_MapRGB(format, 0, 0, 0);
+    uint32_t* pixels = ctx->buf->pixels;
+    int32_t* iters = h->iters;
+    for (size_t p = (size_t)y0 * width; p < (size_t)y1 * width; p++) {
+        int32_t iter = iters[p];
+        pixels[p] = (iter < max_iter) ? lut[iter] : black;
+    }
+    return NULL;
+}
+
+/** rdr_sw_job_worker runs ctx->job on ctx->job_arg. */
+static void* rdr_sw_job_worker(void* arg) {
+    struct rdr_context* ctx = (struct rdr_context*) arg;
+    ctx->job(ctx->job_arg, ctx->workeri, ctx->workerc);
+    return NULL;
+}
+
+void rdr_sw_render_lattice(SDL_Surface* buf, struct fractal_info fi,
+        double ox, double oy, int64_t gx0, int64_t gy0) {
+    SDL_PixelFormat* format = buf->format;
+    /* Pixels are computed at their center. */
+    double x0 = ox + ((double)gx0 + 0.5) * fi.dpp;
+    struct fractal_info bfi = fi;
+    bfi.cx = x0 + fi.dpp * (buf->w / 2);
+    bfi.cy = oy + ((double)gy0 + 0.5 + buf->h / 2) * fi.dpp;
+    bool f32 = compute_float_safe(bfi, buf->w, buf->h);
+    int32_t iters[buf->w];
+    for (int y = 0; y < buf->h; y++) {
+        uint32_t* pixels = (uint32_t*)((uint8_t*)buf->pixels + y * buf->pitch);
+        compute_points(iters, fi, x0, 0, oy + ((double)(gy0 + y) + 0.5) * fi.dpp, buf->w, f32);
+        for (int x = 0; x < buf->w; x++) {
+            *(pixels++) = rdr_sw_map_color(format, iters[x], fi.max_iter);
+        }
+    }
+}
+
 #ifdef MT
-static void rdr_sw_update_mt(SDL_Surface* buf, struct fractal_info fi, double t) {
+/** rdr_sw_post_mt gives the work order wk to the first threads workers;
+ ** the others stay idle. */
+static void rdr_sw_post_mt(worker wk, size_t threads, SDL_Surface* buf, struct fractal_info fi,
+        rdr_sw_job job, void* job_arg) {
     int s = 0;
-    /* Set constant for dynamic fractals. */
-    if (fi.dynamic) {
-        double tp = t / (2 * M_PI_2);
-        double ct = cos(tp);
-        double st = sin(tp);
-        fi.jx *= ct;
-        fi.jy *= st;
+    rdr_sw_wait_mt();
+    unsigned generation = atomic_load(&fractal.generation);
+    if (threads < 1 || threads > workerc) {
+        threads = workerc;
     }
-    /* Update worker context. */
-    for (size_t w = 0; w < workerc; w++) {
-        s = pthread_mutex_lock(worker_ctx[w].mutex_work);
-        if (s != 0) panicen(s, "pthread_mutex_lock");
+    if (threads != worker_barrier_count) {
+        /* All workers are idle. */
+        s = pthread_barrier_destroy(&worker_barrier);
+        if (s != 0) panicen(s, "pthread_barrier_destroy");
+        s = pthread_barrier_init(&worker_barrier, NULL, threads);
+        if (s != 0) panicen(s, "pthread_barrier_init");
+        worker_barrier_count = threads;
+    }
+    if (wk == rdr_sw_hist_worker) {
+        rdr_sw_hist_reserve(buf->w, buf->h, fi.max_iter, threads);
+    }
+    /* Frames of the area worker are tile-major if enabled. */
+    uint32_t* tiled = NULL;
+    if (buf && (buf == fractal.buffer || buf == fractal.view)) {
+        tiled = (wk == rdr_sw_area_worker) ? fractal.tiled : NULL;
+        fractal.tiled_frame = tiled != NULL;
+    }
+    /* Update worker context: the pool is idle. */
+    for (size_t w = 0; w < threads; w++) {
+        worker_ctx[w].workerc = threads;
         worker_ctx[w].buf = buf;
         worker_ctx[w].fi = fi;
-        worker_ctx[w].done = false;
-        /* Signal execution to worker. */
-        pthread_cond_signal(worker_ctx[w].cond_work);
-        s = pthread_mutex_unlock(worker_ctx[w].mutex_work);
-        if (s != 0) panicen(s, "pthread_mutex_unlock");
-    }
-    /* Timeout */
-    struct timespec abstime;
-    abstime.tv_sec  = 0;
-    abstime.tv_nsec = 10000; // every ms.
-    /* Wait for all workers to finish. */
-    while (true) {
-        s = pthread_mutex_lock(&worker_mutex_done);
-        if (s != 0) panicen(s, "pthread_mutex_lock");
-        s = pthread_cond_timedwait(&worker_cond_done, &worker_mutex_done, &abstime);
-        if (s != 0 && s != ETIMEDOUT) panicen(s, "pthread_cond_timedwait");
-        bool done = true;
-        for (size_t w = 0; w < workerc; w++) {
-            done &= worker_ctx[w].done;
-            /* Try to delock thread. */
-            if (!worker_ctx[w].done) {
-                s = pthread_mutex_lock(worker_ctx[w].mutex_work);
-                if (s != 0) panicen(s, "pthread_mutex_lock");
-                pthread_cond_signal(worker_ctx[w].cond_work);
-                s = pthread_mutex_unlock(worker_ctx[w].mutex_work);
-                if (s != 0) panicen(s, "pthread_mutex_unlock");
-            }
-        }
-        if (done) {
-            s = pthread_mutex_unlock(&worker_mutex_done);
-            if (s != 0) panicen(s, "pthread_mutex_unlock");
-            break;
-        }
-        s = pthread_mutex_unlock(&worker_mutex_done);
-        if (s != 0) panicen(s, "pthread_mutex_unlock");
+        worker_ctx[w].cache = fractal.cache;
+        worker_ctx[w].hist = (wk == rdr_sw_hist_worker) ? &hist : NULL;
+        worker_ctx[w].profile = fractal.profile;
+        worker_ctx[w].tiled = tiled;
+        worker_ctx[w].job = job;
+        worker_ctx[w].job_arg = job_arg;
+        worker_ctx[w].generation = generation;
+        worker_ctx[w].wk = wk;
+    }
+    /* Distinct workers: rdr_sw_hist_worker waits for all of them. */
+    worker_job = lf_pool_post(workers, rdr_sw_thread, NULL, (int)threads);
+}
+
+/** rdr_sw_idle_mt tells if all workers are done, without waiting. */
+static bool rdr_sw_idle_mt(void) {
+    return !worker_job || lf_job_done(worker_job);
+}
+
+/** rdr_sw_done_ms_mt returns when the last work order was done by workers. */
+static double rdr_sw_done_ms_mt(void) {
+    double done_ms = 0.0;
+    for (size_t w = 0; w < workerc; w++) {
+        done_ms = fmax(done_ms, worker_ctx[w].done_ms);
+    }
+    return done_ms;
+}
+
+/** rdr_sw_wait_mt waits for all workers to be done. */
+static void rdr_sw_wait_mt(void) {
+    if (worker_job) {
+        lf_job_wait(worker_job);
+        worker_job = NULL;
+    }
+}
+
+/** rdr_sw_work_mt gives the work order wk to threads workers & waits for them. */
+static void rdr_sw_work_mt(worker wk, size_t threads, SDL_Surface* buf, struct fractal_info fi,
+        rdr_sw_job job, void* job_arg) {
+    rdr_sw_post_mt(wk, threads, buf, fi, job, job_arg);
+    rdr_sw_wait_mt();
+}
+
+/** rdr_sw_abort_mt aborts the frame in flight of rdr_sw_render & waits for
+ ** the workers; the next call of rdr_sw_render renders a whole frame. */
+static void rdr_sw_abort_mt(void) {
+    if (fractal.posted) {
+        atomic_fetch_add(&fractal.generation, 1);
+        rdr_sw_wait_mt();
+        fractal.posted = false;
     }
+    fractal.started = false;
+}
+
+static void rdr_sw_update_mt(SDL_Surface* buf, struct fractal_info fi, double t) {
+    /* Set constant for dynamic fractals. */
+    fi = fi_at(fi, t);
+    struct rdr_sw_tuning tuning = rdr_sw_get_tuning(fi);
+    rdr_sw_work_mt(tuning.wk, tuning.threads, buf, fi, NULL, NULL);
 }
 #endif
 
 static void rdr_sw_update(SDL_Surface* buf, struct fractal_info fi, double t, worker wk) {
     /* Set constant for dynamic fractals. */
-    if (fi.dynamic) {
-        double tp = t / (2 * M_PI_2);
-        double ct = cos(tp);
-        double st = sin(tp);
-        fi.jx *= ct;
-        fi.jy *= st;
-    }
+    fi = fi_at(fi, t);
     /* Update worker context. */
     struct rdr_context ctx= {0};
     ctx.buf = buf;
     ctx.fi = fi;
+    ctx.cache = fractal.cache;
+    ctx.profile = fractal.profile;
+    if (buf == fractal.buffer || buf == fractal.view) {
+        ctx.tiled = (wk == rdr_sw_area_worker) ? fractal.tiled : NULL;
+        fractal.tiled_frame = ctx.tiled != NULL;
+    }
     ctx.workeri = 0;
     ctx.workerc = 1;
+    ctx.generation = atomic_load(&fractal.generation);
+    if (wk == rdr_sw_hist_worker) {
+        rdr_sw_hist_reserve(buf->w, buf->h, fi.max_iter, 1);
+        ctx.hist = &hist;
+    }
     /* Launch worker. */
     wk(&ctx);
 }
 
-void rdr_sw_render(struct fractal_info fi, double t, double dt) {
+void rdr_sw_run(rdr_sw_job job, void* arg) {
+#ifdef MT
+    if (workers) {
+        if (fractal.posted) {
+            /* Abort the frame in flight: rdr_sw_render reposts it. */
+            atomic_fetch_add(&fractal.generation, 1);
+            rdr_sw_wait_mt();
+        }
+        rdr_sw_work_mt(rdr_sw_job_worker, workerc, NULL, (struct fractal_info){0}, job, arg);
+        return;
+    }
+#endif
+    /* No pool (hardware renderer): on the calling thread. */
+    struct rdr_context ctx = {0};
+    ctx.job = job;
+    ctx.job_arg = arg;
+    ctx.workeri = 0;
+    ctx.workerc = 1;
+    rdr_sw_job_worker(&ctx);
+}
+
+void rdr_sw_render_buffer(SDL_Surface* buf, struct fractal_info fi, double t) {
+#ifdef MT
+    rdr_sw_update_mt(buf, fi, t);
+#else
+    rdr_sw_update(buf, fi, t, rdr_sw_get_tuning(fi).wk);
+#endif
+}
+
+void rdr_sw_profile_buffer(SDL_Surface* buf, struct fractal_info fi,
+        struct rdr_sw_profile* prof) {
+    memset(prof->cost, 0, (size_t)buf->w * buf->h * sizeof(uint32_t));
+    atomic_store(&prof->tilec, 0);
+    fractal.profile = prof;
+    rdr_sw_render_buffer(buf, fi, 0.0);
+    fractal.profile = NULL;
+    if (prof->tilec > prof->tilecap) {
+        prof->tilec = prof->tilecap;
+    }
+}
+
+/** rdr_sw_strategies names the workers rdr_sw_autotune may pick. */
+static const struct {
+    const char* name;
+    worker wk;
+} rdr_sw_strategies[] = {
+    {"area",      rdr_sw_area_worker},
+    {"line",      rdr_sw_line_worker},
+    {"tile",      rdr_sw_tile_worker},
+    {"histogram", rdr_sw_hist_worker},
+};
+#define RDR_SW_STRATEGIES (sizeof(rdr_sw_strategies) / sizeof(rdr_sw_strategies[0]))
+
+/** rdr_sw_strategy_name returns the name of wk. */
+static const char* rdr_sw_strategy_name(worker wk) {
+    for (size_t i = 0; i < RDR_SW_STRATEGIES; i++) {
+        if (rdr_sw_strategies[i].wk == wk) {
+            return rdr_sw_strategies[i].name;
+        }
+    }
+    return "?";
+}
+
+/** rdr_sw_candidates sets the workers that may render frames; area & line
+ ** workers when no tile cache nor histogram colouring forces the worker.
+ ** Returns their count. */
+static size_t rdr_sw_candidates(worker* wks) {
+    if (fractal.cache || fractal.histogram) {
+        wks[0] = rdr_sw_get_worker();
+        return 1;
+    }
+    wks[0] = rdr_sw_area_worker;
+    wks[1] = rdr_sw_line_worker;
+    return 2;
+}
+
+/** rdr_sw_time_ms returns the best time in ms of a few renders of fi to buf
+ ** with tuning, after a warm-up one. */
+static double rdr_sw_time_ms(struct rdr_sw_tuning tuning, SDL_Surface* buf, struct fractal_info fi) {
+    double best = INFINITY, spent = 0.0;
+    for (int run = 0; run < 6 && (run < 2 || spent < 250.0); run++) {
+        struct timespec t0, t1;
+        clock_gettime(CLOCK_MONOTONIC, &t0);
+#ifdef MT
+        rdr_sw_work_mt(tuning.wk, tuning.threads, buf, fi, NULL, NULL);
+#else
+        rdr_sw_update(buf, fi, 0.0, tuning.wk);
+#endif
+        clock_gettime(CLOCK_MONOTONIC, &t1);
+        double ms = (t1.tv_sec - t0.tv_sec) * 1e3 + (t1.tv_nsec - t0.tv_nsec) / 1e6;
+        spent += ms;
+        if (run > 0 && ms < best) {
+            best = ms;
+        }
+    }
+    return best;
+}
+
+/** rdr_sw_autotune_path returns the tuning file of this host (to free). */
+static char* rdr_sw_autotune_path(void) {
+    char host[256] = "localhost";
+    if (gethostname(host, sizeof(host)) != 0) {
+        strcpy(host, "localhost");
+    }
+    host[sizeof(host) - 1] = '\0';
+    char name[sizeof(host) + sizeof("autotune-.txt")];
+    snprintf(name, sizeof(name), "autotune-%s.txt", host);
+    return config_cache_path(name);
+}
+
+void rdr_sw_autotune(struct fractal_info** presets, size_t presetc) {
+    SDL_Surface* buf = fractal.buffer;
+    if (!buf) {
+        return;
+    }
+#ifdef MT
+    int cpus = (int)workerc;
+    if (fractal.posted) {
+        rdr_sw_abort_mt();
+    }
+#else
+    int cpus = 1;
+#endif
+    worker candidates[2];
+    size_t candidatec = rdr_sw_candidates(candidates);
+    /* Generators to tune: the first preset of each. */
+    struct fractal_info* todo[RDR_SW_GENERATORS] = {0};
+    for (size_t i = 0; i < presetc; i++) {
+        enum generator gen = presets[i]->generator;
+        if (gen < RDR_SW_GENERATORS && !todo[gen]) {
+            todo[gen] = presets[i];
+        }
+    }
+    /* Read tunings of this host, keeping lines of other settings. */
+    char* path = rdr_sw_autotune_path();
+    char** lines = NULL;
+    size_t linec = 0;
+    FILE* fp = fopen(path, "r");
+    char line[256];
+    while (fp && fgets(line, sizeof(line), fp)) {
+        int gen, w, h, c, threads;
+        char name[32];
+        double ms;
+        if (sscanf(line, "%d %d %d %d %31s %d %lf", &gen, &w, &h, &c, name, &threads, &ms) != 7) {
+            continue;
+        }
+        if (gen >= 0 && gen < RDR_SW_GENERATORS && todo[gen]
+                && w == buf->w && h == buf->h && c == cpus) {
+            for (size_t i = 0; i < candidatec; i++) {
+                if (strcmp(name, rdr_sw_strategy_name(candidates[i])) == 0
+                        && threads >= 1 && threads <= cpus) {
+                    tunings[gen] = (struct rdr_sw_tuning){candidates[i], (size_t)threads};
+                    todo[gen] = NULL;
+                    fprintf(stdout, "> autotune %d: %s worker, %d threads (%.1f ms, from `%s`)\n",
+                            gen, name, threads, ms, path);
+                }
+            }
+            if (!todo[gen]) {
+                continue;
+            }
+        }
+        lines = realloc(lines, (linec + 1) * sizeof(char*));
+        lines[linec++] = strdup(line);
+    }
+    if (fp) {
+        fclose(fp);
+    }
+    /* Calibrate the others. */
+    bool updated = false;
+    for (int gen = 0; gen < RDR_SW_GENERATORS; gen++) {
+        if (!todo[gen]) {
+            continue;
+        }
+        struct fractal_info fi = fi_at(*todo[gen], 0.0);
+        struct rdr_sw_tuning best = {NULL, 0};
+        double best_ms = INFINITY;
+        for (size_t i = 0; i < candidatec; i++) {
+            /* 1, 2, 4... & cpus threads. */
+            int threads = 1;
+            while (true) {
+                struct rdr_sw_tuning tuning = {candidates[i], (size_t)threads};
+                double ms = rdr_sw_time_ms(tuning, buf, fi);
+                fprintf(stdout, "> autotune %d: %s worker, %d threads: %.2f ms\n",
+                        gen, rdr_sw_strategy_name(tuning.wk), threads, ms);
+                if (ms < best_ms) {
+                    best = tuning;
+                    best_ms = ms;
+                }
+                if (threads == cpus) {
+                    break;
+                }
+                threads = (threads * 2 < cpus) ? threads * 2 : cpus;
+            }
+        }
+        tunings[gen] = best;
+        fprintf(stdout, "> autotune %d: %s worker, %zu threads (%.2f ms)\n",
+                gen, rdr_sw_strategy_name(best.wk), best.threads, best_ms);
+        snprintf(line, sizeof(line), "%d %d %d %d %s %zu %.3f\n",
+                gen, buf->w, buf->h, cpus, rdr_sw_strategy_name(best.wk), best.threads, best_ms);
+        lines = realloc(lines, (linec + 1) * sizeof(char*));
+        lines[linec++] = strdup(line);
+        updated = true;
+    }
+    /* Save. */
+    if (updated) {
+        if ((fp = fopen(path, "w"))) {
+            fprintf(fp, "# generator width height cpus worker threads ms\n");
+            for (size_t i = 0; i < linec; i++) {
+                fputs(lines[i], fp);
+            }
+            fclose(fp);
+        } else {
+            fprintf(stderr, "Can't write autotune file `%s`.\n", path);
+        }
+    }
+    for (size_t i = 0; i < linec; i++) {
+        free(lines[i]);
+    }
+    free(lines);
+    free(path);
+}
+
+/** RDR_SW_RESIZE_SETTLE_MS is the time without resize after which frames
+ ** are rendered at the new size: meanwhile the last one is stretched. */
+#define RDR_SW_RESIZE_SETTLE_MS 150.0
+
+/** RDR_SW_MIN_SCALE bounds the scale of frames of dynamic fractals. */
+#define RDR_SW_MIN_SCALE 0.5
+/** RDR_SW_SCALE_GAIN damps the scale changes between frames. */
+#define RDR_SW_SCALE_GAIN 0.5
+/** RDR_SW_FRAME_BUDGET is the share of the frame time of the fps target
+ ** left to workers, the rest for the upload & present. */
+#define RDR_SW_FRAME_BUDGET 0.9
+
+/** rdr_sw_view returns buf, or view set over its pixels when scale makes
+ ** frames smaller: rows of scale times its width, packed. view is freed
+ ** (NULL) for frames at the size of buf. */
+static SDL_Surface* rdr_sw_view(SDL_Surface* buf, SDL_Surface** view, double scale) {
+    int width = (int)lround(buf->w * scale), height = (int)lround(buf->h * scale);
+    width = (width > 0) ? width : 1;
+    height = (height > 0) ? height : 1;
+    if (width >= buf->w && height >= buf->h) {
+        if (*view) {
+            SDL_FreeSurface(*view);
+            *view = NULL;
+        }
+        return buf;
+    }
+    if (!*view || (*view)->w != width || (*view)->h != height || (*view)->pixels != buf->pixels) {
+        if (*view) {
+            SDL_FreeSurface(*view);
+        }
+        *view = SDL_CreateRGBSurfaceFrom(buf->pixels, width, height, 32, width * 4, 0, 0, 0, 0);
+        if (!*view) {
+            panic("Error: SDL can't create a surface.");
+        }
+    }
+    return *view;
+}
+
+/** rdr_sw_scaled tells if frames of fi are scaled: views moving with a fps
+ ** target; static ones are rendered at the size of the window, as are
+ ** paused ones (see rdr_sw_still). */
+static bool rdr_sw_scaled(struct fractal_info fi) {
+    return fractal.fps_target && fi.dynamic && fi.speed != 0.0;
+}
+
+/** rdr_sw_still tells if a frame at time t shows the last one still: paused
+ ** animations are rendered at full scale. */
+static bool rdr_sw_still(double t) {
+    return t == fractal.frame_t;
+}
+
+/** rdr_sw_scale_update adjusts the scale from the ms the workers spent on the
+ ** last frame, rendered at frame_scale: render time goes with the pixels. */
+static void rdr_sw_scale_update(double ms) {
+    double budget = RDR_SW_FRAME_BUDGET * 1000.0 / fractal.fps_target;
+    double scale = fractal.frame_scale * sqrt(budget / fmax(ms, 0.1));
+    scale = fractal.scale + RDR_SW_SCALE_GAIN * (scale - fractal.scale);
+    fractal.scale = fmin(fmax(scale, RDR_SW_MIN_SCALE), 1.0);
+}
+
+#ifdef MT
+/** rdr_sw_swap_front swaps the buffers workers render to with the front ones. */
+static void rdr_sw_swap_front(void) {
+    SDL_Surface* buffer = fractal.buffer;
+    fractal.buffer = fractal.front;
+    fractal.front = buffer;
+    SDL_Surface* view = fractal.view;
+    fractal.view = fractal.front_view;
+    fractal.front_view = view;
+    uint32_t* tiled = fractal.tiled;
+    fractal.tiled = fractal.front_tiled;
+    fractal.front_tiled = tiled;
+    bool tiled_frame = fractal.tiled_frame;
+    fractal.tiled_frame = fractal.front_tiled_frame;
+    fractal.front_tiled_frame = tiled_frame;
+}
+
+/** rdr_sw_preview_job maps the pixels of a frame to the ones of another view
+ ** of the same fractal: the pixel (x, y) of dst is the nearest one of src at
+ ** (x * sx + bx, y * sy + by), background outside of src. */
+struct rdr_sw_preview_job {
+    const uint32_t* src;
+    int src_pitch; // bytes.
+    uint32_t* dst;
+    bool tiled; // dst is tile-major.
+    int width, height;
+    double sx, bx, sy, by;
+    uint32_t background;
+};
+
+static void rdr_sw_preview_rows(void* arg, int workeri, int workerc) {
+    struct rdr_sw_preview_job* job = arg;
+    int width = job->width;
+    int y0 = (int)((int64_t)job->height * workeri / workerc);
+    int y1 = (int)((int64_t)job->height * (workeri + 1) / workerc);
+    /* Columns of src of the pixels of a row, -1 outside. */
+    int xs[width];
+    for (int x = 0; x < width; x++) {
+        double ox = floor(x * job->sx + job->bx + 0.5);
+        xs[x] = (ox >= 0 && ox < width) ? (int)ox : -1;
+    }
+    for (int y = y0; y < y1; y++) {
+        double oy = floor(y * job->sy + job->by + 0.5);
+        uint32_t* row = job->dst + ((job->tiled) ? rdr_sw_tiled_index(0, y, width) : (size_t)y * width);
+        if (oy < 0 || oy >= job->height) {
+            for (int x = 0; x < width; x++) {
+                row[(job->tiled) ? rdr_sw_tiled_x(x) : (size_t)x] = job->background;
+            }
+            continue;
+        }
+        const uint32_t* src = (const uint32_t*)((const uint8_t*)job->src + (size_t)oy * job->src_pitch);
+        for (int x = 0; x < width; x++) {
+            uint32_t color = (xs[x] >= 0) ? src[xs[x]] : job->background;
+            row[(job->tiled) ? rdr_sw_tiled_x(x) : (size_t)x] = color;
+        }
+    }
+}
+
+/** rdr_sw_previewable tells if the frame of from, at the size of the window,
+ ** previews to: another view of the same static fractal. */
+static bool rdr_sw_previewable(struct fractal_info from, struct fractal_info to) {
+    return !from.dynamic && !to.dynamic
+        && from.generator == to.generator
+        && from.jx == to.jx && from.jy == to.jy && from.n == to.n
+        && (from.cx != to.cx || from.cy != to.cy || from.dpp != to.dpp);
+}
+
+/** rdr_sw_preview resamples the last frame, of the view from, to buffer or
+ ** tiled (tile-major) for the view to, until workers overwrite it: front is
+ ** the scratch copy of the frame, static views don't use it. */
+static void rdr_sw_preview(struct fractal_info from, struct fractal_info to, bool tiled) {
+    SDL_Surface* buf = fractal.buffer;
+    int width = buf->w, height = buf->h;
+    if (fractal.tiled_frame) {
+        rdr_sw_swizzle(fractal.front->pixels, fractal.front->pitch, fractal.tiled, width, height);
+    } else {
+        memcpy(fractal.front->pixels, buf->pixels, (size_t)height * buf->pitch);
+    }
+    struct rdr_sw_preview_job job = {
+        .src = fractal.front->pixels,
+        .src_pitch = fractal.front->pitch,
+        .dst = (tiled) ? fractal.tiled : buf->pixels,
+        .tiled = tiled,
+        .width = width,
+        .height = height,
+        .background = SDL_MapRGB(buf->format, 0, 0, 0),
+    };
+    /* Pixels are sampled at c + dpp * (x - width/2). */
+    job.sx = to.dpp / from.dpp;
+    job.bx = (to.cx - from.cx) / from.dpp + (width / 2) * (1.0 - job.sx);
+    job.sy = job.sx;
+    job.by = (to.cy - from.cy) / from.dpp + (height / 2) * (1.0 - job.sy);
+    /* Not rdr_sw_run: it would abort the frame being posted. */
+    rdr_sw_work_mt(rdr_sw_job_worker, workerc, NULL, (struct fractal_info){0},
+            rdr_sw_preview_rows, &job);
+    fractal.tiled_frame = tiled;
+    fractal.front_valid = false;
+}
+#endif
+
+/** rdr_sw_render renders frames asynchronously (MT): a call with a newer fi
+ ** aborts the frame in flight, workers stop at their next tile. Each call
+ ** presents the buffer as is, the latest frame being possibly partial.
+ ** A change of t alone doesn't abort: the next frame waits for the current
+ ** one and uses the latest t. Dynamic fractals are pipelined: complete
+ ** frames are swapped to the front buffers & presented while the workers
+ ** render the next one, at t predicted for its presentation. With a fps
+ ** target (see rdr_sw_set_fps_target), moving views are rendered at a scale
+ ** of the window adjusted per frame & stretched on present. A new view of
+ ** a static fractal is previewed by the last frame resampled, replaced by
+ ** pixels as workers compute them. While the window is being resized, the
+ ** last frame is stretched to it until the size settles. */
+bool rdr_sw_render(struct fractal_info fi, double t, double dt) {
     (void)dt;
-    /* Update main memory buffer. */
+    if (fractal.shown.w > 0 && rdr_sw_now_ms() - fractal.resize_ms < RDR_SW_RESIZE_SETTLE_MS) {
+        SDL_RenderClear(fractal.renderer);
+        SDL_RenderCopy(fractal.renderer, fractal.texture, &fractal.shown, NULL);
+        SDL_RenderPresent(fractal.renderer);
+        return false;
+    }
 #ifdef MT
-    rdr_sw_update_mt(fractal.buffer, fi, t);
+    bool stale = !fractal.started || !fi_equal(fi, fractal.frame_fi);
+    if (stale && fractal.posted) {
+        atomic_fetch_add(&fractal.generation, 1);
+    }
+    bool pipelined = fi.dynamic;
+    bool completed = false;
+    /* A scaled frame of a still view is replaced by a full scale one. */
+    bool rescale = fractal.started && rdr_sw_still(t) && fractal.frame_scale < 1.0;
+    if (fractal.posted && rdr_sw_idle_mt()) {
+        fractal.posted = false;
+        fractal.complete = fractal.frame_gen == atomic_load(&fractal.generation);
+        completed = fractal.complete && !stale && !rescale;
+        if (completed && pipelined) {
+            rdr_sw_swap_front();
+            fractal.front_valid = true;
+            double latency = rdr_sw_now_ms() - fractal.frame_start;
+            fractal.latency = (fractal.latency > 0) ? 0.75 * fractal.latency + 0.25 * latency : latency;
+            if (rdr_sw_scaled(fractal.frame_fi)) {
+                rdr_sw_scale_update(rdr_sw_done_ms_mt() - fractal.frame_start);
+            }
+        }
+    }
+    if (stale && !fractal.frame_fi.dynamic) {
+        /* front holds a frame of an older view. */
+        fractal.front_valid = false;
+    }
+    if (!fractal.posted && (stale || t != fractal.frame_t || !fractal.complete || rescale)) {
+        bool preview = fractal.started && rdr_sw_previewable(fractal.frame_fi, fi);
+        struct fractal_info last_fi = fractal.frame_fi;
+        fractal.posted = true;
+        fractal.started = true;
+        fractal.complete = false;
+        fractal.frame_gen = atomic_load(&fractal.generation);
+        fractal.frame_fi = fi;
+        bool still = rescale || rdr_sw_still(t);
+        fractal.frame_t = t;
+        fractal.frame_start = rdr_sw_now_ms();
+        fractal.frame_scale = (rdr_sw_scaled(fi) && !still) ? fractal.scale : 1.0;
+        SDL_Surface* view = rdr_sw_view(fractal.buffer, &fractal.view, fractal.frame_scale);
+        /* Pipelined frames are presented about a latency later. */
+        double frame_t = (pipelined) ? t + fi.speed * fractal.latency * 1e-3 : t;
+        struct fractal_info frame_fi = fi_at(fi, frame_t);
+        frame_fi.dpp *= (double)fractal.buffer->w / view->w;
+        struct rdr_sw_tuning tuning = rdr_sw_get_tuning(frame_fi);
+        if (preview && view == fractal.buffer) {
+            rdr_sw_preview(last_fi, frame_fi, tuning.wk == rdr_sw_area_worker && fractal.tiled);
+        }
+        rdr_sw_post_mt(tuning.wk, tuning.threads, view, frame_fi, NULL, NULL);
+    }
+    bool front = pipelined && fractal.front_valid;
+    SDL_Surface* buffer = (front) ? fractal.front : fractal.buffer;
+    SDL_Surface* view = (front) ? fractal.front_view : fractal.view;
+    buffer = (view) ? view : buffer;
+    uint32_t* tiled = (front) ? fractal.front_tiled : fractal.tiled;
+    bool tiled_frame = (front) ? fractal.front_tiled_frame : fractal.tiled_frame;
 #else
-    rdr_sw_update(fractal.buffer, fi, t, rdr_sw_area_worker);
+    /* Update main memory buffer. */
+    bool scaled = rdr_sw_scaled(fi) && !rdr_sw_still(t);
+    fractal.frame_scale = (scaled) ? fractal.scale : 1.0;
+    fractal.frame_t = t;
+    SDL_Surface* buffer = rdr_sw_view(fractal.buffer, &fractal.view, fractal.frame_scale);
+    struct fractal_info frame_fi = fi;
+    frame_fi.dpp *= (double)fractal.buffer->w / buffer->w;
+    double start = rdr_sw_now_ms();
+    rdr_sw_render_buffer(buffer, frame_fi, t);
+    if (scaled) {
+        rdr_sw_scale_update(rdr_sw_now_ms() - start);
+    }
+    bool completed = true;
+    uint32_t* tiled = fractal.tiled;
+    bool tiled_frame = fractal.tiled_frame;
 #endif
-    /* Update GPU memory texture. */
+    /* Update GPU memory texture, frames smaller than the window at its top
+     ** left corner. */
+    SDL_Rect rect = {0, 0, buffer->w, buffer->h};
     uint32_t* pixels; int pitch;
-    SDL_LockTexture(fractal.texture, NULL, (void**)&pixels, &pitch);
-    memcpy(pixels, fractal.buffer->pixels, fractal.buffer->h * pitch);
+    SDL_LockTexture(fractal.texture, &rect, (void**)&pixels, &pitch);
+    if (tiled_frame) {
+        rdr_sw_swizzle(pixels, pitch, tiled, buffer->w, buffer->h);
+    } else if (pitch == buffer->pitch) {
+        memcpy(pixels, buffer->pixels, buffer->h * pitch);
+    } else {
+        for (int y = 0; y < buffer->h; y++) {
+            memcpy((uint8_t*)pixels + (size_t)y * pitch,
+                    (uint8_t*)buffer->pixels + (size_t)y * buffer->pitch, buffer->w * 4);
+        }
+    }
     SDL_UnlockTexture(fractal.texture);
     /* Render. */
     SDL_RenderClear(fractal.renderer);
     SDL_SetRenderDrawColor(fractal.renderer, 0, 0, 0, 255);
-    SDL_RenderCopy(fractal.renderer, fractal.texture, NULL, NULL);
+    SDL_RenderCopy(fractal.renderer, fractal.texture, &rect, NULL);
     SDL_RenderPresent(fractal.renderer);
+    fractal.shown = rect;
+    return completed;
 }
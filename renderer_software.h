@@ -1,16 +1,88 @@
 #ifndef H_FRACTAL
 #define H_FRACTAL
 
+#include <stdatomic.h>
 #include <stdbool.h>
 #include <SDL2/SDL.h>
 
+#include "libfractal.h"
 #include "types.h"
+#include "tile_cache.h"
 
 /* renderer interface */
 void rdr_sw_init(SDL_Window* window);
 void rdr_sw_free(void);
 void rdr_sw_resize(int width, int height);
-void rdr_sw_render(struct fractal_info fi, double t, double dt);
+bool rdr_sw_render(struct fractal_info fi, double t, double dt);
+
+/* batch interface */
+/** rdr_sw_job is run by each worker of the pool; workeri is in [0, workerc). */
+typedef void (*rdr_sw_job)(void* arg, int workeri, int workerc);
+/** rdr_sw_pool_init launches the worker pool without a window (batch modes). */
+void rdr_sw_pool_init(void);
+/** rdr_sw_pool_free stops the worker pool launched by rdr_sw_pool_init. */
+void rdr_sw_pool_free(void);
+/** rdr_sw_pool_size returns the number of workers of the pool. */
+int rdr_sw_pool_size(void);
+/** rdr_sw_pool_get returns the libfractal pool the workers run on, NULL
+ ** without one: libfractal contexts opened on it share its threads. */
+struct lf_pool* rdr_sw_pool_get(void);
+/** rdr_sw_run runs job on all workers of the pool and waits for them,
+ ** aborting the frame in flight of rdr_sw_render; on the calling thread
+ ** without a pool. */
+void rdr_sw_run(rdr_sw_job job, void* arg);
+/** rdr_sw_render_buffer renders fi at time t to buf using the pool. */
+void rdr_sw_render_buffer(SDL_Surface* buf, struct fractal_info fi, double t);
+/** rdr_sw_render_lattice renders buf on the calling thread; pixel (x, y) is
+ ** centered on pixel (gx0 + x, gy0 + y) of the lattice of step fi.dpp
+ ** whose origin is (ox, oy) in local coords. */
+void rdr_sw_render_lattice(SDL_Surface* buf, struct fractal_info fi,
+        double ox, double oy, int64_t gx0, int64_t gy0);
+/** rdr_sw_tile_stat is the cost of a tile rendered by a worker. */
+struct rdr_sw_tile_stat {
+    int x, y, w, h;  // pixels of the buffer.
+    int worker;
+    double ms;       // wall time.
+    long long iters; // iterations of the computed pixels.
+    int pixels;      // computed pixels: others are mirrored or cached.
+};
+/** rdr_sw_profile records the cost of a frame (see rdr_sw_profile_buffer). */
+struct rdr_sw_profile {
+    uint32_t* cost; // iterations per pixel, 0 if not computed.
+    struct rdr_sw_tile_stat* tiles;
+    atomic_int tilec;
+    int tilecap;
+};
+/** rdr_sw_profile_buffer renders fi to buf like rdr_sw_render_buffer and
+ ** records its cost to prof: cost must hold buf->w * buf->h values and tiles
+ ** tilecap ones. Tiles are those of the worker rendering fi, in order of
+ ** completion; tiles beyond tilecap are dropped. */
+void rdr_sw_profile_buffer(SDL_Surface* buf, struct fractal_info fi,
+        struct rdr_sw_profile* prof);
+/** rdr_sw_map_color returns the gray level of iter; max_iter is black. */
+uint32_t rdr_sw_map_color(SDL_PixelFormat* format, int iter, int max_iter);
+
+/** rdr_sw_set_cache sets the tile cache used to render static views.
+ ** Must be called before rdr_sw_init; cache is owned by the caller. */
+void rdr_sw_set_cache(struct tile_cache* cache);
+/** rdr_sw_set_histogram enables histogram colouring: gray levels follow the
+ ** cumulative distribution of the iteration counts of the frame.
+ ** Must be called before rdr_sw_init. */
+void rdr_sw_set_histogram(bool histogram);
+/** rdr_sw_set_vsync makes presents wait for the vertical sync of the display
+ ** if the driver supports it. Must be called before rdr_sw_init. */
+void rdr_sw_set_vsync(bool vsync);
+/** rdr_sw_set_fps_target sets the frame rate rdr_sw_render holds for moving
+ ** dynamic fractals, rendering them at 50 to 100% of the window size
+ ** (0: always at the window size). */
+void rdr_sw_set_fps_target(int fps);
+/** rdr_sw_get_scale returns the scale of the window size of the last frame. */
+double rdr_sw_get_scale(void);
+/** rdr_sw_autotune picks the fastest worker & thread count for the generator
+ ** of each of the presets at the current size: tunings are read from the
+ ** autotune-HOST.txt file, missing ones are timed on calibration renders
+ ** and saved. Must be called after rdr_sw_init. */
+void rdr_sw_autotune(struct fractal_info** presets, size_t presetc);
 
 struct renderer sw_renderer = {
     .init   = rdr_sw_init,
@@ -0,0 +1,734 @@
+#define _GNU_SOURCE // memmem, strcasestr.
+#include "server.h"
+
+#include <arpa/inet.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <math.h>
+#include <netinet/in.h>
+#include <poll.h>
+#include <signal.h>
+#include <stdatomic.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <strings.h>
+#include <sys/socket.h>
+#include <time.h>
+#include <unistd.h>
+
+#ifdef MT
+#include <pthread.h>
+#endif
+
+#include "panic.h"
+#include "png.h"
+#include "pyramid.h"
+#include "renderer_software.h"
+
+#define SRV_MAX_CONNS 256
+#define SRV_MAX_REQUEST 4096
+#define SRV_MAX_SIZE 8192
+#define SRV_LATENCIES 4096
+#define SRV_BATCH 64
+
+enum srv_job_type {
+    JOB_TILE,
+    JOB_RENDER,
+};
+
+enum srv_job_state {
+    JOB_QUEUED,
+    JOB_RENDERING,
+    JOB_DONE,
+};
+
+/** srv_job is a render shared by all the requests with the same key. */
+struct srv_job {
+    char key[160];
+    enum srv_job_type type;
+    enum srv_job_state state;
+    /* JOB_TILE */
+    struct pyramid* pyr;
+    int z;
+    long long x, y;
+    /* JOB_RENDER */
+    struct fractal_info fi;
+    int width, height;
+    /* Result. */
+    uint8_t* png;
+    size_t png_len;
+    /** waiters is the number of connections waiting for the result. */
+    int waiters;
+    struct srv_job* next;
+};
+
+struct srv_conn {
+    int fd;
+    char in[SRV_MAX_REQUEST];
+    size_t inlen;
+    char* out;
+    size_t outlen;
+    size_t outpos;
+    struct srv_job* job;
+    bool keep_alive;
+    long long start_ns;
+};
+
+static struct {
+    struct config* cfg;
+    struct pyramid* pyramids;
+    int queue_size;
+    /* Jobs, in arrival order. */
+    struct srv_job* jobs;
+    int queued;
+    bool quit;
+    /* Render thread wakes the I/O loop through this pipe. */
+    int wake[2];
+#ifdef MT
+    pthread_t thread;
+    pthread_mutex_t mutex;
+    pthread_cond_t cond;
+#endif
+    /* Metrics (I/O loop only). */
+    unsigned long long requests;
+    unsigned long long responses[6]; // by status class.
+    unsigned long long renders;
+    unsigned long long coalesced;
+    unsigned long long rejected;
+    double latencies[SRV_LATENCIES]; // ms, ring buffer.
+    unsigned long long latencyc;
+} srv;
+
+static volatile sig_atomic_t srv_interrupted = 0;
+
+static void srv_on_signal(int sig) {
+    (void)sig;
+    srv_interrupted = 1;
+}
+
+static long long srv_now_ns(void) {
+    struct timespec tp;
+    clock_gettime(CLOCK_MONOTONIC, &tp);
+    return (long long)tp.tv_sec * 1000000000LL + tp.tv_nsec;
+}
+
+static void srv_lock(void) {
+#ifdef MT
+    int s = pthread_mutex_lock(&srv.mutex);
+    if (s != 0) panicen(s, "pthread_mutex_lock");
+#endif
+}
+
+static void srv_unlock(void) {
+#ifdef MT
+    int s = pthread_mutex_unlock(&srv.mutex);
+    if (s != 0) panicen(s, "pthread_mutex_unlock");
+#endif
+}
+
+/* Rendering. */
+
+struct srv_batch {
+    struct srv_job* jobs[SRV_BATCH];
+    int jobc;
+    atomic_int next;
+};
+
+/** srv_tile_worker renders & encodes the tiles of a batch, one at a time. */
+static void srv_tile_worker(void* arg, int workeri, int workerc) {
+    (void)workeri;
+    (void)workerc;
+    struct srv_batch* batch = arg;
+    SDL_Surface* tile = NULL;
+    int k;
+    while ((k = atomic_fetch_add(&batch->next, 1)) < batch->jobc) {
+        struct srv_job* job = batch->jobs[k];
+        if (!tile) {
+            tile = SDL_CreateRGBSurface(0, PYRAMID_TILE_SIZE, PYRAMID_TILE_SIZE, 32, 0, 0, 0, 0);
+            if (!tile) {
+                panic("Error: SDL can't create a surface.");
+            }
+        }
+        pyramid_render_tile(job->pyr, tile, job->z, job->x, job->y);
+        png_encode_surface(tile, &job->png, &job->png_len);
+    }
+    if (tile) {
+        SDL_FreeSurface(tile);
+    }
+}
+
+/** srv_render_pending renders queued jobs: a batch of tiles (one tile per
+ ** worker at a time) or a single view (all workers on the view).
+ ** Returns false if there is nothing to render. */
+static bool srv_render_pending(void) {
+    struct srv_batch batch = {0};
+    struct srv_job* view = NULL;
+    srv_lock();
+    for (struct srv_job* job = srv.jobs; job; job = job->next) {
+        if (job->state != JOB_QUEUED) {
+            continue;
+        }
+        if (job->type == JOB_RENDER) {
+            if (batch.jobc == 0) {
+                view = job;
+                job->state = JOB_RENDERING;
+            }
+            break;
+        }
+        job->state = JOB_RENDERING;
+        batch.jobs[batch.jobc++] = job;
+        if (batch.jobc == SRV_BATCH) {
+            break;
+        }
+    }
+    srv_unlock();
+    if (!view && batch.jobc == 0) {
+        return false;
+    }
+    if (view) {
+        SDL_Surface* buf = SDL_CreateRGBSurface(0, view->width, view->height, 32, 0, 0, 0, 0);
+        if (!buf) {
+            panic("Error: SDL can't create a surface.");
+        }
+        rdr_sw_render_buffer(buf, view->fi, 0.0);
+        png_encode_surface(buf, &view->png, &view->png_len);
+        SDL_FreeSurface(buf);
+    } else {
+        atomic_init(&batch.next, 0);
+        rdr_sw_run(srv_tile_worker, &batch);
+    }
+    /* Publish results. */
+    srv_lock();
+    if (view) {
+        view->state = JOB_DONE;
+        srv.queued--;
+    }
+    for (int k = 0; k < batch.jobc; k++) {
+        batch.jobs[k]->state = JOB_DONE;
+        srv.queued--;
+    }
+    srv_unlock();
+    char c = 0;
+    if (write(srv.wake[1], &c, 1) < 0 && errno != EAGAIN) {
+        perror("write");
+    }
+    return true;
+}
+
+#ifdef MT
+/** srv_render_thread renders jobs as they are queued. */
+static void* srv_render_thread(void* arg) {
+    (void)arg;
+    int s = 0;
+    while (true) {
+        s = pthread_mutex_lock(&srv.mutex);
+        if (s != 0) panicen(s, "pthread_mutex_lock");
+        while (srv.queued == 0 && !srv.quit) {
+            s = pthread_cond_wait(&srv.cond, &srv.mutex);
+            if (s != 0) panicen(s, "pthread_cond_wait");
+        }
+        bool quit = srv.quit;
+        s = pthread_mutex_unlock(&srv.mutex);
+        if (s != 0) panicen(s, "pthread_mutex_unlock");
+        if (quit) {
+            break;
+        }
+        srv_render_pending();
+    }
+    return NULL;
+}
+#endif
+
+/* Jobs. */
+
+/** srv_submit attaches conn to the pending job of key or queues a new job.
+ ** Returns false if the queue is full. */
+static bool srv_submit(struct srv_conn* conn, struct srv_job* model) {
+    srv_lock();
+    for (struct srv_job* job = srv.jobs; job; job = job->next) {
+        if (job->state != JOB_DONE && strcmp(job->key, model->key) == 0) {
+            job->waiters++;
+            conn->job = job;
+            srv.coalesced++;
+            srv_unlock();
+            return true;
+        }
+    }
+    if (srv.queued >= srv.queue_size) {
+        srv_unlock();
+        return false;
+    }
+    struct srv_job* job = malloc(sizeof(struct srv_job));
+    if (!job) {
+        panic("Error: can't allocate job.");
+    }
+    *job = *model;
+    job->state = JOB_QUEUED;
+    job->png = NULL;
+    job->png_len = 0;
+    job->waiters = 1;
+    job->next = NULL;
+    struct srv_job** tail = &srv.jobs;
+    while (*tail) {
+        tail = &(*tail)->next;
+    }
+    *tail = job;
+    srv.queued++;
+    srv.renders++;
+    conn->job = job;
+#ifdef MT
+    pthread_cond_signal(&srv.cond);
+#endif
+    srv_unlock();
+    return true;
+}
+
+/** srv_release detaches a waiter from job; done jobs without waiters are freed. */
+static void srv_release(struct srv_job* job) {
+    srv_lock();
+    job->waiters--;
+    if (job->waiters == 0 && job->state == JOB_DONE) {
+        struct srv_job** link = &srv.jobs;
+        while (*link != job) {
+            link = &(*link)->next;
+        }
+        *link = job->next;
+        free(job->png);
+        free(job);
+    }
+    srv_unlock();
+}
+
+/* HTTP. */
+
+static const char* srv_status_text(int status) {
+    switch (status) {
+    case 200: return "OK";
+    case 400: return "Bad Request";
+    case 404: return "Not Found";
+    case 405: return "Method Not Allowed";
+    case 500: return "Internal Server Error";
+    case 503: return "Service Unavailable";
+    default:  return "Unknown";
+    }
+}
+
+/** srv_respond sets the response of conn & records its latency. */
+static void srv_respond(struct srv_conn* conn, int status, const char* type,
+        const void* body, size_t len) {
+    char head[256];
+    int headlen = snprintf(head, sizeof(head),
+            "HTTP/1.1 %d %s\r\n"
+            "Content-Type: %s\r\n"
+            "Content-Length: %zu\r\n"
+            "%s"
+            "Connection: %s\r\n\r\n",
+            status, srv_status_text(status), type, len,
+            (status == 503) ? "Retry-After: 1\r\n" : "",
+            (conn->keep_alive) ? "keep-alive" : "close");
+    conn->out = malloc(headlen + len);
+    if (!conn->out) {
+        panic("Error: can't allocate response.");
+    }
+    memcpy(conn->out, head, headlen);
+    if (len) {
+        memcpy(conn->out + headlen, body, len);
+    }
+    conn->outlen = headlen + len;
+    conn->outpos = 0;
+    srv.responses[(status / 100) % 6]++;
+    srv.latencies[srv.latencyc++ % SRV_LATENCIES] = (srv_now_ns() - conn->start_ns) * 1e-6;
+}
+
+static void srv_respond_text(struct srv_conn* conn, int status, const char* text) {
+    srv_respond(conn, status, "text/plain", text, strlen(text));
+}
+
+static int srv_cmp_double(const void* a, const void* b) {
+    double da = *(const double*)a, db = *(const double*)b;
+    return (da > db) - (da < db);
+}
+
+static void srv_metrics(struct srv_conn* conn) {
+    /* The render thread updates the queue under the lock. */
+    srv_lock();
+    size_t n = (srv.latencyc < SRV_LATENCIES) ? srv.latencyc : SRV_LATENCIES;
+    double sorted[SRV_LATENCIES];
+    memcpy(sorted, srv.latencies, n * sizeof(double));
+    qsort(sorted, n, sizeof(double), srv_cmp_double);
+    const double quantiles[] = { 0.5, 0.9, 0.99, 1.0 };
+    char body[2048];
+    int len = snprintf(body, sizeof(body),
+            "fractal_requests_total %llu\n"
+            "fractal_responses_total{code=\"2xx\"} %llu\n"
+            "fractal_responses_total{code=\"4xx\"} %llu\n"
+            "fractal_responses_total{code=\"5xx\"} %llu\n"
+            "fractal_renders_total %llu\n"
+            "fractal_coalesced_total %llu\n"
+            "fractal_rejected_total %llu\n"
+            "fractal_queue_depth %d\n",
+            srv.requests, srv.responses[2], srv.responses[4], srv.responses[5],
+            srv.renders, srv.coalesced, srv.rejected, srv.queued);
+    for (size_t q = 0; q < sizeof(quantiles)/sizeof(quantiles[0]); q++) {
+        double val = (n) ? sorted[(size_t)(quantiles[q] * (n - 1))] : 0.0;
+        len += snprintf(body + len, sizeof(body) - len,
+                "fractal_latency_ms{quantile=\"%g\"} %.3lf\n", quantiles[q], val);
+    }
+    srv_unlock();
+    srv_respond(conn, 200, "text/plain", body, len);
+}
+
+/** srv_query_double reads key in query string query to dest. */
+static bool srv_query_double(const char* query, const char* key, double* dest) {
+    size_t keylen = strlen(key);
+    for (const char* p = query; p && *p; p = strchr(p, '&'), p = (p) ? p + 1 : NULL) {
+        if (strncmp(p, key, keylen) == 0 && p[keylen] == '=') {
+            char* end;
+            double val = strtod(p + keylen + 1, &end);
+            if (end == p + keylen + 1 || (*end && *end != '&')) {
+                return false;
+            }
+            *dest = val;
+            return true;
+        }
+    }
+    return false;
+}
+
+/** srv_route answers the request for target (path & query) of conn. */
+static void srv_route(struct srv_conn* conn, char* target) {
+    struct config* cfg = srv.cfg;
+    struct srv_job model;
+    memset(&model, 0, sizeof(model));
+    int preset, z, end = 0;
+    long long x, y;
+    if (strcmp(target, "/metrics") == 0) {
+        srv_metrics(conn);
+        return;
+    }
+    if (sscanf(target, "/tile/%d/%d/%lld/%lld.png%n", &preset, &z, &x, &y, &end) == 4
+            && target[end] == '\0') {
+        if (preset < 0 || (size_t)preset >= cfg->presetc || z < 0 || z > 30
+                || x < 0 || y < 0 || x >= (1LL << z) || y >= (1LL << z)) {
+            srv_respond_text(conn, 404, "No such tile.\n");
+            return;
+        }
+        model.type = JOB_TILE;
+        model.pyr = &srv.pyramids[preset];
+        model.z = z;
+        model.x = x;
+        model.y = y;
+        snprintf(model.key, sizeof(model.key), "tile/%d/%d/%lld/%lld", preset, z, x, y);
+    } else if (strncmp(target, "/render?", 8) == 0) {
+        const char* query = target + 8;
+        double cx, cy, dpp;
+        double w = cfg->width, h = cfg->height, iter = -1, p = cfg->preset;
+        if (!srv_query_double(query, "cx", &cx)
+                || !srv_query_double(query, "cy", &cy)
+                || !srv_query_double(query, "dpp", &dpp)
+                || !isfinite(cx) || !isfinite(cy) || !isfinite(dpp) || !(dpp > 0)) {
+            srv_respond_text(conn, 400, "Parameters cx, cy & dpp are required.\n");
+            return;
+        }
+        srv_query_double(query, "w", &w);
+        srv_query_double(query, "h", &h);
+        srv_query_double(query, "iter", &iter);
+        srv_query_double(query, "preset", &p);
+        /* Negated so that NaNs are rejected too. */
+        if (!(w >= 1 && w <= SRV_MAX_SIZE) || !(h >= 1 && h <= SRV_MAX_SIZE)
+                || !(p >= 0 && p < cfg->presetc)) {
+            srv_respond_text(conn, 400, "Invalid size or preset.\n");
+            return;
+        }
+        model.type = JOB_RENDER;
+        model.fi = *(cfg->presets[(size_t)p]);
+        model.fi.cx = cx;
+        model.fi.cy = cy;
+        model.fi.dpp = dpp;
+        if (iter > 0) {
+            model.fi.max_iter = (iter < 1e9) ? (int)iter : 1000000000;
+        }
+        model.width = (int)w;
+        model.height = (int)h;
+        snprintf(model.key, sizeof(model.key), "render/%d/%a/%a/%a/%d/%d/%d",
+                (int)p, cx, cy, dpp, model.fi.max_iter, model.width, model.height);
+    } else {
+        srv_respond_text(conn, 404, "Not found.\n");
+        return;
+    }
+    if (!srv_submit(conn, &model)) {
+        srv.rejected++;
+        srv_respond_text(conn, 503, "Render queue is full.\n");
+    }
+}
+
+/** srv_parse parses a complete request of conn, if any.
+ ** Returns false if the connection must be closed. */
+static bool srv_parse(struct srv_conn* conn) {
+    char* end = memmem(conn->in, conn->inlen, "\r\n\r\n", 4);
+    if (!end) {
+        if (conn->inlen == sizeof(conn->in)) {
+            conn->keep_alive = false;
+            conn->start_ns = srv_now_ns();
+            srv_respond_text(conn, 400, "Request is too large.\n");
+        }
+        return true;
+    }
+    *end = '\0';
+    size_t reqlen = (end - conn->in) + 4;
+    srv.requests++;
+    conn->start_ns = srv_now_ns();
+    char method[8], target[1024], version[16];
+    if (sscanf(conn->in, "%7s %1023s %15s", method, target, version) != 3) {
+        conn->keep_alive = false;
+        srv_respond_text(conn, 400, "Malformed request.\n");
+    } else {
+        /* HTTP/1.1 keeps connections alive by default. */
+        conn->keep_alive = strcmp(version, "HTTP/1.1") == 0
+            && !strcasestr(conn->in, "\r\nConnection: close");
+        if (strcmp(method, "GET") != 0) {
+            srv_respond_text(conn, 405, "Only GET is supported.\n");
+        } else {
+            srv_route(conn, target);
+        }
+    }
+    /* Keep pipelined requests. */
+    memmove(conn->in, conn->in + reqlen, conn->inlen - reqlen);
+    conn->inlen -= reqlen;
+    return true;
+}
+
+static void srv_close(struct srv_conn* conn) {
+    if (conn->job) {
+        srv_release(conn->job);
+    }
+    free(conn->out);
+    close(conn->fd);
+    memset(conn, 0, sizeof(struct srv_conn));
+    conn->fd = -1;
+}
+
+/** srv_sweep frees done jobs left without waiters (closed connections). */
+static void srv_sweep(void) {
+    srv_lock();
+    struct srv_job** link = &srv.jobs;
+    while (*link) {
+        struct srv_job* job = *link;
+        if (job->state == JOB_DONE && job->waiters == 0) {
+            *link = job->next;
+            free(job->png);
+            free(job);
+        } else {
+            link = &job->next;
+        }
+    }
+    srv_unlock();
+}
+
+/** srv_dispatch answers connections whose job is done. */
+static void srv_dispatch(struct srv_conn* conns) {
+    for (int c = 0; c < SRV_MAX_CONNS; c++) {
+        struct srv_conn* conn = &conns[c];
+        if (conn->fd < 0 || !conn->job) {
+            continue;
+        }
+        srv_lock();
+        bool done = conn->job->state == JOB_DONE;
+        srv_unlock();
+        if (!done) {
+            continue;
+        }
+        struct srv_job* job = conn->job;
+        conn->job = NULL;
+        if (job->png) {
+            srv_respond(conn, 200, "image/png", job->png, job->png_len);
+        } else {
+            srv_respond_text(conn, 500, "Render failed.\n");
+        }
+        srv_release(job);
+    }
+    srv_sweep();
+}
+
+bool server_run(struct config* cfg, int port, int queue_size) {
+    memset(&srv, 0, sizeof(srv));
+    srv.cfg = cfg;
+    srv.queue_size = (queue_size > 0) ? queue_size : 1;
+    srv.pyramids = calloc(cfg->presetc, sizeof(struct pyramid));
+    for (size_t p = 0; p < cfg->presetc; p++) {
+        pyramid_init(&srv.pyramids[p], *(cfg->presets[p]), cfg->width, cfg->height);
+    }
+    /* Listening socket. */
+    int lfd = socket(AF_INET, SOCK_STREAM, 0);
+    if (lfd < 0) {
+        perror("socket");
+        return false;
+    }
+    int on = 1;
+    setsockopt(lfd, SOL_SOCKET, SO_REUSEADDR, &on, sizeof(on));
+    struct sockaddr_in addr = {0};
+    addr.sin_family = AF_INET;
+    addr.sin_port = htons(port);
+    addr.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+    if (bind(lfd, (struct sockaddr*)&addr, sizeof(addr)) != 0 || listen(lfd, 64) != 0) {
+        fprintf(stderr, "Can't listen on localhost:%d: %s.\n", port, strerror(errno));
+        close(lfd);
+        return false;
+    }
+    fcntl(lfd, F_SETFL, O_NONBLOCK);
+    if (pipe(srv.wake) != 0) {
+        perror("pipe");
+        close(lfd);
+        return false;
+    }
+    fcntl(srv.wake[0], F_SETFL, O_NONBLOCK);
+    fcntl(srv.wake[1], F_SETFL, O_NONBLOCK);
+    /* Signals. */
+    struct sigaction sa = {0};
+    sa.sa_handler = srv_on_signal;
+    sigaction(SIGINT, &sa, NULL);
+    sigaction(SIGTERM, &sa, NULL);
+    signal(SIGPIPE, SIG_IGN);
+#ifdef MT
+    int s = pthread_mutex_init(&srv.mutex, NULL);
+    if (s != 0) panicen(s, "pthread_mutex_init");
+    s = pthread_cond_init(&srv.cond, NULL);
+    if (s != 0) panicen(s, "pthread_cond_init");
+    s = pthread_create(&srv.thread, NULL, srv_render_thread, NULL);
+    if (s != 0) panicen(s, "pthread_create");
+#endif
+    fprintf(stdout, "> serving on http://localhost:%d/\n", port);
+
+    static struct srv_conn conns[SRV_MAX_CONNS];
+    for (int c = 0; c < SRV_MAX_CONNS; c++) {
+        memset(&conns[c], 0, sizeof(struct srv_conn));
+        conns[c].fd = -1;
+    }
+    struct pollfd pfds[SRV_MAX_CONNS + 2];
+    while (!srv_interrupted) {
+        /* Poll listening socket, wake pipe & connections. */
+        int pfdc = 0;
+        pfds[pfdc++] = (struct pollfd){ .fd = lfd, .events = POLLIN };
+        pfds[pfdc++] = (struct pollfd){ .fd = srv.wake[0], .events = POLLIN };
+        int map[SRV_MAX_CONNS + 2];
+        for (int c = 0; c < SRV_MAX_CONNS; c++) {
+            if (conns[c].fd < 0) {
+                continue;
+            }
+            short events = (conns[c].out) ? POLLOUT : (conns[c].job) ? 0 : POLLIN;
+            map[pfdc] = c;
+            pfds[pfdc++] = (struct pollfd){ .fd = conns[c].fd, .events = events };
+        }
+#ifdef MT
+        int timeout = -1;
+#else
+        int timeout = (srv.queued) ? 0 : -1;
+#endif
+        if (poll(pfds, pfdc, timeout) < 0) {
+            if (errno == EINTR) {
+                continue;
+            }
+            perror("poll");
+            break;
+        }
+        /* New connections. */
+        if (pfds[0].revents & POLLIN) {
+            int fd;
+            while ((fd = accept(lfd, NULL, NULL)) >= 0) {
+                int c = 0;
+                while (c < SRV_MAX_CONNS && conns[c].fd >= 0) {
+                    c++;
+                }
+                if (c == SRV_MAX_CONNS) {
+                    close(fd);
+                    continue;
+                }
+                fcntl(fd, F_SETFL, O_NONBLOCK);
+                conns[c].fd = fd;
+            }
+        }
+        /* Finished renders. */
+        if (pfds[1].revents & POLLIN) {
+            char buf[64];
+            while (read(srv.wake[0], buf, sizeof(buf)) > 0) {
+            }
+        }
+        /* Connections I/O. */
+        for (int p = 2; p < pfdc; p++) {
+            struct srv_conn* conn = &conns[map[p]];
+            if (pfds[p].revents & (POLLERR|POLLHUP|POLLNVAL) && !(pfds[p].revents & POLLIN)) {
+                srv_close(conn);
+                continue;
+            }
+            if (pfds[p].revents & POLLIN) {
+                ssize_t n = read(conn->fd, conn->in + conn->inlen, sizeof(conn->in) - conn->inlen);
+                if (n <= 0) {
+                    srv_close(conn);
+                    continue;
+                }
+                conn->inlen += n;
+            }
+            if (pfds[p].revents & POLLOUT) {
+                ssize_t n = send(conn->fd, conn->out + conn->outpos,
+                        conn->outlen - conn->outpos, MSG_NOSIGNAL);
+                if (n < 0 && errno != EAGAIN) {
+                    srv_close(conn);
+                    continue;
+                }
+                conn->outpos += (n > 0) ? n : 0;
+                if (conn->outpos == conn->outlen) {
+                    free(conn->out);
+                    conn->out = NULL;
+                    if (!conn->keep_alive) {
+                        srv_close(conn);
+                        continue;
+                    }
+                }
+            }
+        }
+#ifndef MT
+        srv_render_pending();
+#endif
+        srv_dispatch(conns);
+        /* Parse requests of idle connections. */
+        for (int c = 0; c < SRV_MAX_CONNS; c++) {
+            if (conns[c].fd >= 0 && !conns[c].out && !conns[c].job && conns[c].inlen) {
+                srv_parse(&conns[c]);
+            }
+        }
+        srv_dispatch(conns);
+    }
+
+    /* Shutdown. */
+    fprintf(stdout, "> server stopped\n");
+#ifdef MT
+    srv_lock();
+    srv.quit = true;
+    pthread_cond_signal(&srv.cond);
+    srv_unlock();
+    s = pthread_join(srv.thread, NULL);
+    if (s != 0) panicen(s, "pthread_join");
+#endif
+    for (int c = 0; c < SRV_MAX_CONNS; c++) {
+        if (conns[c].fd >= 0) {
+            srv_close(&conns[c]);
+        }
+    }
+    while (srv.jobs) {
+        struct srv_job* job = srv.jobs;
+        srv.jobs = job->next;
+        free(job->png);
+        free(job);
+    }
+#ifdef MT
+    pthread_mutex_destroy(&srv.mutex);
+    pthread_cond_destroy(&srv.cond);
+#endif
+    close(srv.wake[0]);
+    close(srv.wake[1]);
+    close(lfd);
+    free(srv.pyramids);
+    return true;
+}
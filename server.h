@@ -0,0 +1,19 @@
+#ifndef _H_SERVER_
+#define _H_SERVER_
+
+#include <stdbool.h>
+
+#include "config.h"
+
+/** server_run serves the presets of cfg over HTTP/1.1 on localhost:port until
+ ** SIGINT or SIGTERM is received; rendering uses the software renderer pool
+ ** (see rdr_sw_pool_init). Endpoints:
+ **   /tile/{preset}/{z}/{x}/{y}.png  tile of the pyramid of a preset;
+ **   /render?cx=&cy=&dpp=[&w=&h=&iter=&preset=]  view of a preset;
+ **   /metrics  request counters & latency percentiles.
+ ** Identical requests are coalesced while their render is pending; at most
+ ** queue_size distinct renders are pending, further ones get 503.
+ ** Returns false if the server can't start. */
+bool server_run(struct config* cfg, int port, int queue_size);
+
+#endif
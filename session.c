@@ -0,0 +1,210 @@
+#include "session.h"
+
+#include <math.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <SDL2/SDL.h>
+
+#include "panic.h"
+#include "renderer_software.h"
+
+/** SESSION_HEADER is the first line of session files, then SESSION_OPTIONS
+ ** (v2); views follow, one per line: ms width height generator dynamic speed
+ ** max_iter cx cy dpp jx jy n t scale (v1: without scale). */
+#define SESSION_HEADER "# fractal session v2\n"
+/** SESSION_OPTIONS is the format of the renderer options line; the cache file
+ ** ends the line, "-" if none. */
+#define SESSION_OPTIONS "# options software %d histogram %d auto_iter %d fps_target %d cache_size %d cache_file "
+
+struct session* session_open(const char* path, struct session_options opts) {
+    FILE* fp = fopen(path, "w");
+    if (!fp) {
+        fprintf(stderr, "Can't create session file `%s`.\n", path);
+        return NULL;
+    }
+    fputs(SESSION_HEADER, fp);
+    fprintf(fp, SESSION_OPTIONS "%s\n", opts.software, opts.histogram, opts.auto_iter,
+            opts.fps_target, opts.cache_size, (opts.cache_file) ? opts.cache_file : "-");
+    struct session* ses = calloc(1, sizeof(struct session));
+    ses->fp = fp;
+    return ses;
+}
+
+void session_record(struct session* ses, uint32_t ms, int width, int height,
+        struct fractal_info fi, double t, double scale) {
+    if (ses->any && width == ses->width && height == ses->height
+            && fi_equal(fi, ses->fi) && fi.speed == ses->fi.speed && t == ses->t
+            && scale == ses->scale) {
+        return;
+    }
+    if (!ses->any) {
+        ses->start = ms;
+    }
+    ses->any = true;
+    ses->width = width;
+    ses->height = height;
+    ses->fi = fi;
+    ses->t = t;
+    ses->scale = scale;
+    /* %.17g round-trips doubles. */
+    fprintf(ses->fp, "%u %d %d %d %d %.17g %d %.17g %.17g %.17g %.17g %.17g %d %.17g %.17g\n",
+            ms - ses->start, width, height, fi.generator, fi.dynamic, fi.speed, fi.max_iter,
+            fi.cx, fi.cy, fi.dpp, fi.jx, fi.jy, fi.n, t, scale);
+}
+
+void session_close(struct session* ses) {
+    if (!ses) {
+        return;
+    }
+    fclose(ses->fp);
+    free(ses);
+}
+
+bool session_read_options(const char* path, struct session_options* opts) {
+    FILE* fp = fopen(path, "r");
+    if (!fp) {
+        return false;
+    }
+    char line[512];
+    bool found = false;
+    while (!found && fgets(line, sizeof(line), fp) && line[0] == '#') {
+        struct session_options o = {0};
+        int end = 0;
+        if (sscanf(line, SESSION_OPTIONS "%n", &o.software, &o.histogram, &o.auto_iter,
+                    &o.fps_target, &o.cache_size, &end) != 5 || end == 0) {
+            continue;
+        }
+        line[strcspn(line, "\n")] = '\0';
+        const char* cache_file = line + end;
+        o.cache_file = (strcmp(cache_file, "-") != 0) ? strdup(cache_file) : NULL;
+        *opts = o;
+        found = true;
+    }
+    fclose(fp);
+    return found;
+}
+
+/** session_view is a recorded view & its replay time. */
+struct session_view {
+    unsigned ms;
+    int width, height;
+    struct fractal_info fi;
+    double t;
+    double scale;
+    double render_ms;
+};
+
+/** session_read reads the views of the session file path to *views.
+ ** Returns their count, -1 on error. */
+static int session_read(const char* path, struct session_view** views) {
+    FILE* fp = fopen(path, "r");
+    if (!fp) {
+        fprintf(stderr, "Can't open session file `%s`.\n", path);
+        return -1;
+    }
+    char line[512];
+    int viewc = 0, lineno = 0;
+    *views = NULL;
+    while (fgets(line, sizeof(line), fp)) {
+        lineno++;
+        if (line[0] == '#' || line[0] == '\n') {
+            continue;
+        }
+        struct session_view v = {.scale = 1.0};
+        int gen, dynamic;
+        int fields = sscanf(line, "%u %d %d %d %d %lf %d %lf %lf %lf %lf %lf %d %lf %lf",
+                    &v.ms, &v.width, &v.height, &gen, &dynamic, &v.fi.speed, &v.fi.max_iter,
+                    &v.fi.cx, &v.fi.cy, &v.fi.dpp, &v.fi.jx, &v.fi.jy, &v.fi.n, &v.t, &v.scale);
+        if (fields < 14 || v.scale <= 0.0 || v.scale > 1.0 || v.width <= 0 || v.height <= 0 || gen < GEN_MANDELBROT || gen > GEN_NEBULABROT) {
+            fprintf(stderr, "Can't parse line %d of session file `%s`.\n", lineno, path);
+            fclose(fp);
+            free(*views);
+            return -1;
+        }
+        v.fi.generator = (enum generator)gen;
+        v.fi.dynamic = dynamic != 0;
+        *views = realloc(*views, (viewc + 1) * sizeof(struct session_view));
+        (*views)[viewc++] = v;
+    }
+    fclose(fp);
+    return viewc;
+}
+
+static int cmp_double(const void* a, const void* b) {
+    double x = *(const double*)a, y = *(const double*)b;
+    return (x > y) - (x < y);
+}
+
+bool session_replay(const char* path, const char* output) {
+    struct session_view* views = NULL;
+    int viewc = session_read(path, &views);
+    if (viewc < 0) {
+        return false;
+    }
+    fprintf(stdout, "> replaying %d views of `%s` with %d workers\n",
+            viewc, path, rdr_sw_pool_size());
+    SDL_Surface* buf = NULL;
+    double total = 0.0;
+    int slowest = 0;
+    for (int i = 0; i < viewc; i++) {
+        struct session_view* v = &views[i];
+        /* Scaled frames like rdr_sw_render: the view at a coarser dpp. */
+        int width = (int)lround(v->width * v->scale), height = (int)lround(v->height * v->scale);
+        width = (width > 0) ? width : 1;
+        height = (height > 0) ? height : 1;
+        struct fractal_info fi = v->fi;
+        fi.dpp *= (double)v->width / width;
+        if (!buf || buf->w != width || buf->h != height) {
+            SDL_FreeSurface(buf);
+            buf = SDL_CreateRGBSurface(0, width, height, 32, 0, 0, 0, 0);
+            if (!buf) {
+                panic("Error: SDL can't create a surface.");
+            }
+        }
+        struct timespec start, end;
+        clock_gettime(CLOCK_MONOTONIC, &start);
+        rdr_sw_render_buffer(buf, fi, v->t);
+        clock_gettime(CLOCK_MONOTONIC, &end);
+        v->render_ms = (end.tv_sec - start.tv_sec) * 1e3 + (end.tv_nsec - start.tv_nsec) * 1e-6;
+        total += v->render_ms;
+        if (v->render_ms > views[slowest].render_ms) {
+            slowest = i;
+        }
+        fprintf(stdout, "> view %d at %u ms: %dx%d, generator %d, max_iter %d, dpp %g: %.2f ms\n",
+                i, v->ms, width, height, v->fi.generator, v->fi.max_iter, v->fi.dpp,
+                v->render_ms);
+    }
+    SDL_FreeSurface(buf);
+    /* Summary. */
+    if (viewc > 0) {
+        double* times = malloc(viewc * sizeof(double));
+        for (int i = 0; i < viewc; i++) {
+            times[i] = views[i].render_ms;
+        }
+        qsort(times, viewc, sizeof(double), cmp_double);
+        fprintf(stdout, "> %d views in %.3f s: mean %.2f ms, p50 %.2f ms, p95 %.2f ms, max %.2f ms (view %d)\n",
+                viewc, total * 1e-3, total / viewc, times[viewc / 2],
+                times[(int)(viewc * 0.95)], times[viewc - 1], slowest);
+        free(times);
+    }
+    /* Render times. */
+    bool ok = true;
+    if (output) {
+        FILE* fp = fopen(output, "w");
+        if (fp) {
+            fprintf(fp, "view,ms,width,height,generator,max_iter,dpp,render_ms\n");
+            for (int i = 0; i < viewc; i++) {
+                struct session_view* v = &views[i];
+                fprintf(fp, "%d,%u,%d,%d,%d,%d,%.17g,%.3f\n", i, v->ms, v->width, v->height,
+                        v->fi.generator, v->fi.max_iter, v->fi.dpp, v->render_ms);
+            }
+            fclose(fp);
+        } else {
+            fprintf(stderr, "Can't write render times to `%s`.\n", output);
+            ok = false;
+        }
+    }
+    free(views);
+    return ok;
+}
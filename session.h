@@ -0,0 +1,57 @@
+#ifndef _H_SESSION_
+#define _H_SESSION_
+
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdio.h>
+
+#include "types.h"
+
+/** session_options are the renderer options of a session, saved in the
+ ** header of its file. */
+struct session_options {
+    int software;
+    int histogram;
+    int auto_iter; // recorded views have the estimated max_iter.
+    int fps_target;
+    char* cache_file; // NULL: no tile cache.
+    int cache_size; // MiB.
+};
+
+/** session records the views of an interactive session (see session_open). */
+struct session {
+    FILE* fp;
+    bool any;
+    uint32_t start; // ms of the first view.
+    /* Last recorded view. */
+    int width, height;
+    struct fractal_info fi;
+    double t;
+    double scale;
+};
+
+/** session_open creates the session file path with the renderer options
+ ** opts; returns NULL on error. */
+struct session* session_open(const char* path, struct session_options opts);
+/** session_record appends the view rendered (fi at time t in a width x
+ ** height window, frames at scale times its size) at ms milliseconds to ses,
+ ** unless it is the last recorded one; times are saved relative to the first
+ ** view. */
+void session_record(struct session* ses, uint32_t ms, int width, int height,
+        struct fractal_info fi, double t, double scale);
+/** session_close closes & frees ses. */
+void session_close(struct session* ses);
+
+/** session_read_options reads the renderer options of the session file path
+ ** to opts. Returns false if the file has none (sessions of older versions),
+ ** opts is left untouched then; otherwise caller is responsible for freeing
+ ** opts->cache_file. */
+bool session_read_options(const char* path, struct session_options* opts);
+/** session_replay renders each view of the session file path with the
+ ** software renderer pool (see rdr_sw_pool_init), at the scale it was
+ ** rendered at, as fast as possible, and
+ ** prints their render times; output, if not NULL, is set to a CSV file of
+ ** them. Returns false on error. */
+bool session_replay(const char* path, const char* output);
+
+#endif
@@ -0,0 +1,348 @@
+#include "tile_cache.h"
+
+#include <fcntl.h>
+#include <math.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#ifdef MT
+#include <pthread.h>
+#endif
+
+#include "panic.h"
+
+#define TC_MAGIC "FRTCACHE"
+#define TC_VERSION 1
+#define TC_TILE_PIXELS (TC_TILE_SIZE * TC_TILE_SIZE)
+#define TC_TILE_BYTES (TC_TILE_PIXELS * sizeof(int32_t))
+
+/* Cache file layout: header, then slotc slots, then slotc tiles of data. */
+struct tc_header {
+    char     magic[8];
+    uint32_t version;
+    uint32_t tile_size;
+    uint64_t slotc;
+    /** clock is incremented on each access; it orders slots by last use. */
+    uint64_t clock;
+};
+
+struct tc_slot {
+    struct tc_key key;
+    /** used is the clock at the last access of the slot, 0 if empty. */
+    uint64_t used;
+};
+
+struct tile_cache {
+    int fd;
+    void* map;
+    size_t map_size;
+    struct tc_header* header;
+    struct tc_slot* slots;
+    int32_t* data;
+    int32_t slotc;
+    /* Hash index: each bucket is a chain of slots. */
+    int32_t bucketc; // power of 2.
+    int32_t* buckets;
+    int32_t* chain;
+    /* LRU list: lru_head is the most recently used slot, lru_tail the victim. */
+    int32_t* lru_prev;
+    int32_t* lru_next;
+    int32_t lru_head;
+    int32_t lru_tail;
+    struct tc_stats stats;
+#ifdef MT
+    pthread_mutex_t mutex;
+#endif
+};
+
+/** tc_hash is FNV-1a over the key bytes. */
+static uint64_t tc_hash(const struct tc_key* key) {
+    const unsigned char* p = (const unsigned char*)key;
+    uint64_t h = 14695981039346656037ULL;
+    for (size_t i = 0; i < sizeof(struct tc_key); i++) {
+        h ^= p[i];
+        h *= 1099511628211ULL;
+    }
+    return h;
+}
+
+static int32_t* tc_bucket(struct tile_cache* cache, const struct tc_key* key) {
+    return &cache->buckets[tc_hash(key) & (uint64_t)(cache->bucketc - 1)];
+}
+
+static int32_t tc_find(struct tile_cache* cache, const struct tc_key* key) {
+    for (int32_t s = *tc_bucket(cache, key); s >= 0; s = cache->chain[s]) {
+        if (memcmp(&cache->slots[s].key, key, sizeof(struct tc_key)) == 0) {
+            return s;
+        }
+    }
+    return -1;
+}
+
+static void tc_index_insert(struct tile_cache* cache, int32_t s) {
+    int32_t* bucket = tc_bucket(cache, &cache->slots[s].key);
+    cache->chain[s] = *bucket;
+    *bucket = s;
+}
+
+static void tc_index_remove(struct tile_cache* cache, int32_t s) {
+    int32_t* link = tc_bucket(cache, &cache->slots[s].key);
+    while (*link >= 0 && *link != s) {
+        link = &cache->chain[*link];
+    }
+    if (*link == s) {
+        *link = cache->chain[s];
+    }
+    cache->chain[s] = -1;
+}
+
+static void tc_lru_unlink(struct tile_cache* cache, int32_t s) {
+    int32_t p = cache->lru_prev[s], n = cache->lru_next[s];
+    if (p >= 0) cache->lru_next[p] = n; else cache->lru_head = n;
+    if (n >= 0) cache->lru_prev[n] = p; else cache->lru_tail = p;
+}
+
+static void tc_lru_push_front(struct tile_cache* cache, int32_t s) {
+    cache->lru_prev[s] = -1;
+    cache->lru_next[s] = cache->lru_head;
+    if (cache->lru_head >= 0) cache->lru_prev[cache->lru_head] = s;
+    cache->lru_head = s;
+    if (cache->lru_tail < 0) cache->lru_tail = s;
+}
+
+/** tc_touch marks slot s as the most recently used. */
+static void tc_touch(struct tile_cache* cache, int32_t s) {
+    cache->slots[s].used = ++cache->header->clock;
+    tc_lru_unlink(cache, s);
+    tc_lru_push_front(cache, s);
+}
+
+struct tc_order {
+    uint64_t used;
+    int32_t slot;
+};
+
+static int tc_order_cmp(const void* a, const void* b) {
+    uint64_t ua = ((const struct tc_order*)a)->used;
+    uint64_t ub = ((const struct tc_order*)b)->used;
+    return (ua < ub) - (ua > ub); // Most recent first, empty slots last.
+}
+
+/** tc_build_index rebuilds the hash index and LRU list from the slots table. */
+static void tc_build_index(struct tile_cache* cache) {
+    for (int32_t b = 0; b < cache->bucketc; b++) {
+        cache->buckets[b] = -1;
+    }
+    struct tc_order* order = calloc(cache->slotc, sizeof(struct tc_order));
+    if (!order) {
+        panic("Error: can't allocate tile cache index.");
+    }
+    for (int32_t s = 0; s < cache->slotc; s++) {
+        cache->chain[s] = -1;
+        order[s].used = cache->slots[s].used;
+        order[s].slot = s;
+        if (cache->slots[s].used) {
+            tc_index_insert(cache, s);
+        }
+    }
+    qsort(order, cache->slotc, sizeof(struct tc_order), tc_order_cmp);
+    cache->lru_head = cache->lru_tail = -1;
+    for (int32_t i = cache->slotc - 1; i >= 0; i--) {
+        tc_lru_push_front(cache, order[i].slot);
+    }
+    free(order);
+}
+
+struct tile_cache* tc_open(const char* filename, size_t size_limit) {
+    const size_t slot_size = sizeof(struct tc_slot) + TC_TILE_BYTES;
+    if (size_limit < sizeof(struct tc_header) + slot_size) {
+        fprintf(stderr, "Tile cache size limit is too small (%zu bytes).\n", size_limit);
+        return NULL;
+    }
+    size_t slotc = (size_limit - sizeof(struct tc_header)) / slot_size;
+    if (slotc > INT32_MAX / 2) {
+        slotc = INT32_MAX / 2;
+    }
+    size_t map_size = sizeof(struct tc_header) + slotc * slot_size;
+    /* Open or create the cache file. */
+    int fd = open(filename, O_RDWR|O_CREAT, 0644);
+    if (fd < 0) {
+        fprintf(stderr, "Can't open tile cache `%s`.\n", filename);
+        return NULL;
+    }
+    struct stat st;
+    if (fstat(fd, &st) != 0) {
+        close(fd);
+        fprintf(stderr, "Can't stat tile cache `%s`.\n", filename);
+        return NULL;
+    }
+    bool reset = ((size_t)st.st_size != map_size);
+    if (reset && (ftruncate(fd, 0) != 0 || ftruncate(fd, map_size) != 0)) {
+        close(fd);
+        fprintf(stderr, "Can't resize tile cache `%s`.\n", filename);
+        return NULL;
+    }
+    void* map = mmap(NULL, map_size, PROT_READ|PROT_WRITE, MAP_SHARED, fd, 0);
+    if (map == MAP_FAILED) {
+        close(fd);
+        fprintf(stderr, "Can't map tile cache `%s`.\n", filename);
+        return NULL;
+    }
+    /* Check or write header. */
+    struct tc_header* header = map;
+    if (!reset && (memcmp(header->magic, TC_MAGIC, sizeof(header->magic)) != 0
+                || header->version != TC_VERSION
+                || header->tile_size != TC_TILE_SIZE
+                || header->slotc != slotc)) {
+        memset(map, 0, map_size);
+        reset = true;
+    }
+    if (reset) {
+        memcpy(header->magic, TC_MAGIC, sizeof(header->magic));
+        header->version = TC_VERSION;
+        header->tile_size = TC_TILE_SIZE;
+        header->slotc = slotc;
+        header->clock = 0;
+    }
+    /* Build in-memory index. */
+    struct tile_cache* cache = calloc(1, sizeof(struct tile_cache));
+    if (!cache) {
+        panic("Error: can't allocate tile cache.");
+    }
+    cache->fd = fd;
+    cache->map = map;
+    cache->map_size = map_size;
+    cache->header = header;
+    cache->slots = (struct tc_slot*)(header + 1);
+    cache->data = (int32_t*)(cache->slots + slotc);
+    cache->slotc = (int32_t)slotc;
+    cache->bucketc = 1;
+    while ((size_t)cache->bucketc < slotc) {
+        cache->bucketc <<= 1;
+    }
+    cache->buckets = calloc(cache->bucketc, sizeof(int32_t));
+    cache->chain = calloc(slotc, sizeof(int32_t));
+    cache->lru_prev = calloc(slotc, sizeof(int32_t));
+    cache->lru_next = calloc(slotc, sizeof(int32_t));
+    if (!cache->buckets || !cache->chain || !cache->lru_prev || !cache->lru_next) {
+        panic("Error: can't allocate tile cache index.");
+    }
+    tc_build_index(cache);
+#ifdef MT
+    int s = pthread_mutex_init(&cache->mutex, NULL);
+    if (s != 0) panicen(s, "pthread_mutex_init");
+#endif
+    return cache;
+}
+
+void tc_close(struct tile_cache* cache) {
+    if (!cache) {
+        return;
+    }
+    msync(cache->map, cache->map_size, MS_SYNC);
+    munmap(cache->map, cache->map_size);
+    close(cache->fd);
+#ifdef MT
+    int s = pthread_mutex_destroy(&cache->mutex);
+    if (s != 0) panicen(s, "pthread_mutex_destroy");
+#endif
+    free(cache->buckets);
+    free(cache->chain);
+    free(cache->lru_prev);
+    free(cache->lru_next);
+    free(cache);
+}
+
+static void tc_lock(struct tile_cache* cache) {
+#ifdef MT
+    int s = pthread_mutex_lock(&cache->mutex);
+    if (s != 0) panicen(s, "pthread_mutex_lock");
+#else
+    (void)cache;
+#endif
+}
+
+static void tc_unlock(struct tile_cache* cache) {
+#ifdef MT
+    int s = pthread_mutex_unlock(&cache->mutex);
+    if (s != 0) panicen(s, "pthread_mutex_unlock");
+#else
+    (void)cache;
+#endif
+}
+
+bool tc_get(struct tile_cache* cache, const struct tc_key* key, int32_t* iters) {
+    tc_lock(cache);
+    cache->stats.lookups++;
+    int32_t s = tc_find(cache, key);
+    if (s >= 0) {
+        memcpy(iters, cache->data + (size_t)s * TC_TILE_PIXELS, TC_TILE_BYTES);
+        tc_touch(cache, s);
+        cache->stats.hits++;
+        cache->stats.bytes_served += TC_TILE_BYTES;
+    }
+    tc_unlock(cache);
+    return s >= 0;
+}
+
+void tc_put(struct tile_cache* cache, const struct tc_key* key, const int32_t* iters) {
+    tc_lock(cache);
+    int32_t s = tc_find(cache, key);
+    if (s < 0) {
+        /* Evict the least recently used slot (empty slots come first). */
+        s = cache->lru_tail;
+        if (cache->slots[s].used) {
+            tc_index_remove(cache, s);
+        }
+        /* Slot is invalid until its data is written. */
+        cache->slots[s].used = 0;
+        memcpy(&cache->slots[s].key, key, sizeof(struct tc_key));
+        tc_index_insert(cache, s);
+    }
+    memcpy(cache->data + (size_t)s * TC_TILE_PIXELS, iters, TC_TILE_BYTES);
+    tc_touch(cache, s);
+    tc_unlock(cache);
+}
+
+struct tc_stats tc_get_stats(struct tile_cache* cache) {
+    tc_lock(cache);
+    struct tc_stats stats = cache->stats;
+    tc_unlock(cache);
+    return stats;
+}
+
+void tc_print_stats(struct tile_cache* cache, FILE* out) {
+    if (!cache) {
+        return;
+    }
+    struct tc_stats stats = tc_get_stats(cache);
+    double rate = (stats.lookups) ? 100.0 * stats.hits / stats.lookups : 0.0;
+    fprintf(out, "> tile cache: %llu/%llu tiles hit (%.1lf%%), %.1lf MiB served\n",
+            (unsigned long long)stats.hits, (unsigned long long)stats.lookups,
+            rate, stats.bytes_served / (1024.0 * 1024.0));
+}
+
+int32_t tc_level(double dpp) {
+    return (int32_t)lround(-log2(dpp) * TC_LEVELS_PER_OCTAVE);
+}
+
+double tc_level_dpp(int32_t level) {
+    return exp2(-(double)level / TC_LEVELS_PER_OCTAVE);
+}
+
+struct tc_key tc_key_make(struct fractal_info fi, int32_t level, int64_t tx, int64_t ty) {
+    struct tc_key key;
+    memset(&key, 0, sizeof(key)); // Key bytes are hashed & compared.
+    key.generator = fi.generator;
+    key.n         = fi.n;
+    key.max_iter  = fi.max_iter;
+    key.level     = level;
+    key.jx        = fi.jx;
+    key.jy        = fi.jy;
+    key.tx        = tx;
+    key.ty        = ty;
+    return key;
+}
@@ -0,0 +1,61 @@
+#ifndef _H_TILE_CACHE_
+#define _H_TILE_CACHE_
+
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdio.h>
+
+#include "types.h"
+
+/** TC_TILE_SIZE is the width and height in pixels of a cached tile. */
+#define TC_TILE_SIZE 64
+/** TC_LEVELS_PER_OCTAVE is the number of tile levels between dpp and dpp/2. */
+#define TC_LEVELS_PER_OCTAVE 256
+
+/** tc_key identifies a tile of iteration data.
+ ** Tiles of a same level share a pixel lattice: pixel (gx, gy) of the lattice
+ ** is at local coords (gx * dpp, gy * dpp) and belongs to tile
+ ** (gx / TC_TILE_SIZE, gy / TC_TILE_SIZE). */
+struct tc_key {
+    int32_t generator;
+    int32_t n;
+    int32_t max_iter;
+    int32_t level;
+    double  jx, jy;
+    int64_t tx, ty;
+};
+
+/** tc_stats gathers the tile cache usage counters. */
+struct tc_stats {
+    uint64_t lookups;
+    uint64_t hits;
+    uint64_t bytes_served;
+};
+
+struct tile_cache;
+
+/** tc_open maps filename as a tile cache of at most size_limit bytes.
+ ** The file is created or reset if it doesn't match size_limit.
+ ** Returns NULL on error. Caller is responsible for calling tc_close. */
+struct tile_cache* tc_open(const char* filename, size_t size_limit);
+/** tc_close flushes the cache to disk and frees it. */
+void tc_close(struct tile_cache* cache);
+/** tc_get copies the tile identified by key to iters (TC_TILE_SIZE^2 values).
+ ** Returns false if the tile is not in cache. */
+bool tc_get(struct tile_cache* cache, const struct tc_key* key, int32_t* iters);
+/** tc_put stores iters (TC_TILE_SIZE^2 values) as the tile identified by key,
+ ** evicting the least recently used tile if the cache is full. */
+void tc_put(struct tile_cache* cache, const struct tc_key* key, const int32_t* iters);
+/** tc_get_stats returns the usage counters of cache. */
+struct tc_stats tc_get_stats(struct tile_cache* cache);
+/** tc_print_stats prints the hit rate and bytes served from cache to out. */
+void tc_print_stats(struct tile_cache* cache, FILE* out);
+
+/** tc_level returns the tile level closest to dpp. */
+int32_t tc_level(double dpp);
+/** tc_level_dpp returns the dpp of the pixel lattice of level. */
+double tc_level_dpp(int32_t level);
+/** tc_key_make returns the key of tile (tx, ty) of level for fi. */
+struct tc_key tc_key_make(struct fractal_info fi, int32_t level, int64_t tx, int64_t ty);
+
+#endif
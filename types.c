@@ -1,6 +1,11 @@
 #include "types.h"
 
 #include <limits.h>
+#include <math.h>
+
+#ifndef M_PI_2
+#define M_PI_2 1.57079632679489661923
+#endif
 
 void fi_max_iter_incr(struct fractal_info* fi, int step) {
     if (fi->max_iter > INT_MAX - step) {
@@ -18,9 +23,7 @@ void fi_max_iter_decr(struct fractal_info* fi, int step) {
     }
 }
 
-void fi_translate(struct fractal_info* fi, SDL_Window* window, double dx, double dy) {
-    int width, height;
-    SDL_GetWindowSize(window, &width, &height);
+void fi_translate(struct fractal_info* fi, int width, int height, double dx, double dy) {
     fi->cx += dx * width * fi->dpp;
     fi->cy -= dy * height * fi->dpp;
 }
@@ -51,3 +54,26 @@ void fi_print(struct fractal_info* fi) {
     fprintf(out, "  .n=         %d\n", fi->n);
     fprintf(out, "}\n");
 }
+
+bool fi_equal(struct fractal_info a, struct fractal_info b) {
+    return a.generator == b.generator
+        && a.dynamic == b.dynamic
+        && a.max_iter == b.max_iter
+        && a.cx == b.cx
+        && a.cy == b.cy
+        && a.dpp == b.dpp
+        && a.jx == b.jx
+        && a.jy == b.jy
+        && a.n == b.n;
+}
+
+struct fractal_info fi_at(struct fractal_info fi, double t) {
+    if (fi.dynamic) {
+        double tp = t / (2 * M_PI_2);
+        double ct = cos(tp);
+        double st = sin(tp);
+        fi.jx *= ct;
+        fi.jy *= st;
+    }
+    return fi;
+}
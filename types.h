@@ -8,8 +8,14 @@ enum generator {
     GEN_MANDELBROT,
     GEN_JULIA,
     GEN_JULIA_MULTISET,
+    /** orbit densities (see orbits_render); other renderers show the mandelbrot set. */
+    GEN_BUDDHABROT,
+    GEN_NEBULABROT,
 };
 
+/** fractal_generator returns the escape iteration count of point (ix, iy). */
+typedef int (*fractal_generator)(double ix, double iy, double cx, double cy, int n, int max_iter);
+
 /** fractal_info gathers init informations about fractal for renderers. */
 struct fractal_info {
     enum generator generator;
@@ -33,9 +39,15 @@ struct fractal_info {
 
 void fi_max_iter_incr(struct fractal_info* fi, int step);
 void fi_max_iter_decr(struct fractal_info* fi, int step);
-void fi_translate(struct fractal_info* fi, SDL_Window* window, double dx, double dy);
+/** fi_translate moves the view of fi, of width x height pixels, by dx & dy
+ ** times its size. */
+void fi_translate(struct fractal_info* fi, int width, int height, double dx, double dy);
 void fi_zoom(struct fractal_info* fi, double factor);
 void fi_print(struct fractal_info* fi);
+/** fi_equal tells if a and b render the same frames. */
+bool fi_equal(struct fractal_info a, struct fractal_info b);
+/** fi_at returns fi with the julia constant of dynamic fractals set at time t. */
+struct fractal_info fi_at(struct fractal_info fi, double t);
 
 /** renderer is the interface that all renderers must implement. */
 struct renderer {
@@ -45,8 +57,10 @@ struct renderer {
     void (*free)(void);
     /** resize resizes the renderer. */
     void (*resize)(int width, int height);
-    /** render renders the fractal to the screen. */
-    void (*render)(struct fractal_info fi, double t, double dt);
+    /** render renders the fractal to the screen; returns true if a complete
+     ** frame of fi was presented. Renderers may present partial frames and
+     ** complete them on later calls with the same fi. */
+    bool (*render)(struct fractal_info fi, double t, double dt);
 };
 
 #endif